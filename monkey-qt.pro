@@ -261,9 +261,11 @@ HEADERS += src/qt/bitcoingui.h \
     src/chainparams.h \
     src/chainparamsseeds.h \
     src/checkpoints.h \
+    src/compactblock.h \
     src/compat.h \
     src/coincontrol.h \
     src/sync.h \
+    src/perfstats.h \
     src/util.h \
     src/hash.h \
     src/uint256.h \
@@ -279,10 +281,12 @@ HEADERS += src/qt/bitcoingui.h \
     src/key.h \
     src/pubkey.h \
     src/db.h \
+    src/logdb.h \
     src/txdb.h \
     src/txmempool.h \
     src/walletdb.h \
     src/script.h \
+    src/sigcache.h \
     src/crypto/scrypt.h \
     src/init.h \
     src/mruset.h \
@@ -313,6 +317,7 @@ HEADERS += src/qt/bitcoingui.h \
     src/qt/walletmodeltransaction.h \
     src/rpcclient.h \
     src/rpcprotocol.h \
+    src/rpcjson.h \
     src/rpcserver.h \
     src/qt/overviewpage.h \
     src/qt/csvmodelwriter.h \
@@ -395,6 +400,7 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/chainparams.cpp \
     src/clientversion.cpp \
     src/sync.cpp \
+    src/perfstats.cpp \
     src/txmempool.cpp \
     src/util.cpp \
     src/netbase.cpp \
@@ -402,14 +408,17 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/key.cpp \
     src/pubkey.cpp \
     src/script.cpp \
+    src/sigcache.cpp \
     src/core.cpp \
     src/main.cpp \
     src/miner.cpp \
     src/init.cpp \
     src/net.cpp \
     src/checkpoints.cpp \
+    src/compactblock.cpp \
     src/addrman.cpp \
     src/db.cpp \
+    src/logdb.cpp \
     src/walletdb.cpp \
     src/qt/clientmodel.cpp \
     src/qt/guiutil.cpp \
@@ -429,6 +438,7 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/qt/walletmodeltransaction.cpp \
     src/rpcclient.cpp \
     src/rpcprotocol.cpp \
+    src/rpcjson.cpp \
     src/rpcserver.cpp \
     src/rpcdump.cpp \
     src/rpcmisc.cpp \
@@ -0,0 +1,148 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "util.h"
+
+#include "json/json_spirit_utils.h"
+#include "json/json_spirit_writer_template.h"
+
+#include <iostream>
+#include <limits>
+#include <regex>
+#include <vector>
+#include <sys/time.h>
+
+using namespace benchmark;
+using namespace json_spirit;
+
+BenchRunner::BenchmarkMap &BenchRunner::benchmarks() {
+    static std::map<std::string, BenchFunction> benchmarks_map;
+    return benchmarks_map;
+}
+
+static double gettimedouble(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_usec * 0.000001 + tv.tv_sec;
+}
+
+BenchRunner::BenchRunner(std::string name, BenchFunction func)
+{
+    benchmarks().insert(std::make_pair(name, func));
+}
+
+void
+BenchRunner::ListAll()
+{
+    for (std::map<std::string,BenchFunction>::iterator it = benchmarks().begin();
+         it != benchmarks().end(); ++it)
+        std::cout << it->first << "\n";
+}
+
+static Object ResultToJSON(const Result& result)
+{
+    Object obj;
+    obj.push_back(Pair("name", result.name));
+    obj.push_back(Pair("iterations", result.count));
+    obj.push_back(Pair("min_ns", result.minTime * 1e9));
+    obj.push_back(Pair("max_ns", result.maxTime * 1e9));
+    obj.push_back(Pair("avg_ns", result.average * 1e9));
+    return obj;
+}
+
+bool
+BenchRunner::RunAll(const std::string& strFilter, const std::string& strFormat, double elapsedTimeForOne)
+{
+    std::regex reFilter;
+    try {
+        reFilter = std::regex(strFilter);
+    } catch (const std::regex_error& e) {
+        std::cerr << "Invalid -filter: " << e.what() << "\n";
+        return false;
+    }
+    bool fJSON = (strFormat == "json");
+    if (!fJSON && strFormat != "csv") {
+        std::cerr << "Unknown -format: " << strFormat << "\n";
+        return false;
+    }
+
+    // csv rows are printed as they finish; json is written at the end so the
+    // whole run is one document, tagged with the version for tracking per commit
+    if (!fJSON)
+        std::cout << "Benchmark" << "," << "count" << "," << "min" << "," << "max" << "," << "average" << "\n";
+    Array results;
+
+    for (std::map<std::string,BenchFunction>::iterator it = benchmarks().begin();
+         it != benchmarks().end(); ++it) {
+
+        if (!std::regex_match(it->first, reFilter))
+            continue;
+
+        State state(it->first, elapsedTimeForOne);
+        BenchFunction& func = it->second;
+        func(state);
+
+        Result result;
+        if (!state.GetResult(result))
+            continue;
+        if (fJSON)
+            results.push_back(ResultToJSON(result));
+        else
+            std::cout << result.name << "," << result.count << "," << result.minTime << "," << result.maxTime << "," << result.average << "\n";
+    }
+
+    if (fJSON) {
+        Object obj;
+        obj.push_back(Pair("version", FormatFullVersion()));
+        obj.push_back(Pair("time", GetTime()));
+        obj.push_back(Pair("benchmarks", results));
+        std::cout << write_string(Value(obj), true) << "\n";
+    }
+    return true;
+}
+
+bool State::KeepRunning()
+{
+    double now;
+    if (count == 0) {
+        beginTime = now = gettimedouble();
+    }
+    else {
+        // timeCheckCount is used to avoid calling gettime most of the time,
+        // so benchmarks that run very quickly get consistent results.
+        if ((count+1)%timeCheckCount != 0) {
+            ++count;
+            return true; // keep going
+        }
+        now = gettimedouble();
+        double elapsedOne = (now - lastTime)/timeCheckCount;
+        if (elapsedOne < minTime) minTime = elapsedOne;
+        if (elapsedOne > maxTime) maxTime = elapsedOne;
+        if (elapsedOne*timeCheckCount < maxElapsed/16) timeCheckCount *= 2;
+    }
+    lastTime = now;
+    ++count;
+
+    if (now - beginTime < maxElapsed) return true; // Keep going
+
+    --count;
+    fFinished = true;
+    return false;
+}
+
+bool State::GetResult(Result& result) const
+{
+    // A benchmark that bailed out early has nothing to report
+    if (!fFinished || count == 0)
+        return false;
+    result.name = name;
+    result.count = count;
+    result.minTime = minTime;
+    result.maxTime = maxTime;
+    result.average = (lastTime - beginTime) / count;
+    return true;
+}
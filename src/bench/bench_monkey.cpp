@@ -0,0 +1,40 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "key.h"
+#include "util.h"
+
+#include <iostream>
+
+int
+main(int argc, char** argv)
+{
+    ParseParameters(argc, argv);
+    if (mapArgs.count("-?") || mapArgs.count("-help")) {
+        std::cout << "Usage: bench_monkey [options]\n\n"
+                  << "  -list               List the benchmarks and exit\n"
+                  << "  -filter=<regex>     Only run benchmarks whose whole name matches (default: .*)\n"
+                  << "  -time=<seconds>     Time to spend on each benchmark (default: 1)\n"
+                  << "  -format=<csv|json>  Output format; json includes the version for tracking results per commit (default: csv)\n";
+        return 0;
+    }
+    if (GetBoolArg("-list", false)) {
+        benchmark::BenchRunner::ListAll();
+        return 0;
+    }
+
+    fPrintToDebugLog = false; // don't want to write to debug.log file
+    SelectParams(CChainParams::MAIN);
+    ECC_Start();
+    ECCVerifyHandle verifyHandle;
+
+    bool fRet = benchmark::BenchRunner::RunAll(GetArg("-filter", ".*"), GetArg("-format", "csv"), atof(GetArg("-time", "1").c_str()));
+
+    ECC_Stop();
+    return fRet ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "wallet.h"
+
+#include <set>
+
+using namespace std;
+
+// Synthetic payout wallet: nCoins confirmed outputs between 0.001 and 100
+// MONK. All outputs live in one transaction so a million of them fit in
+// memory; coin selection only looks at the value, depth and time of each.
+static CWalletTx* MakeWallet(CWallet& wallet, vector<COutput>& vCoins, unsigned int nCoins)
+{
+    CTransaction tx;
+    tx.nTime = 0;
+    tx.vout.resize(nCoins);
+    seed_insecure_rand(true);
+    for (unsigned int i = 0; i < nCoins; i++)
+        tx.vout[i].nValue = COIN / 1000 + (((uint64_t)insecure_rand() << 32) | insecure_rand()) % (100 * COIN);
+
+    CWalletTx* wtx = new CWalletTx(&wallet, tx);
+    // Fake IsFromMe() so the outputs count as our own change
+    wtx->vin.resize(1);
+    wtx->fDebitCached = true;
+    wtx->nDebitCached = 1;
+
+    vCoins.clear();
+    vCoins.reserve(nCoins);
+    for (unsigned int i = 0; i < nCoins; i++)
+        vCoins.push_back(COutput(wtx, i, 6 * 24, true));
+    return wtx;
+}
+
+static void CoinSelection(benchmark::State& state, unsigned int nCoins)
+{
+    CWallet wallet;
+    vector<COutput> vCoins;
+    CWalletTx* wtx = MakeWallet(wallet, vCoins, nCoins);
+
+    // A sendtoaddress sized payment, then a larger sendmany sized one
+    const CAmount vTargets[] = { 25 * COIN + 12345, 1500 * COIN + 6789 };
+    unsigned int n = 0;
+    while (state.KeepRunning()) {
+        set<pair<const CWalletTx*, unsigned int> > setCoinsRet;
+        CAmount nValueRet;
+        bool fSuccess = wallet.SelectCoinsMinConf(vTargets[n++ % 2], std::numeric_limits<unsigned int>::max(), 1, 6, vCoins, setCoinsRet, nValueRet);
+        assert(fSuccess);
+    }
+    delete wtx;
+}
+
+// Equal coins can never match the target without change, so branch and
+// bound gives up at once and ApproximateBestSubset runs its full 2x1000
+// randomized passes
+static void CoinSelectionApproximate(benchmark::State& state)
+{
+    CWallet wallet;
+    vector<COutput> vCoins;
+    CWalletTx* wtx = MakeWallet(wallet, vCoins, 1000);
+    for (unsigned int i = 0; i < wtx->vout.size(); i++)
+        wtx->vout[i].nValue = 3 * COIN;
+
+    while (state.KeepRunning()) {
+        set<pair<const CWalletTx*, unsigned int> > setCoinsRet;
+        CAmount nValueRet;
+        bool fSuccess = wallet.SelectCoinsMinConf(10 * COIN + 1, std::numeric_limits<unsigned int>::max(), 1, 6, vCoins, setCoinsRet, nValueRet);
+        assert(fSuccess && nValueRet == 12 * COIN);
+    }
+    delete wtx;
+}
+
+static void CoinSelection10k(benchmark::State& state) { CoinSelection(state, 10000); }
+static void CoinSelection100k(benchmark::State& state) { CoinSelection(state, 100000); }
+static void CoinSelection1M(benchmark::State& state) { CoinSelection(state, 1000000); }
+
+BENCHMARK(CoinSelectionApproximate);
+BENCHMARK(CoinSelection10k);
+BENCHMARK(CoinSelection100k);
+BENCHMARK(CoinSelection1M);
@@ -0,0 +1,77 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "hash.h"
+#include "hashblock.h"
+#include "crypto/hmac_sha256.h"
+#include "crypto/ripemd160.h"
+#include "crypto/sha256.h"
+
+#include <vector>
+
+/* Number of bytes to hash per iteration */
+static const uint64_t BUFFER_SIZE = 1000*1000;
+
+static void RIPEMD160_1M(benchmark::State& state)
+{
+    uint8_t hash[CRIPEMD160::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE,0);
+    while (state.KeepRunning())
+        CRIPEMD160().Write(begin_ptr(in), in.size()).Finalize(hash);
+}
+
+static void SHA256_1M(benchmark::State& state)
+{
+    uint8_t hash[CSHA256::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE,0);
+    while (state.KeepRunning())
+        CSHA256().Write(begin_ptr(in), in.size()).Finalize(hash);
+}
+
+// Double SHA-256 of a hash, as for merkle tree nodes and txids
+static void SHA256D_32b(benchmark::State& state)
+{
+    uint256 hash;
+    while (state.KeepRunning())
+        hash = Hash(hash.begin(), hash.end());
+}
+
+// Keyed with a 32 byte secret over a 64 byte message, the shape used in
+// BIP32 derivation and RFC6979 nonces
+static void HMAC_SHA256_64b(benchmark::State& state)
+{
+    uint8_t key[32] = {0};
+    uint8_t hash[CHMAC_SHA256::OUTPUT_SIZE];
+    std::vector<uint8_t> in(64,0);
+    while (state.KeepRunning())
+        CHMAC_SHA256(key, sizeof(key)).Write(begin_ptr(in), in.size()).Finalize(hash);
+}
+
+// The proof-of-work hash over an 80 byte block header
+static void Hash9_80b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(80,0);
+    uint256 hash;
+    while (state.KeepRunning()) {
+        hash = Hash9(in.begin(), in.end());
+        in[76] = hash.GetLow64() & 0xff; // vary the nonce
+    }
+}
+
+static void Hash9_1M(benchmark::State& state)
+{
+    std::vector<uint8_t> in(BUFFER_SIZE,0);
+    while (state.KeepRunning())
+        Hash9(in.begin(), in.end());
+}
+
+BENCHMARK(RIPEMD160_1M);
+BENCHMARK(SHA256_1M);
+BENCHMARK(SHA256D_32b);
+BENCHMARK(HMAC_SHA256_64b);
+BENCHMARK(Hash9_80b);
+BENCHMARK(Hash9_1M);
@@ -0,0 +1,40 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "hash.h"
+#include "key.h"
+
+#include <vector>
+
+static void ECDSASign(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    uint256 hash;
+    std::vector<unsigned char> vchSig;
+    while (state.KeepRunning()) {
+        key.Sign(hash, vchSig);
+        hash = Hash(vchSig.begin(), vchSig.end());
+    }
+}
+
+// Straight through CPubKey, so the signature cache is not involved
+static void ECDSAVerify(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    uint256 hash = Hash(pubkey.begin(), pubkey.end());
+    std::vector<unsigned char> vchSig;
+    key.Sign(hash, vchSig);
+    while (state.KeepRunning()) {
+        bool fValid = pubkey.Verify(hash, vchSig);
+        assert(fValid);
+    }
+}
+
+BENCHMARK(ECDSASign);
+BENCHMARK(ECDSAVerify);
@@ -0,0 +1,58 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "kernel.h"
+#include "main.h"
+
+#include <vector>
+
+// One kernel hash attempt, as the staker makes for every coin and every
+// timestamp it tries. The coin's block is followed by a day of one minute
+// blocks that each generated a stake modifier, so looking the modifier up
+// walks the selection interval like it does on the real chain.
+static void StakeKernelHash(benchmark::State& state)
+{
+    const unsigned int nTimeFrom = 1500000000;
+
+    CBlock blockFrom;
+    blockFrom.nVersion = 7;
+    blockFrom.nTime = nTimeFrom;
+    blockFrom.nBits = 0x1e0fffff;
+    uint256 hashFrom = blockFrom.GetHash();
+
+    std::vector<uint256> vHashes;
+    vHashes.push_back(hashFrom);
+    for (int i = 1; i <= 24 * 60; i++)
+        vHashes.push_back(uint256(i));
+    std::vector<CBlockIndex> vIndex(vHashes.size());
+    for (unsigned int i = 0; i < vIndex.size(); i++) {
+        vIndex[i].phashBlock = &vHashes[i];
+        vIndex[i].nHeight = 1000 + i;
+        vIndex[i].nTime = nTimeFrom + 60 * i;
+        vIndex[i].SetStakeModifier(0x0123456789abcdefULL + i, true);
+        if (i > 0) {
+            vIndex[i].pprev = &vIndex[i - 1];
+            vIndex[i - 1].pnext = &vIndex[i];
+        }
+        mapBlockIndex[vHashes[i]] = &vIndex[i];
+    }
+
+    CTransaction txPrev;
+    txPrev.nTime = nTimeFrom;
+    txPrev.vout.resize(2);
+    txPrev.vout[1].nValue = 1000 * COIN;
+    COutPoint prevout(txPrev.GetHash(), 1);
+
+    unsigned int nTimeTx = nTimeFrom + 10 * 24 * 60 * 60;
+    uint256 hashProofOfStake, targetProofOfStake;
+    while (state.KeepRunning())
+        CheckStakeKernelHash(0x1e0fffff, blockFrom, 81, txPrev, prevout, nTimeTx++, hashProofOfStake, targetProofOfStake);
+
+    for (unsigned int i = 0; i < vHashes.size(); i++)
+        mapBlockIndex.erase(vHashes[i]);
+}
+
+BENCHMARK(StakeKernelHash);
@@ -0,0 +1,117 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "main.h"
+#include "script.h"
+#include "util.h"
+
+#include <vector>
+
+// Spends of pay-to-pubkey-hash outputs: the signature and pubkey pushes
+// have their real sizes, the contents are filler
+static CTransaction MakeTransaction(unsigned int nInputs, unsigned int nOutputs)
+{
+    CTransaction tx;
+    tx.nTime = 1500000000;
+    tx.vin.resize(nInputs);
+    for (unsigned int i = 0; i < nInputs; i++) {
+        tx.vin[i].prevout = COutPoint(GetRandHash(), i % 4);
+        tx.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30) << std::vector<unsigned char>(33, 0x02);
+    }
+    tx.vout.resize(nOutputs);
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        tx.vout[i].nValue = (i + 1) * COIN;
+        tx.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return tx;
+}
+
+// A full block: 1000 two-in two-out transactions, about 370KB
+static CBlock MakeBlock()
+{
+    CBlock block;
+    block.nVersion = 7;
+    block.nTime = 1500000000;
+    block.vtx.push_back(MakeTransaction(1, 1));
+    for (int i = 0; i < 1000; i++)
+        block.vtx.push_back(MakeTransaction(2, 2));
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+static void DeserializeBlock(benchmark::State& state)
+{
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << MakeBlock();
+    while (state.KeepRunning()) {
+        CDataStream ss(ssBlock.begin(), ssBlock.end(), SER_NETWORK, PROTOCOL_VERSION);
+        CBlock block;
+        ss >> block;
+        assert(block.vtx.size() == 1001);
+    }
+}
+
+static void SerializeBlock(benchmark::State& state)
+{
+    CBlock block = MakeBlock();
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    while (state.KeepRunning()) {
+        ss.clear();
+        ss << block;
+    }
+}
+
+static void DeserializeTransaction(benchmark::State& state)
+{
+    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
+    ssTx << MakeTransaction(2, 2);
+    while (state.KeepRunning()) {
+        CDataStream ss(ssTx.begin(), ssTx.end(), SER_NETWORK, PROTOCOL_VERSION);
+        CTransaction tx;
+        ss >> tx;
+    }
+}
+
+// Serializes the transaction and double hashes it
+static void TransactionHash(benchmark::State& state)
+{
+    CTransaction tx = MakeTransaction(2, 2);
+    while (state.KeepRunning()) {
+        tx.GetHash();
+        tx.nLockTime++;
+    }
+}
+
+// Signature hashes for every input of a 100 input transaction, each of
+// which reserializes the whole transaction...
+static void SignatureHash100(benchmark::State& state)
+{
+    CTransaction tx = MakeTransaction(100, 2);
+    CScript scriptCode = tx.vout[0].scriptPubKey;
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < tx.vin.size(); i++)
+            SignatureHash(scriptCode, tx, i, SIGHASH_ALL);
+    }
+}
+
+// ...and with the shared parts precomputed once, as when verifying
+static void SignatureHash100Precomputed(benchmark::State& state)
+{
+    CTransaction tx = MakeTransaction(100, 2);
+    CScript scriptCode = tx.vout[0].scriptPubKey;
+    while (state.KeepRunning()) {
+        PrecomputedTransactionData txdata(tx);
+        for (unsigned int i = 0; i < tx.vin.size(); i++)
+            SignatureHash(scriptCode, tx, i, SIGHASH_ALL, &txdata);
+    }
+}
+
+BENCHMARK(DeserializeBlock);
+BENCHMARK(SerializeBlock);
+BENCHMARK(DeserializeTransaction);
+BENCHMARK(TransactionHash);
+BENCHMARK(SignatureHash100);
+BENCHMARK(SignatureHash100Precomputed);
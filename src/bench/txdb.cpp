@@ -0,0 +1,83 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "txdb.h"
+#include "util.h"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// The index database is a process-wide singleton under the data directory,
+// so each benchmark gets a fresh one in a directory of its own
+class CBenchTxDB
+{
+    boost::filesystem::path path;
+
+public:
+    CBenchTxDB()
+    {
+        path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("bench_monkey_%%%%%%%%");
+        boost::filesystem::create_directories(path);
+        mapArgs["-datadir"] = path.string();
+        ClearDatadirCache();
+    }
+
+    ~CBenchTxDB()
+    {
+        CTxDB().Close();
+        boost::filesystem::remove_all(path);
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+    }
+};
+
+static const unsigned int TXS_PER_BLOCK = 200;
+
+// Index entries for one block's transactions written in one batch, as
+// ConnectBlock does
+static void TxDBWriteBlock(benchmark::State& state)
+{
+    CBenchTxDB benchdb;
+    CTxDB txdb("cr+");
+    seed_insecure_rand(true);
+    unsigned int nBlockPos = 0;
+    while (state.KeepRunning()) {
+        txdb.TxnBegin();
+        for (unsigned int i = 0; i < TXS_PER_BLOCK; i++) {
+            uint256 hash = uint256(((uint64_t)insecure_rand() << 32) | insecure_rand()) << 192;
+            txdb.UpdateTxIndex(hash, CTxIndex(CDiskTxPos(1, nBlockPos, 81 + i * 250), 2));
+        }
+        txdb.TxnCommit();
+        nBlockPos += TXS_PER_BLOCK * 250;
+    }
+}
+
+// Random index lookups in a database of half a million transactions
+static void TxDBReadTxIndex(benchmark::State& state)
+{
+    CBenchTxDB benchdb;
+    CTxDB txdb("cr+");
+    std::vector<uint256> vHashes;
+    for (unsigned int i = 0; i < 500000; i++)
+        vHashes.push_back(Hash(BEGIN(i), END(i)));
+    for (unsigned int i = 0; i < vHashes.size(); i += TXS_PER_BLOCK) {
+        txdb.TxnBegin();
+        for (unsigned int j = i; j < i + TXS_PER_BLOCK && j < vHashes.size(); j++)
+            txdb.UpdateTxIndex(vHashes[j], CTxIndex(CDiskTxPos(1, i * 250, 81 + (j - i) * 250), 2));
+        txdb.TxnCommit();
+    }
+
+    seed_insecure_rand(true);
+    while (state.KeepRunning()) {
+        CTxIndex txindex;
+        bool fFound = txdb.ReadTxIndex(vHashes[insecure_rand() % vHashes.size()], txindex);
+        assert(fFound);
+    }
+}
+
+BENCHMARK(TxDBWriteBlock);
+BENCHMARK(TxDBReadTxIndex);
@@ -0,0 +1,162 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "compactblock.h"
+
+#include "hash.h"
+#include "txmempool.h"
+#include "util.h"
+
+using namespace std;
+
+CCompactBlock::CCompactBlock(const CBlock& block)
+{
+    header.nVersion = block.nVersion;
+    header.hashPrevBlock = block.hashPrevBlock;
+    header.hashMerkleRoot = block.hashMerkleRoot;
+    header.nTime = block.nTime;
+    header.nBits = block.nBits;
+    header.nNonce = block.nNonce;
+    header.vchBlockSig = block.vchBlockSig;
+    nNonce = GetRand(std::numeric_limits<uint64_t>::max());
+
+    // The coinbase, and the coinstake of proof-of-stake blocks, are never
+    // in the receiver's memory pool.
+    unsigned int nPrefilled = block.IsProofOfStake() ? 2 : 1;
+    uint64_t k0, k1;
+    FillShortTxIDSelector(k0, k1);
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+    {
+        if (i < nPrefilled)
+            vPrefilledTxn.push_back(CPrefilledTransaction(i, block.vtx[i]));
+        else
+            vShortTxIds.push_back(GetShortID(k0, k1, block.vtx[i].GetHash()));
+    }
+}
+
+void CCompactBlock::FillShortTxIDSelector(uint64_t& k0, uint64_t& k1) const
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << header.GetHash() << nNonce;
+    uint256 hashSelector = ss.GetHash();
+    k0 = hashSelector.Get64(0);
+    k1 = hashSelector.Get64(1);
+}
+
+uint64_t CCompactBlock::GetShortID(uint64_t k0, uint64_t k1, const uint256& txhash)
+{
+    return SipHashUint256(k0, k1, txhash) & 0xffffffffffffULL;
+}
+
+ReadStatus CPartiallyDownloadedBlock::InitData(const CCompactBlock& cmpctblock, const CTxMemPool& pool)
+{
+    if (cmpctblock.header.IsNull() || (cmpctblock.vShortTxIds.empty() && cmpctblock.vPrefilledTxn.empty()))
+        return READ_STATUS_INVALID;
+    if (cmpctblock.BlockTxCount() > MAX_BLOCK_SIZE / 10)
+        return READ_STATUS_INVALID;
+
+    header = cmpctblock.header;
+    unsigned int nTxCount = cmpctblock.BlockTxCount();
+    vtx.assign(nTxCount, CTransaction());
+    vHave.assign(nTxCount, false);
+
+    // Place the prefilled transactions, which must be strictly increasing
+    int nLastIndex = -1;
+    BOOST_FOREACH(const CPrefilledTransaction& prefilled, cmpctblock.vPrefilledTxn)
+    {
+        if ((int)prefilled.nIndex <= nLastIndex || prefilled.nIndex >= nTxCount)
+            return READ_STATUS_INVALID;
+        vtx[prefilled.nIndex] = prefilled.tx;
+        vHave[prefilled.nIndex] = true;
+        nLastIndex = prefilled.nIndex;
+    }
+
+    // Map the remaining short IDs to their positions in the block
+    map<uint64_t, unsigned int> mapShortIds;
+    unsigned int nShortId = 0;
+    for (unsigned int i = 0; i < nTxCount; i++)
+    {
+        if (vHave[i])
+            continue;
+        if (!mapShortIds.insert(make_pair(cmpctblock.vShortTxIds[nShortId++], i)).second)
+            return READ_STATUS_FAILED; // short ID collision inside the block itself
+    }
+
+    uint64_t k0, k1;
+    cmpctblock.FillShortTxIDSelector(k0, k1);
+
+    // Fill in what the memory pool has. Slots matched by two pool
+    // transactions are left empty and requested from the peer.
+    vector<bool> vCollision(nTxCount, false);
+    {
+        LOCK(pool.cs);
+        for (map<uint256, CTransaction>::const_iterator mi = pool.mapTx.begin(); mi != pool.mapTx.end() && !mapShortIds.empty(); ++mi)
+        {
+            map<uint64_t, unsigned int>::iterator it = mapShortIds.find(CCompactBlock::GetShortID(k0, k1, mi->first));
+            if (it == mapShortIds.end())
+                continue;
+            unsigned int nIndex = it->second;
+            if (vCollision[nIndex])
+                continue;
+            if (vHave[nIndex])
+            {
+                vHave[nIndex] = false;
+                vtx[nIndex].SetNull();
+                vCollision[nIndex] = true;
+                continue;
+            }
+            vtx[nIndex] = mi->second;
+            vHave[nIndex] = true;
+        }
+    }
+
+    nMissing = 0;
+    for (unsigned int i = 0; i < nTxCount; i++)
+        if (!vHave[i])
+            nMissing++;
+
+    LogPrint("net", "CPartiallyDownloadedBlock::InitData : block %s, %u of %u transactions from mempool, %u missing\n",
+        header.GetHash().ToString(), nTxCount - cmpctblock.vPrefilledTxn.size() - nMissing, nTxCount, nMissing);
+
+    return READ_STATUS_OK;
+}
+
+bool CPartiallyDownloadedBlock::IsTxAvailable(unsigned int nIndex) const
+{
+    return nIndex < vHave.size() && vHave[nIndex];
+}
+
+void CPartiallyDownloadedBlock::GetMissing(vector<unsigned int>& vIndexes) const
+{
+    vIndexes.clear();
+    for (unsigned int i = 0; i < vHave.size(); i++)
+        if (!vHave[i])
+            vIndexes.push_back(i);
+}
+
+ReadStatus CPartiallyDownloadedBlock::FillBlock(CBlock& block, const vector<CTransaction>& vtxMissing)
+{
+    if (header.IsNull())
+        return READ_STATUS_INVALID;
+    if (vtxMissing.size() != nMissing)
+        return READ_STATUS_INVALID;
+
+    block = header;
+    block.vtx = vtx;
+    unsigned int nNext = 0;
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+        if (!vHave[i])
+            block.vtx[i] = vtxMissing[nNext++];
+
+    // A short ID collision with a pool transaction yields a block that does
+    // not match its header; the caller falls back to the full block.
+    if (block.BuildMerkleTree() != block.hashMerkleRoot)
+        return READ_STATUS_FAILED;
+
+    // Release memory, this object is done
+    header.SetNull();
+    vtx.clear();
+    vHave.clear();
+    return READ_STATUS_OK;
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef COMPACTBLOCK_H
+#define COMPACTBLOCK_H
+
+#include "main.h"
+
+#include <vector>
+
+class CTxMemPool;
+
+/** A transaction sent along with a compact block, at its position in the block */
+class CPrefilledTransaction
+{
+public:
+    unsigned int nIndex;
+    CTransaction tx;
+
+    CPrefilledTransaction() : nIndex(0) {}
+    CPrefilledTransaction(unsigned int nIndexIn, const CTransaction& txIn) : nIndex(nIndexIn), tx(txIn) {}
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(VARINT(nIndex));
+        READWRITE(tx);
+    )
+};
+
+/** "cmpctblock" message: a block header plus 6-byte short IDs for the transactions
+ *  the receiver is expected to already have in its memory pool. The coinbase
+ *  and, for proof-of-stake blocks, the coinstake are always sent in full.
+ */
+class CCompactBlock
+{
+public:
+    // header and block signature; vtx is always empty
+    CBlock header;
+    uint64_t nNonce;
+    std::vector<uint64_t> vShortTxIds;
+    std::vector<CPrefilledTransaction> vPrefilledTxn;
+
+    CCompactBlock() : nNonce(0) {}
+    CCompactBlock(const CBlock& block);
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(header);
+        READWRITE(nNonce);
+
+        unsigned int nShortTxIds = vShortTxIds.size();
+        READWRITE(VARINT(nShortTxIds));
+        if (fRead)
+        {
+            if (nShortTxIds > MAX_BLOCK_SIZE / 10)
+                throw std::ios_base::failure("CCompactBlock : too many short ids");
+            const_cast<CCompactBlock*>(this)->vShortTxIds.resize(nShortTxIds);
+        }
+        for (unsigned int i = 0; i < nShortTxIds; i++)
+        {
+            uint32_t nLow = (uint32_t)(vShortTxIds[i] & 0xffffffff);
+            uint16_t nHigh = (uint16_t)(vShortTxIds[i] >> 32);
+            READWRITE(nLow);
+            READWRITE(nHigh);
+            if (fRead)
+                const_cast<CCompactBlock*>(this)->vShortTxIds[i] = ((uint64_t)nHigh << 32) | nLow;
+        }
+
+        READWRITE(vPrefilledTxn);
+    )
+
+    /** Total number of transactions in the block */
+    unsigned int BlockTxCount() const { return vShortTxIds.size() + vPrefilledTxn.size(); }
+
+    /** SipHash key for the short IDs, derived from the header and nonce */
+    void FillShortTxIDSelector(uint64_t& k0, uint64_t& k1) const;
+
+    /** Short ID of a transaction under the given key */
+    static uint64_t GetShortID(uint64_t k0, uint64_t k1, const uint256& txhash);
+};
+
+/** "getblocktxn" message: request for the transactions of a compact block
+ *  that could not be found in the receiver's memory pool.
+ */
+class CBlockTransactionsRequest
+{
+public:
+    uint256 blockhash;
+    std::vector<unsigned int> vIndexes;
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(blockhash);
+        READWRITE(vIndexes);
+    )
+};
+
+/** "blocktxn" message: answer to a getblocktxn request */
+class CBlockTransactions
+{
+public:
+    uint256 blockhash;
+    std::vector<CTransaction> vtx;
+
+    CBlockTransactions() {}
+    CBlockTransactions(const CBlockTransactionsRequest& req) : blockhash(req.blockhash), vtx(req.vIndexes.size()) {}
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(blockhash);
+        READWRITE(vtx);
+    )
+};
+
+enum ReadStatus
+{
+    READ_STATUS_OK,
+    READ_STATUS_INVALID, // invalid object, peer is sending bogus data
+    READ_STATUS_FAILED,  // failed to reconstruct, e.g. short ID collision; request the full block
+};
+
+/** A block being rebuilt from a compact block, the memory pool and a
+ *  possible blocktxn round trip.
+ */
+class CPartiallyDownloadedBlock
+{
+private:
+    std::vector<CTransaction> vtx;
+    std::vector<bool> vHave;
+    CBlock header;
+    unsigned int nMissing;
+
+public:
+    CPartiallyDownloadedBlock() : nMissing(0) {}
+
+    /** Place prefilled transactions and look up the rest in the pool */
+    ReadStatus InitData(const CCompactBlock& cmpctblock, const CTxMemPool& pool);
+    bool IsTxAvailable(unsigned int nIndex) const;
+    /** Indexes of the transactions still to be requested with getblocktxn */
+    void GetMissing(std::vector<unsigned int>& vIndexes) const;
+    unsigned int GetMissingCount() const { return nMissing; }
+    /** Assemble the full block; vtxMissing holds the missing transactions in index order */
+    ReadStatus FillBlock(CBlock& block, const std::vector<CTransaction>& vtxMissing);
+};
+
+#endif
@@ -236,6 +236,7 @@ bool CCryptoKeyStore::LockKeyStore()
     {
         LOCK(cs_KeyStore);
         vMasterKey.clear();
+        mapStakingKeys.clear();
     }
 
     NotifyStatusChanged(this);
@@ -312,6 +313,13 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
         if (!IsCrypted())
             return CBasicKeyStore::GetKey(address, keyOut);
 
+        std::map<CKeyID, CStakingKey>::const_iterator it = mapStakingKeys.find(address);
+        if (it != mapStakingKeys.end())
+        {
+            keyOut = it->second.key;
+            return true;
+        }
+
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
         if (mi != mapCryptedKeys.end())
         {
@@ -329,6 +337,46 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
     return false;
 }
 
+void CCryptoKeyStore::CacheStakingKeys(const std::set<CKeyID> &setAddress)
+{
+    LOCK(cs_KeyStore);
+    if (IsLocked())
+        return;
+
+    BOOST_FOREACH(const CKeyID &address, setAddress)
+    {
+        if (mapStakingKeys.size() >= MAX_STAKING_KEY_CACHE)
+            break;
+        if (mapStakingKeys.count(address))
+            continue;
+
+        CKey key;
+        if (!GetKey(address, key))
+            continue;
+        CStakingKey& entry = mapStakingKeys[address];
+        entry.key = key;
+        entry.pubkey = key.GetPubKey();
+    }
+}
+
+bool CCryptoKeyStore::GetStakingKey(const CKeyID &address, CKey& keyOut, CPubKey& pubkeyOut) const
+{
+    {
+        LOCK(cs_KeyStore);
+        std::map<CKeyID, CStakingKey>::const_iterator it = mapStakingKeys.find(address);
+        if (it != mapStakingKeys.end())
+        {
+            keyOut = it->second.key;
+            pubkeyOut = it->second.pubkey;
+            return true;
+        }
+    }
+    if (!GetKey(address, keyOut))
+        return false;
+    pubkeyOut = keyOut.GetPubKey();
+    return true;
+}
+
 bool CCryptoKeyStore::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
 {
     {
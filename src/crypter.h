@@ -11,6 +11,8 @@
 
 const unsigned int WALLET_CRYPTO_KEY_SIZE = 32;
 const unsigned int WALLET_CRYPTO_SALT_SIZE = 8;
+/** Most decrypted keys CCryptoKeyStore keeps around for staking */
+const unsigned int MAX_STAKING_KEY_CACHE = 4096;
 
 /*
 Private key encryption is done based on a CMasterKey,
@@ -138,6 +140,17 @@ private:
     // if fUseCrypto is false, vMasterKey must be empty
     bool fUseCrypto;
 
+    struct CStakingKey
+    {
+        CKey key;
+        CPubKey pubkey;
+    };
+    // Keys of the outputs the wallet stakes with, decrypted once while the
+    // keystore is unlocked, so a kernel is signed without AES decryption or
+    // public key derivation. CKey keeps its secret in locked memory and
+    // cleanses it on destruction; LockKeyStore empties the cache.
+    std::map<CKeyID, CStakingKey> mapStakingKeys;
+
 protected:
     CryptedKeyMap mapCryptedKeys;
     CKeyingMaterial vMasterKey;
@@ -187,6 +200,10 @@ public:
     }
     bool GetKey(const CKeyID &address, CKey& keyOut) const;
     bool GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const;
+    /** Decrypt and keep the given keys until the keystore is locked, up to MAX_STAKING_KEY_CACHE */
+    void CacheStakingKeys(const std::set<CKeyID> &setAddress);
+    /** Key and public key for staking, from the cache when possible */
+    bool GetStakingKey(const CKeyID &address, CKey& keyOut, CPubKey& pubkeyOut) const;
     void GetKeys(std::set<CKeyID> &setAddress) const
     {
         if (!IsCrypted())
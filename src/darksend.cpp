@@ -1389,6 +1389,7 @@ bool CDarksendPool::SignFinalTransaction(CTransaction& finalTransactionNew, CNod
     LogPrintf("CDarksendPool::SignFinalTransaction %s\n", finalTransaction.ToString());
 
     vector<CTxIn> sigs;
+    PrecomputedTransactionData txdata(finalTransaction);
 
     //make sure my inputs/outputs are present, otherwise refuse to sign
     for (const CDarkSendEntry e : entries)
@@ -1445,7 +1446,7 @@ bool CDarksendPool::SignFinalTransaction(CTransaction& finalTransactionNew, CNod
                 const CKeyStore& keystore = *pwalletMain;
 
                 LogPrint("darksend", "CDarksendPool::Sign - Signing my input %i\n", mine);
-                if (!SignSignature(keystore, prevPubKey, finalTransaction, mine, int(SIGHASH_ALL | SIGHASH_ANYONECANPAY)))
+                if (!SignSignature(keystore, prevPubKey, finalTransaction, mine, int(SIGHASH_ALL | SIGHASH_ANYONECANPAY), &txdata))
                 { // changes scriptSig
                     LogPrint("darksend", "CDarksendPool::Sign - Unable to sign my own transaction!\n");
                     // not sure what to do here, it will timeout...?
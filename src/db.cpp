@@ -56,6 +56,8 @@ CDBEnv::CDBEnv() : dbenv(DB_CXX_NO_EXCEPTIONS)
 CDBEnv::~CDBEnv()
 {
     EnvShutdown();
+    for (map<string, CLogDB*>::iterator mi = mapLogDb.begin(); mi != mapLogDb.end(); ++mi)
+        delete mi->second;
 }
 
 void CDBEnv::Close()
@@ -234,7 +236,7 @@ void CDBEnv::CheckpointLSN(const std::string& strFile)
 
 
 CDB::CDB(const std::string& strFilename, const char* pszMode) :
-    pdb(NULL), activeTxn(NULL)
+    pdb(NULL), plog(NULL), activeTxn(NULL), plogTxn(NULL)
 {
     int ret;
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
@@ -248,6 +250,20 @@ CDB::CDB(const std::string& strFilename, const char* pszMode) :
 
     {
         LOCK(bitdb.cs_db);
+        plog = bitdb.GetLogDb(strFilename);
+        if (plog)
+        {
+            strFile = strFilename;
+            if (fCreate && !Exists(string("version")))
+            {
+                bool fTmp = fReadOnly;
+                fReadOnly = false;
+                WriteVersion(CLIENT_VERSION);
+                fReadOnly = fTmp;
+            }
+            return;
+        }
+
         if (!bitdb.Open(GetDataDir()))
             throw runtime_error("env open failed");
 
@@ -298,6 +314,13 @@ CDB::CDB(const std::string& strFilename, const char* pszMode) :
 
 void CDB::Close()
 {
+    if (plog)
+    {
+        delete plogTxn;
+        plogTxn = NULL;
+        plog = NULL;
+        return;
+    }
     if (!pdb)
         return;
     if (activeTxn)
@@ -333,6 +356,48 @@ void CDBEnv::CloseDb(const string& strFile)
     }
 }
 
+CLogDB* CDBEnv::GetLogDb(const string& strFile)
+{
+    LOCK(cs_db);
+    map<string, CLogDB*>::iterator mi = mapLogDb.find(strFile);
+    return mi == mapLogDb.end() ? NULL : mi->second;
+}
+
+bool CDBEnv::OpenLogDb(const string& strFile)
+{
+    LOCK(cs_db);
+    if (mapLogDb.count(strFile))
+        return true;
+
+    filesystem::path pathLog = GetDataDir() / (strFile + ".log");
+    if (!filesystem::exists(pathLog) && filesystem::exists(GetDataDir() / strFile))
+    {
+        LogPrintf("Converting %s to %s...\n", strFile, pathLog.string());
+        CLogDB::Index index;
+        if (!CDB::ReadAll(strFile, index))
+            return error("CDBEnv::OpenLogDb() : cannot read %s", strFile);
+
+        // Leave the Berkeley database self contained; it is not used again
+        CloseDb(strFile);
+        CheckpointLSN(strFile);
+        mapFileUseCount.erase(strFile);
+
+        filesystem::path pathNew = pathLog.string() + ".new";
+        if (!CLogDB::WriteSnapshot(pathNew, index) || !RenameOver(pathNew, pathLog))
+            return error("CDBEnv::OpenLogDb() : cannot write %s", pathLog.string());
+        LogPrintf("Converted %u records of %s\n", index.size(), strFile);
+    }
+
+    CLogDB* plog = new CLogDB(pathLog);
+    if (!plog->Load())
+    {
+        delete plog;
+        return false;
+    }
+    mapLogDb[strFile] = plog;
+    return true;
+}
+
 bool CDBEnv::RemoveDb(const string& strFile)
 {
     this->CloseDb(strFile);
@@ -344,6 +409,13 @@ bool CDBEnv::RemoveDb(const string& strFile)
 
 bool CDB::Rewrite(const string& strFile, const char* pszSkip)
 {
+    CLogDB* plog = bitdb.GetLogDb(strFile);
+    if (plog)
+    {
+        LogPrintf("Rewriting %s...\n", plog->GetPath().string());
+        return plog->Compact(pszSkip);
+    }
+
     while (true)
     {
         {
@@ -374,7 +446,7 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
                         fSuccess = false;
                     }
 
-                    Dbc* pcursor = db.GetCursor();
+                    CDBCursor* pcursor = db.GetCursor();
                     if (pcursor)
                         while (fSuccess)
                         {
@@ -436,9 +508,115 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
 }
 
 
+bool CDB::ReadAll(const string& strFile, CLogDB::Index& index)
+{
+    CDB db(strFile.c_str(), "r");
+    CDBCursor* pcursor = db.GetCursor();
+    if (!pcursor)
+        return false;
+    while (true)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        int ret = db.ReadAtCursor(pcursor, ssKey, ssValue, DB_NEXT);
+        if (ret == DB_NOTFOUND)
+            break;
+        if (ret != 0)
+        {
+            pcursor->close();
+            return false;
+        }
+        index[CSerializeData(ssKey.begin(), ssKey.end())] = CSerializeData(ssValue.begin(), ssValue.end());
+    }
+    pcursor->close();
+    return true;
+}
+
+bool CDB::ReadLog(const CDataStream& ssKey, CSerializeData& vchValue)
+{
+    CSerializeData vchKey(ssKey.begin(), ssKey.end());
+    if (plogTxn)
+    {
+        // See the open transaction's own writes
+        if (plogTxn->setErase.count(vchKey))
+            return false;
+        std::map<CSerializeData, CSerializeData, CLogDBKeyCompare>::const_iterator mi = plogTxn->mapWrite.find(vchKey);
+        if (mi != plogTxn->mapWrite.end())
+        {
+            vchValue = mi->second;
+            return true;
+        }
+    }
+    return plog->Read(vchKey, vchValue);
+}
+
+bool CDB::WriteLog(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite)
+{
+    if (!fOverwrite)
+    {
+        CSerializeData vchValue;
+        if (ReadLog(ssKey, vchValue))
+            return false;
+    }
+    CSerializeData vchKey(ssKey.begin(), ssKey.end());
+    CSerializeData vchValue(ssValue.begin(), ssValue.end());
+    if (plogTxn)
+    {
+        plogTxn->Write(vchKey, vchValue);
+        return true;
+    }
+    CLogDBBatch batch;
+    batch.Write(vchKey, vchValue);
+    return plog->Write(batch);
+}
+
+bool CDB::EraseLog(const CDataStream& ssKey)
+{
+    CSerializeData vchKey(ssKey.begin(), ssKey.end());
+    if (plogTxn)
+    {
+        plogTxn->Erase(vchKey);
+        return true;
+    }
+    CLogDBBatch batch;
+    batch.Erase(vchKey);
+    return plog->Write(batch);
+}
+
+int CDB::ReadLogAtCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags)
+{
+    CSerializeData vchKey, vchValue;
+    bool fFound;
+    if (fFlags == DB_SET_RANGE)
+        fFound = pcursor->plog->Seek(CSerializeData(ssKey.begin(), ssKey.end()), false, vchKey, vchValue);
+    else if (fFlags == DB_NEXT)
+        fFound = pcursor->plog->Seek(pcursor->vchKey, pcursor->fStarted, vchKey, vchValue);
+    else
+        return EINVAL;
+    if (!fFound)
+        return DB_NOTFOUND;
+    pcursor->vchKey = vchKey;
+    pcursor->fStarted = true;
+
+    ssKey.SetType(SER_DISK);
+    ssKey.clear();
+    ssKey.write(vchKey.empty() ? NULL : &vchKey[0], vchKey.size());
+    ssValue.SetType(SER_DISK);
+    ssValue.clear();
+    ssValue.write(vchValue.empty() ? NULL : &vchValue[0], vchValue.size());
+    return 0;
+}
+
+
 void CDBEnv::Flush(bool fShutdown)
 {
     int64_t nStart = GetTimeMillis();
+    {
+        // Record logs only need their appends made durable
+        LOCK(cs_db);
+        for (map<string, CLogDB*>::iterator mi = mapLogDb.begin(); mi != mapLogDb.end(); ++mi)
+            mi->second->Flush();
+    }
     // Flush log data to the actual data file
     //  on all files that are not in use
     LogPrint("db", "Flush(%s)%s\n", fShutdown ? "true" : "false", fDbEnvInit ? "" : " db not started");
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_DB_H
 #define BITCOIN_DB_H
 
+#include "logdb.h"
 #include "serialize.h"
 #include "sync.h"
 #include "version.h"
@@ -45,6 +46,8 @@ public:
     DbEnv dbenv;
     std::map<std::string, int> mapFileUseCount;
     std::map<std::string, Db*> mapDb;
+    /** Files kept in an append-only record log instead of a Berkeley database */
+    std::map<std::string, CLogDB*> mapLogDb;
 
     CDBEnv();
     ~CDBEnv();
@@ -75,6 +78,13 @@ public:
     void CheckpointLSN(const std::string& strFile);
 
     void CloseDb(const std::string& strFile);
+    /*
+     * Keep strFile in a record log from now on. The log is read from
+     * strFile.log; when there is none yet it is converted from the Berkeley
+     * database strFile, which is left in place untouched.
+     */
+    bool OpenLogDb(const std::string& strFile);
+    CLogDB* GetLogDb(const std::string& strFile);
     bool RemoveDb(const std::string& strFile);
 
     DbTxn *TxnBegin(int flags=DB_TXN_WRITE_NOSYNC)
@@ -90,13 +100,37 @@ public:
 extern CDBEnv bitdb;
 
 
+/** Cursor over the records of a CDB, for either kind of store */
+class CDBCursor
+{
+public:
+    Dbc* pcursor;
+    CLogDB* plog;
+    // Last key returned from a record log
+    CSerializeData vchKey;
+    bool fStarted;
+
+    CDBCursor(Dbc* pcursorIn, CLogDB* plogIn) : pcursor(pcursorIn), plog(plogIn), fStarted(false) {}
+
+    void close()
+    {
+        if (pcursor)
+            pcursor->close();
+        delete this;
+    }
+};
+
+
 /** RAII class that provides access to a Berkeley database */
 class CDB
 {
 protected:
     Db* pdb;
+    CLogDB* plog;
     std::string strFile;
     DbTxn *activeTxn;
+    // Writes of the open transaction when the file is a record log
+    CLogDBBatch* plogTxn;
     bool fReadOnly;
 
     explicit CDB(const std::string& strFilename, const char* pszMode="r+");
@@ -113,13 +147,29 @@ protected:
     template<typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plog)
+        {
+            CSerializeData vchValue;
+            if (!ReadLog(ssKey, vchValue))
+                return false;
+            try {
+                CDataStream ssValue(vchValue.begin(), vchValue.end(), SER_DISK, CLIENT_VERSION);
+                ssValue >> value;
+            }
+            catch (std::exception &e) {
+                return false;
+            }
+            return true;
+        }
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Read
@@ -148,7 +198,7 @@ protected:
     template<typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite=true)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
@@ -157,12 +207,16 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(&ssKey[0], ssKey.size());
 
         // Value
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
+
+        if (plog)
+            return WriteLog(ssKey, ssValue, fOverwrite);
+
+        Dbt datKey(&ssKey[0], ssKey.size());
         Dbt datValue(&ssValue[0], ssValue.size());
 
         // Write
@@ -177,7 +231,7 @@ protected:
     template<typename K>
     bool Erase(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
@@ -186,6 +240,8 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (plog)
+            return EraseLog(ssKey);
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Erase
@@ -199,13 +255,18 @@ protected:
     template<typename K>
     bool Exists(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (plog)
+        {
+            CSerializeData vchValue;
+            return ReadLog(ssKey, vchValue);
+        }
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Exists
@@ -216,19 +277,30 @@ protected:
         return (ret == 0);
     }
 
-    Dbc* GetCursor()
+    bool ReadLog(const CDataStream& ssKey, CSerializeData& vchValue);
+    bool WriteLog(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite);
+    bool EraseLog(const CDataStream& ssKey);
+    int ReadLogAtCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags);
+
+    CDBCursor* GetCursor()
     {
+        if (plog)
+            return new CDBCursor(NULL, plog);
         if (!pdb)
             return NULL;
         Dbc* pcursor = NULL;
         int ret = pdb->cursor(NULL, &pcursor, 0);
         if (ret != 0)
             return NULL;
-        return pcursor;
+        return new CDBCursor(pcursor, NULL);
     }
 
-    int ReadAtCursor(Dbc* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags=DB_NEXT)
+    int ReadAtCursor(CDBCursor* pcursorIn, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags=DB_NEXT)
     {
+        if (pcursorIn->plog)
+            return ReadLogAtCursor(pcursorIn, ssKey, ssValue, fFlags);
+        Dbc* pcursor = pcursorIn->pcursor;
+
         // Read at cursor
         Dbt datKey;
         if (fFlags == DB_SET || fFlags == DB_SET_RANGE || fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE)
@@ -269,6 +341,13 @@ protected:
 public:
     bool TxnBegin()
     {
+        if (plog)
+        {
+            if (plogTxn)
+                return false;
+            plogTxn = new CLogDBBatch();
+            return true;
+        }
         if (!pdb || activeTxn)
             return false;
         DbTxn* ptxn = bitdb.TxnBegin();
@@ -280,6 +359,15 @@ public:
 
     bool TxnCommit()
     {
+        if (plog)
+        {
+            if (!plogTxn)
+                return false;
+            bool ret = plog->Write(*plogTxn);
+            delete plogTxn;
+            plogTxn = NULL;
+            return ret;
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->commit(0);
@@ -289,6 +377,14 @@ public:
 
     bool TxnAbort()
     {
+        if (plog)
+        {
+            if (!plogTxn)
+                return false;
+            delete plogTxn;
+            plogTxn = NULL;
+            return true;
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->abort();
@@ -308,6 +404,8 @@ public:
     }
 
     bool static Rewrite(const std::string& strFile, const char* pszSkip = NULL);
+    /** Read every record of the Berkeley database strFile */
+    bool static ReadAll(const std::string& strFile, CLogDB::Index& index);
 };
 
 #endif // BITCOIN_DB_H
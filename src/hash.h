@@ -184,4 +184,10 @@ int HMAC_SHA512_Init(HMAC_SHA512_CTX *pctx, const void *pkey, size_t len);
 int HMAC_SHA512_Update(HMAC_SHA512_CTX *pctx, const void *pdata, size_t len);
 int HMAC_SHA512_Final(unsigned char *pmd, HMAC_SHA512_CTX *pctx);
 void BIP32Hash(const unsigned char chainCode[32], unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
+
+/** SipHash-2-4 of a 256-bit value, keyed by (k0, k1).
+ *  Cheap keyed hash for short IDs and salted in-memory tables; not a
+ *  cryptographic commitment.
+ */
+uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 #endif
@@ -9,15 +9,18 @@
 #include "main.h"
 #include "chainparams.h"
 #include "txdb.h"
+#include "perfstats.h"
 #include "rpcserver.h"
 #include "net.h"
 #include "main.h"
 #include "key.h"
 #include "pubkey.h"
+#include "sigcache.h"
 #include "util.h"
 #include "ui_interface.h"
 #include "checkpoints.h"
 #include "darksend-relay.h"
+#include "instantx.h"
 #include "masternode-active.h"
 #include "masternode-payments.h"
 #include "masternode.h"
@@ -202,11 +205,23 @@ std::string HelpMessage()
 #endif
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", _("Set database cache size in megabytes (default: 100)"));
+    strUsage += HelpMessageOpt("-dbprofile=<profile>", strprintf(_("Block index database tuning: steady, sync (initial download) or lowmem (default: %s)"), DEFAULT_DB_PROFILE));
+    strUsage += HelpMessageOpt("-dbwritebuffer=<n>", _("Set database write buffer size in megabytes (profile default)"));
+    strUsage += HelpMessageOpt("-dbmaxopenfiles=<n>", _("Keep at most <n> database files open (profile default)"));
+    strUsage += HelpMessageOpt("-dbblocksize=<n>", _("Set database block size in kilobytes (profile default)"));
+    strUsage += HelpMessageOpt("-dbfilesize=<n>", _("Set database table file size in megabytes (profile default)"));
+    strUsage += HelpMessageOpt("-dbl0compaction=<n>", _("Compact level-0 database files when there are <n> of them (profile default)"));
+    strUsage += HelpMessageOpt("-dbl0slowdown=<n>", _("Slow down database writes at <n> level-0 files (profile default)"));
+    strUsage += HelpMessageOpt("-dbl0stop=<n>", _("Stop database writes at <n> level-0 files until compaction catches up (profile default)"));
+    strUsage += HelpMessageOpt("-dbcompression", _("Compress new database blocks; older versions cannot read them (default: 0)"));
+    strUsage += HelpMessageOpt("-dbsync", _("Sync block index writes to disk once the chain is synced (default: 0)"));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000?.dat file"));
     strUsage += HelpMessageOpt("-maxorphanblocks=<n>", strprintf(_("Keep at most <n> unconnectable blocks in memory (default: %u)"), DEFAULT_MAX_ORPHAN_BLOCKS));
+    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", _("Specify pid file (default: monkeyd.pid)"));
 #endif
+    strUsage += HelpMessageOpt("-replayblocks=<file>", _("Connect the blocks in a bootstrap or blk000??.dat file into an empty data directory with networking, staking, masternodes and the wallet off, print blocks/s, tx/s, sigops/s and time per validation stage, and exit. Can be given more than once"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-resync", _("Delete blockchain folders and resync from scratch") + " " + _("on startup"));
 
@@ -216,6 +231,7 @@ std::string HelpMessage()
     strUsage += HelpMessageOpt("-banscore=<n>", _("Threshold for disconnecting misbehaving peers (default: 100)"));
     strUsage += HelpMessageOpt("-bantime=<n>", _("Number of seconds to keep misbehaving peers from reconnecting (default: 86400)"));
     strUsage += HelpMessageOpt("-bind=<addr>", _("Bind to given address. Use [host]:port notation for IPv6"));
+    strUsage += HelpMessageOpt("-compactblocks", _("Download new blocks as compact blocks rebuilt from the memory pool when peers support it (default: 1)"));
     strUsage += HelpMessageOpt("-connect=<ip>", _("Connect only to the specified node(s)"));
     strUsage += HelpMessageOpt("-discover", _("Discover own IP address (default: 1 when listening and no -externalip)"));
     strUsage += HelpMessageOpt("-dns", _("Allow DNS lookups for -addnode, -seednode and -connect"));
@@ -253,6 +269,7 @@ std::string HelpMessage()
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions"));
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet.dat"));
     strUsage += HelpMessageOpt("-upgradewallet", _("Upgrade wallet to latest format"));
+    strUsage += HelpMessageOpt("-walletlog", _("Keep the wallet in an append-only record log (<wallet>.log), converting the wallet file on first use; once converted the log is always used (default: 0)"));
     strUsage += HelpMessageOpt("-confchange", _("Require a confirmations for change (default: 0)"));
     strUsage += HelpMessageOpt("-mininput=<amt>", _("When creating transactions, ignore inputs with value less than this (default: 0.01)"));
     strUsage += HelpMessageOpt("-zapwallettxes=<mode>", _("Delete all wallet transactions and only recover those parts of the blockchain through -rescan on startup") +
@@ -270,6 +287,9 @@ std::string HelpMessage()
     string debugCategories = "addrman, alert, db, lock, rand, rpc, selectcoins, mempool, net, stakemodifier, coinstake, coinage, creation, monkey, (darksend, instantx, masternode, mnpayments)"; // Don't translate these and qt below
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + ". " +
         _("If <category> is not supplied, output all debugging information.") + _("<category> can be:") + " " + debugCategories + ".");
+    strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> MiB (default: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE));
+    strUsage += HelpMessageOpt("-lockprofile", strprintf(_("Count lock acquisitions, waits and hold times per LOCK site, see getlockstats (default: %u)"), 0));
+    strUsage += HelpMessageOpt("-perflog=<n>", _("Write timing percentiles of block validation, mining, masternode and P2P message processing to debug.log every <n> seconds (default: 0, see getperfstats)"));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), 0));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), 1));
     strUsage += HelpMessageOpt("-printtoconsole", strprintf(_("Send trace/debug info to console instead of debug.log file (default: %u)"), 0));
@@ -314,7 +334,9 @@ std::string HelpMessage()
     strUsage += HelpMessageOpt("-rpcpassword=<pw>", _("Password for JSON-RPC connections"));
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), 8101, 8102));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
-    strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), 4));
+    strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_RPC_THREADS));
+    strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf(_("Set the depth of the work queue to service RPC calls (default: %d)"), DEFAULT_RPC_WORK_QUEUE));
+    strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf(_("Timeout during HTTP requests (default: %d)"), DEFAULT_RPC_SERVER_TIMEOUT));
     if (!fHaveGUI)
     {
         strUsage += HelpMessageOpt("-rpcconnect=<ip>", _("Send commands to node running on <ip> (default: 127.0.0.1)"));
@@ -362,7 +384,47 @@ struct CImportingNow
     }
 };
 
-void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
+// -replayblocks: connect the files into an empty datadir, then report
+// throughput and where the time went. The report goes to stdout as well,
+// since a replay is run by hand and compared across settings.
+static void ReplayBlockFiles(const std::vector<boost::filesystem::path>& vReplayFiles)
+{
+    CImportStats stats;
+    ResetPerfStats();
+    int64_t nStart = GetPerfTimeMicros();
+    for (const boost::filesystem::path &path : vReplayFiles) {
+        FILE *file = fopen(path.string().c_str(), "rb");
+        if (!file) {
+            LogPrintf("Warning: Could not open blocks file %s\n", path.string());
+            continue;
+        }
+        CImportingNow imp;
+        LogPrintf("Replaying blocks file %s...\n", path.string());
+        LoadExternalBlockFile(file, NULL, &stats);
+    }
+    double dSeconds = std::max(GetPerfTimeMicros() - nStart, (int64_t)1) / 1e6;
+
+    const CDBTuning& tuning = GetDBTuning();
+    std::string strReport = strprintf("Replayed %u blocks, %u transactions, %u sigops to height %d in %.1fs (dbprofile=%s dbcache=%d par=%d)\n",
+        stats.nBlocks, stats.nTransactions, stats.nSigOps, nBestHeight, dSeconds, tuning.pszProfile, tuning.nCacheMB, nScriptCheckThreads);
+    strReport += strprintf("%.1f blocks/s, %.1f tx/s, %.1f sigops/s\n",
+        stats.nBlocks / dSeconds, stats.nTransactions / dSeconds, stats.nSigOps / dSeconds);
+    strReport += strprintf("%-20s %10s %12s %10s %10s %7s\n", "stage", "count", "total_ms", "avg_us", "p99_us", "share");
+    for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+        CPerfSummary summary;
+        GetPerfHistogram((PerfStage)i).GetSummary(summary);
+        if (summary.nCount == 0)
+            continue;
+        strReport += strprintf("%-20s %10u %12.1f %10u %10u %6.1f%%\n", GetPerfStageName((PerfStage)i), summary.nCount,
+            summary.nTotal / 1e3, summary.nTotal / summary.nCount, summary.nP99, summary.nTotal / 1e4 / dSeconds);
+    }
+
+    LogPrintf("%s", strReport);
+    fprintf(stdout, "%s", strReport.c_str());
+    fflush(stdout);
+}
+
+void ThreadImport(std::vector<boost::filesystem::path> vImportFiles, std::vector<boost::filesystem::path> vReplayFiles)
 {
     RenameThread("monk-loadblk");
 
@@ -412,6 +474,12 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         }
     }
 
+    if (!vReplayFiles.empty()) {
+        ReplayBlockFiles(vReplayFiles);
+        StartShutdown();
+        return;
+    }
+
     if (GetBoolArg("-stopafterblockimport", false)) {
         LogPrintf("Stopping after block import\n");
         StartShutdown();
@@ -537,6 +605,22 @@ bool AppInit2(boost::thread_group& threadGroup)
             LogPrintf("AppInit2 : parameter interaction: -externalip set -> setting -discover=0\n");
     }
 
+    if (mapArgs.count("-replayblocks")) {
+        // a replay measures validation alone, on the same input every time
+        const char* const pszOff[] = { "-listen", "-dnsseed", "-upnp", "-discover", "-staking", "-masternode" };
+        for (unsigned int i = 0; i < sizeof(pszOff) / sizeof(pszOff[0]); i++)
+            if (SoftSetBoolArg(pszOff[i], false))
+                LogPrintf("AppInit2 : parameter interaction: -replayblocks set -> setting %s=0\n", pszOff[i]);
+        if (SoftSetArg("-connect", "0")) {
+            mapMultiArgs["-connect"].push_back("0");
+            LogPrintf("AppInit2 : parameter interaction: -replayblocks set -> setting -connect=0\n");
+        }
+        if (SoftSetBoolArg("-litemode", true))
+            LogPrintf("AppInit2 : parameter interaction: -replayblocks set -> setting -litemode=1\n");
+        if (SoftSetBoolArg("-disablewallet", true))
+            LogPrintf("AppInit2 : parameter interaction: -replayblocks set -> setting -disablewallet=1\n");
+    }
+
     if (GetBoolArg("-salvagewallet", false)) {
         // Rewrite just private keys: rescan to find transactions
         if (SoftSetBoolArg("-rescan", true))
@@ -573,6 +657,16 @@ bool AppInit2(boost::thread_group& threadGroup)
     fPrintToConsole = GetBoolArg("-printtoconsole", false);
     fLogTimestamps = GetBoolArg("-logtimestamps", true);
     fLogIPs = GetBoolArg("-logips", false);
+    fCompactBlocks = GetBoolArg("-compactblocks", true);
+
+    // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
+    nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
+    if (nScriptCheckThreads <= 0)
+        nScriptCheckThreads += boost::thread::hardware_concurrency();
+    if (nScriptCheckThreads <= 1)
+        nScriptCheckThreads = 0;
+    else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
+        nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
 #ifdef ENABLE_WALLET
     bool fDisableWallet = GetBoolArg("-disablewallet", false);
@@ -596,6 +690,10 @@ bool AppInit2(boost::thread_group& threadGroup)
 #endif
 
     fConfChange = GetBoolArg("-confchange", false);
+    SetLockProfiling(GetBoolArg("-lockprofile", false));
+
+    if (mapArgs.count("-dbprofile") && !FindDBProfile(mapArgs["-dbprofile"]))
+        return InitError(strprintf(_("Unknown database profile -dbprofile: '%s'"), mapArgs["-dbprofile"]));
 
 #ifdef ENABLE_WALLET
     if (mapArgs.count("-mininput"))
@@ -635,6 +733,7 @@ bool AppInit2(boost::thread_group& threadGroup)
 
     if (GetBoolArg("-shrinkdebugfile", !fDebug))
         ShrinkDebugFile();
+    StartLogWriter();
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("Monkey version %s (%s)\n", FormatFullVersion(), CLIENT_DATE);
     LogPrintf("Using OpenSSL version %s\n", SSLeay_version(SSLEAY_VERSION));
@@ -644,6 +743,14 @@ bool AppInit2(boost::thread_group& threadGroup)
     LogPrintf("Used data directory %s\n", strDataDir);
     std::ostringstream strErrors;
 
+    InitSignatureCache();
+
+    if (nScriptCheckThreads) {
+        LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadScriptCheck);
+    }
+
     if (mapArgs.count("-sporkkey")) // spork priv key
     {
         if (!sporkManager.SetPrivKey(GetArg("-sporkkey", "")))
@@ -673,6 +780,11 @@ bool AppInit2(boost::thread_group& threadGroup)
                 backupPathStr += "/" + strWalletFileName;
                 std::string sourcePathStr = GetDataDir().string();
                 sourcePathStr += "/" + strWalletFileName;
+                if (filesystem::exists(sourcePathStr + ".log")) {
+                    // The wallet is kept in a record log, back that up instead
+                    sourcePathStr += ".log";
+                    backupPathStr += ".log";
+                }
                 boost::filesystem::path sourceFile = sourcePathStr;
                 boost::filesystem::path backupFile = backupPathStr + dateTimeStr;
                 sourceFile.make_preferred();
@@ -768,13 +880,16 @@ bool AppInit2(boost::thread_group& threadGroup)
             }
         }
 
-        if (GetBoolArg("-salvagewallet", false)) {
+        // Once converted, the record log is the wallet; it checks itself when loaded
+        bool fWalletLog = filesystem::exists(GetDataDir() / (strWalletFileName + ".log"));
+
+        if (!fWalletLog && GetBoolArg("-salvagewallet", false)) {
             // Recover readable keypairs:
             if (!CWalletDB::Recover(bitdb, strWalletFileName, true))
                 return false;
         }
 
-        if (filesystem::exists(GetDataDir() / strWalletFileName)) {
+        if (!fWalletLog && filesystem::exists(GetDataDir() / strWalletFileName)) {
             CDBEnv::VerifyResult r = bitdb.Verify(strWalletFileName, CWalletDB::Recover);
             if (r == CDBEnv::RECOVER_OK) {
                 string msg = strprintf(_("Warning: wallet.dat corrupt, data salvaged!"
@@ -787,6 +902,11 @@ bool AppInit2(boost::thread_group& threadGroup)
                 return InitError(_("wallet.dat corrupt, salvage failed"));
         }
 
+        if (fWalletLog || GetBoolArg("-walletlog", false)) {
+            if (!bitdb.OpenLogDb(strWalletFileName))
+                return InitError(strprintf(_("Error loading wallet log %s.log"), strWalletFileName));
+        }
+
     } // (!fDisableWallet)
 #endif // ENABLE_WALLET
     // ********************************************************* Step 6: network initialization
@@ -1014,6 +1134,9 @@ bool AppInit2(boost::thread_group& threadGroup)
     }
     LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
 
+    if (mapArgs.count("-replayblocks") && nBestHeight > 0)
+        return InitError(_("-replayblocks needs an empty data directory"));
+
     if (GetBoolArg("-printblockindex", false) || GetBoolArg("-printblocktree", false))
     {
         PrintBlockTree();
@@ -1176,7 +1299,12 @@ bool AppInit2(boost::thread_group& threadGroup)
         for (string strFile : mapMultiArgs["-loadblock"])
             vImportFiles.push_back(strFile);
     }
-    threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+    std::vector<boost::filesystem::path> vReplayFiles;
+    if (mapArgs.count("-replayblocks")) {
+        for (string strFile : mapMultiArgs["-replayblocks"])
+            vReplayFiles.push_back(strFile);
+    }
+    threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles, vReplayFiles));
 
     // ********************************************************* Step 10: load peers
 
@@ -1323,6 +1451,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     darkSendPool.InitCollateralAddress();
 
     threadGroup.create_thread(boost::bind(&ThreadCheckDarkSendPool));
+    threadGroup.create_thread(boost::bind(&ThreadInstantXVotes));
 
     // ********************************************************* Step 12: start node
 
@@ -1392,5 +1521,9 @@ bool AppInit2(boost::thread_group& threadGroup)
     }
 #endif
 
+    int64_t nPerfLogInterval = GetArg("-perflog", 0);
+    if (nPerfLogInterval > 0)
+        threadGroup.create_thread(boost::bind(&LoopForever<void (*)()>, "perflog", &LogPerfStats, nPerfLogInterval * 1000));
+
     return !fRequestShutdown;
 }
@@ -17,10 +17,12 @@
 #include "util.h"
 #include "txdb.h"
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 using namespace boost;
 
+CCriticalSection cs_instantx;
 std::map<uint256, CTransaction> mapTxLockReq;
 std::map<uint256, CTransaction> mapTxLockReqRejected;
 std::map<uint256, CConsensusVote> mapTxLockVote;
@@ -29,6 +31,23 @@ std::map<COutPoint, uint256> mapLockedInputs;
 std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
 int nCompleteTXLocks;
 
+// Masternodes allowed to vote on locks at one height, best rank first.
+// Scoring the whole masternode list is expensive, so it is done once per
+// height and reused for every vote until the entry goes stale.
+struct CInstantXQuorum
+{
+    std::vector<CTxIn> vecMasternodes;
+    int64_t nTime;
+};
+static std::map<int, CInstantXQuorum> mapQuorums;
+static const int64_t INSTANTX_QUORUM_CACHE_SECONDS = 60;
+
+// Votes waiting for the verification thread, with the peer that sent them
+static std::vector<std::pair<CConsensusVote, CNode*> > vPendingVotes;
+static boost::mutex mutexPendingVotes;
+static boost::condition_variable condPendingVotes;
+static const unsigned int MAX_PENDING_VOTES = 10000;
+
 //txlock - Locks transaction
 //
 //step 1.) Broadcast intention to lock transaction inputs, "ix", CTransaction
@@ -52,8 +71,11 @@ void ProcessMessageInstantX(CNode* pfrom, std::string& strCommand, CDataStream&
         CInv inv(MSG_TXLOCK_REQUEST, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash()))
-            return;
+        {
+            LOCK(cs_instantx);
+            if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash()))
+                return;
+        }
 
         if (!IsIXTXValid(tx))
             return;
@@ -85,7 +107,10 @@ void ProcessMessageInstantX(CNode* pfrom, std::string& strCommand, CDataStream&
 
             DoConsensusVote(tx, nBlockHeight);
 
-            mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+            {
+                LOCK(cs_instantx);
+                mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+            }
 
             LogPrintf("ProcessMessageInstantX::ix - Transaction Lock Request: %s %s : accepted %s\n",
                 pfrom->addr.ToString(), pfrom->cleanSubVer, tx.GetHash().ToString()
@@ -96,6 +121,7 @@ void ProcessMessageInstantX(CNode* pfrom, std::string& strCommand, CDataStream&
         }
         else
         {
+            LOCK(cs_instantx);
             mapTxLockReqRejected.insert(make_pair(tx.GetHash(), tx));
 
             // can we get the conflicting transaction as proof?
@@ -115,17 +141,9 @@ void ProcessMessageInstantX(CNode* pfrom, std::string& strCommand, CDataStream&
                 //we only care if we have a complete tx lock
                 if ((*i).second.CountSignatures() >= INSTANTX_SIGNATURES_REQUIRED)
                 {
+                    // the conflicting transaction stays until a block or reorg replaces it
                     if (!CheckForConflictingLocks(tx))
-                    {
                         LogPrintf("ProcessMessageInstantX::ix - Found Existing Complete IX Lock\n");
-
-                        //reprocess the last 15 blocks
-                        CBlockIndex* pindex = nullptr;
-                        CBlock block;
-                        CTxDB txdb("r");
-                        block.DisconnectBlock(txdb, pindex);
-                        tx.DisconnectInputs(txdb);
-                    }
                 }
             }
 
@@ -140,36 +158,20 @@ void ProcessMessageInstantX(CNode* pfrom, std::string& strCommand, CDataStream&
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash()))
-            return;
+        {
+            LOCK(cs_instantx);
+            if (mapTxLockVote.count(ctx.GetHash()))
+                return;
 
-        mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx));
+            mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx));
+        }
 
-        if (ProcessConsensusVote(pfrom, ctx))
+        // the quorum and signature checks run on the vote thread; forget a
+        // dropped vote so a later copy of it is not ignored as a duplicate
+        if (!QueueConsensusVote(pfrom, ctx))
         {
-            //Spam/Dos protection
-            /*
-                Masternodes will sometimes propagate votes before the transaction is known to the client.
-                This tracks those messages and allows it at the same rate of the rest of the network, if
-                a peer violates it, it will simply be ignored
-            */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash))
-            {
-                if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash))
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
-
-                if (mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60 * 10)
-                {
-                    LogPrintf("ProcessMessageInstantX::txlvote - masternode is spamming transaction votes: %s %s\n",
-                        ctx.vinMasternode.ToString(),
-                        ctx.txHash.ToString()
-                    );
-                    return;
-                } else
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime()+(60*10);
-            }
-            RelayInventory(inv);
+            LOCK(cs_instantx);
+            mapTxLockVote.erase(ctx.GetHash());
         }
 
         return;
@@ -226,26 +228,53 @@ bool IsIXTXValid(const CTransaction& txCollateral)
     return true;
 }
 
+// Depth of the block that holds an input's previous transaction, read from
+// the tx index and the block header alone; 0 if unconfirmed or unknown
+static int GetLockInputAge(CTxDB& txdb, const COutPoint& prevout)
+{
+    if (mempool.exists(prevout.hash))
+        return 0;
+
+    CTxIndex txindex;
+    if (!txdb.ReadTxIndex(prevout.hash, txindex))
+        return 0;
+
+    CBlock block;
+    if (!block.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false))
+        return 0;
+
+    std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(block.GetHash());
+    if (mi == mapBlockIndex.end())
+        return 0;
+    return pindexBest->nHeight - mi->second->nHeight;
+}
+
 int64_t CreateNewLock(CTransaction tx)
 {
     int64_t nTxAge = 0;
-    BOOST_REVERSE_FOREACH(CTxIn i, tx.vin)
+    int nBlockHeight = 0;
     {
-        nTxAge = GetInputAge(i);
-        if (nTxAge < 5) //1 less than the "send IX" gui requires, incase of a block propagating the network at the time
+        LOCK(cs_main);
+        CTxDB txdb("r");
+        BOOST_REVERSE_FOREACH(const CTxIn& i, tx.vin)
         {
-            LogPrintf("CreateNewLock - Transaction not found / too new: %d / %s\n", nTxAge, tx.GetHash().ToString());
-            return 0;
+            nTxAge = GetLockInputAge(txdb, i.prevout);
+            if (nTxAge < 5) //1 less than the "send IX" gui requires, incase of a block propagating the network at the time
+            {
+                LogPrintf("CreateNewLock - Transaction not found / too new: %d / %s\n", nTxAge, tx.GetHash().ToString());
+                return 0;
+            }
         }
-    }
 
-    /*
-        Use a blockheight newer than the input.
-        This prevents attackers from using transaction mallibility to predict which masternodes
-        they'll use.
-    */
-    int nBlockHeight = (pindexBest->nHeight - nTxAge) + 4;
+        /*
+            Use a blockheight newer than the input.
+            This prevents attackers from using transaction mallibility to predict which masternodes
+            they'll use.
+        */
+        nBlockHeight = (pindexBest->nHeight - nTxAge) + 4;
+    }
 
+    LOCK(cs_instantx);
     if (!mapTxLocks.count(tx.GetHash()))
     {
         LogPrintf("CreateNewLock - New Transaction Lock %s !\n", tx.GetHash().ToString());
@@ -266,22 +295,49 @@ int64_t CreateNewLock(CTransaction tx)
     return nBlockHeight;
 }
 
+// Rank of a masternode in the quorum voting on locks at nBlockHeight,
+// from 1 to INSTANTX_SIGNATURES_TOTAL, or -1 if it is not in the quorum
+static int GetQuorumRank(const CTxIn& vin, int nBlockHeight)
+{
+    std::vector<CTxIn> vecQuorum;
+    {
+        LOCK(cs_instantx);
+        std::map<int, CInstantXQuorum>::iterator it = mapQuorums.find(nBlockHeight);
+        if (it != mapQuorums.end() && GetTime() - it->second.nTime < INSTANTX_QUORUM_CACHE_SECONDS)
+            vecQuorum = it->second.vecMasternodes;
+    }
+
+    if (vecQuorum.empty())
+    {
+        vecQuorum = mnodeman.GetMasternodeQuorum(nBlockHeight, INSTANTX_SIGNATURES_TOTAL, MIN_INSTANTX_PROTO_VERSION);
+        if (vecQuorum.empty())
+            return -1;
+
+        LOCK(cs_instantx);
+        CInstantXQuorum& quorum = mapQuorums[nBlockHeight];
+        quorum.vecMasternodes = vecQuorum;
+        quorum.nTime = GetTime();
+    }
+
+    for (unsigned int i = 0; i < vecQuorum.size(); i++)
+        if (vecQuorum[i].prevout == vin.prevout)
+            return i + 1;
+    return -1;
+}
+
 // check if we need to vote on this transaction
 void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
 {
     if (!fMasterNode) return;
 
-    int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+    int n = GetQuorumRank(activeMasternode.vin, nBlockHeight);
 
     if (n == -1)
     {
-        LogPrint("instantx", "InstantX::DoConsensusVote - Unknown Masternode\n");
-        return;
-    }
-
-    if (n > INSTANTX_SIGNATURES_TOTAL)
-    {
-        LogPrint("instantx", "InstantX::DoConsensusVote - Masternode not in the top %d (%d)\n", INSTANTX_SIGNATURES_TOTAL, n);
+        if (mnodeman.Find(activeMasternode.vin) == NULL)
+            LogPrint("instantx", "InstantX::DoConsensusVote - Unknown Masternode\n");
+        else
+            LogPrint("instantx", "InstantX::DoConsensusVote - Masternode not in the top %d\n", INSTANTX_SIGNATURES_TOTAL);
         return;
     }
 
@@ -305,17 +361,33 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    {
+        LOCK(cs_instantx);
+        mapTxLockVote[ctx.GetHash()] = ctx;
+    }
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
 
     RelayInventory(inv);
 }
 
-//received a consensus vote
-bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
+bool QueueConsensusVote(CNode* pnode, const CConsensusVote& ctx)
+{
+    boost::unique_lock<boost::mutex> lock(mutexPendingVotes);
+    if (vPendingVotes.size() >= MAX_PENDING_VOTES)
+    {
+        LogPrint("instantx", "InstantX::QueueConsensusVote - Too many pending votes, dropping %s\n", ctx.GetHash().ToString());
+        return false;
+    }
+    vPendingVotes.push_back(make_pair(ctx, pnode->AddRef()));
+    condPendingVotes.notify_one();
+    return true;
+}
+
+// Quorum and signature checks of a received vote; needs no InstantX state
+static bool CheckConsensusVote(CNode* pnode, CConsensusVote& ctx)
 {
-    int n = mnodeman.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
+    int n = GetQuorumRank(ctx.vinMasternode, ctx.nBlockHeight);
 
     CMasternode* pmn = mnodeman.Find(ctx.vinMasternode);
     if (pmn != NULL)
@@ -323,15 +395,14 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
 
     if (n == -1)
     {
-        //can be caused by past versions trying to vote with an invalid protocol
-        LogPrint("instantx", "InstantX::ProcessConsensusVote - Unknown Masternode\n");
-        mnodeman.AskForMN(pnode, ctx.vinMasternode);
-        return false;
-    }
-
-    if (n > INSTANTX_SIGNATURES_TOTAL)
-    {
-        LogPrint("instantx", "InstantX::ProcessConsensusVote - Masternode not in the top %d (%d) - %s\n", INSTANTX_SIGNATURES_TOTAL, n, ctx.GetHash().ToString());
+        if (pmn == NULL)
+        {
+            //can be caused by past versions trying to vote with an invalid protocol
+            LogPrint("instantx", "InstantX::ProcessConsensusVote - Unknown Masternode\n");
+            mnodeman.AskForMN(pnode, ctx.vinMasternode);
+        }
+        else
+            LogPrint("instantx", "InstantX::ProcessConsensusVote - Masternode not in the top %d - %s\n", INSTANTX_SIGNATURES_TOTAL, ctx.GetHash().ToString());
         return false;
     }
 
@@ -343,7 +414,17 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         return false;
     }
 
-    if (!mapTxLocks.count(ctx.txHash))
+    return true;
+}
+
+// Add a verified vote to its lock. Returns whether the lock became or
+// stayed complete without conflicts. Requires cs_instantx.
+static bool ApplyConsensusVote(const CConsensusVote& ctx)
+{
+    AssertLockHeld(cs_instantx);
+
+    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
+    if (i == mapTxLocks.end())
     {
         LogPrintf("InstantX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString());
 
@@ -352,65 +433,131 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         newLock.nExpiration = GetTime() + (20 * 60);
         newLock.nTimeout = GetTime() + (60 * 5);
         newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(make_pair(ctx.txHash, newLock));
+        i = mapTxLocks.insert(make_pair(ctx.txHash, newLock)).first;
     } else
         LogPrint("instantx", "InstantX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString());
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
-    if (i != mapTxLocks.end())
+    CTransactionLock& txLock = (*i).second;
+    txLock.AddSignature(ctx);
+
+    int nSignatures = txLock.CountSignatures();
+    LogPrint("instantx", "InstantX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", nSignatures, ctx.GetHash().ToString());
+
+    if (nSignatures < INSTANTX_SIGNATURES_REQUIRED)
+        return false;
+
+    LogPrint("instantx", "InstantX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", txLock.GetHash().ToString());
+
+    std::map<uint256, CTransaction>::iterator mi = mapTxLockReq.find(ctx.txHash);
+    if (mi == mapTxLockReq.end())
+        return true;
+
+    CTransaction& tx = mi->second;
+    if (CheckForConflictingLocks(tx))
+        return false;
+
+    for (const CTxIn& in : tx.vin)
+        if (!mapLockedInputs.count(in.prevout))
+            mapLockedInputs.insert(make_pair(in.prevout, ctx.txHash));
+
+    //if this tx lock was rejected, the conflicting transaction stays until a block or reorg replaces it
+    if (mapTxLockReqRejected.count(txLock.txHash))
+        LogPrintf("InstantX::ProcessConsensusVote - Complete lock for rejected transaction %s\n", txLock.txHash.ToString());
+
+    return true;
+}
+
+// Verify a batch of votes, then apply the valid ones under a single lock
+static void ProcessConsensusVotes(std::vector<std::pair<CConsensusVote, CNode*> >& vBatch)
+{
+    std::vector<std::pair<CConsensusVote, CNode*> > vValid;
+    for (unsigned int i = 0; i < vBatch.size(); i++)
+        if (CheckConsensusVote(vBatch[i].second, vBatch[i].first))
+            vValid.push_back(vBatch[i]);
+
+    if (vValid.empty())
+        return;
+
+    std::vector<CInv> vRelay;
+    std::vector<uint256> vComplete;
     {
-        (*i).second.AddSignature(ctx);
+        LOCK(cs_instantx);
+        for (unsigned int i = 0; i < vValid.size(); i++)
+        {
+            const CConsensusVote& ctx = vValid[i].first;
+            if (ApplyConsensusVote(ctx))
+                vComplete.push_back(ctx.txHash);
+
+            //Spam/Dos protection
+            /*
+                Masternodes will sometimes propagate votes before the transaction is known to the client.
+                This tracks those messages and allows it at the same rate of the rest of the network, if
+                a peer violates it, it will simply be ignored
+            */
+            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash))
+            {
+                if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash))
+                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
+
+                if (mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
+                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60 * 10)
+                {
+                    LogPrintf("ProcessMessageInstantX::txlvote - masternode is spamming transaction votes: %s %s\n",
+                        ctx.vinMasternode.ToString(),
+                        ctx.txHash.ToString()
+                    );
+                    continue;
+                } else
+                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime()+(60*10);
+            }
+            vRelay.push_back(CInv(MSG_TXLOCK_VOTE, ctx.GetHash()));
+        }
+    }
 
 #ifdef ENABLE_WALLET
-        if (pwalletMain)
+    if (pwalletMain)
+    {
         {
+            LOCK(pwalletMain->cs_wallet);
             //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
-            if (pwalletMain->mapRequestCount.count(ctx.txHash))
-                pwalletMain->mapRequestCount[ctx.txHash]++;
+            for (unsigned int i = 0; i < vValid.size(); i++)
+                if (pwalletMain->mapRequestCount.count(vValid[i].first.txHash))
+                    pwalletMain->mapRequestCount[vValid[i].first.txHash]++;
         }
+
+        BOOST_FOREACH(const uint256& hash, vComplete)
+            if (pwalletMain->UpdatedTransaction(hash))
+                nCompleteTXLocks++;
+    }
 #endif
 
-        LogPrint("instantx", "InstantX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", (*i).second.CountSignatures(), ctx.GetHash().ToString());
+    BOOST_FOREACH(const CInv& inv, vRelay)
+        RelayInventory(inv);
+}
 
-        if ((*i).second.CountSignatures() >= INSTANTX_SIGNATURES_REQUIRED)
-        {
-            LogPrint("instantx", "InstantX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString());
+void ThreadInstantXVotes()
+{
+    if (fLiteMode) return; //disable all darksend/masternode related functionality
 
-            CTransaction& tx = mapTxLockReq[ctx.txHash];
-            if (!CheckForConflictingLocks(tx))
-            {
-#ifdef ENABLE_WALLET
-                if (pwalletMain)
-                    if (pwalletMain->UpdatedTransaction((*i).second.txHash))
-                        nCompleteTXLocks++;
-#endif
+    RenameThread("monkey-ixvotes");
 
-                if (mapTxLockReq.count(ctx.txHash))
-                {
-                    for (const CTxIn& in : tx.vin)
-                        if (!mapLockedInputs.count(in.prevout))
-                            mapLockedInputs.insert(make_pair(in.prevout, ctx.txHash));
-                }
+    while (true)
+    {
+        std::vector<std::pair<CConsensusVote, CNode*> > vBatch;
+        {
+            boost::unique_lock<boost::mutex> lock(mutexPendingVotes);
+            while (vPendingVotes.empty())
+                condPendingVotes.wait(lock);
+            vBatch.swap(vPendingVotes);
+        }
 
-                // resolve conflicts
+        LogPrint("instantx", "ThreadInstantXVotes - verifying %u votes\n", vBatch.size());
+        ProcessConsensusVotes(vBatch);
 
-                //if this tx lock was rejected, we need to remove the conflicting blocks
-                if (mapTxLockReqRejected.count((*i).second.txHash))
-                {
-                    //reprocess the last 15 blocks
-                    CBlockIndex* pindex;
-                    CBlock block;
-                    CTxDB txdb("r");
-                    block.DisconnectBlock(txdb, pindex);
-                    tx.DisconnectInputs(txdb);
-                }
-            }
-        }
-        return true;
+        for (unsigned int i = 0; i < vBatch.size(); i++)
+            vBatch[i].second->Release();
     }
-
-    return false;
 }
 
 bool CheckForConflictingLocks(CTransaction& tx)
@@ -422,6 +569,7 @@ bool CheckForConflictingLocks(CTransaction& tx)
         Blocks could have been rejected during this time, which is OK. After they cancel out, the client will
         rescan the blocks and find they're acceptable and then take the chain with the most work.
     */
+    AssertLockHeld(cs_instantx);
     for (const CTxIn& in : tx.vin)
     {
         if (mapLockedInputs.count(in.prevout))
@@ -459,6 +607,7 @@ void CleanTransactionLocksList()
 {
     if (pindexBest == NULL) return;
 
+    LOCK(cs_instantx);
     std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
 
     while (it != mapTxLocks.end())
@@ -477,14 +626,23 @@ void CleanTransactionLocksList()
                 mapTxLockReq.erase(it->second.txHash);
                 mapTxLockReqRejected.erase(it->second.txHash);
 
-                for (CConsensusVote& v : it->second.vecConsensusVotes)
-                    mapTxLockVote.erase(v.GetHash());
+                for (const PAIRTYPE(const COutPoint, CConsensusVote)& v : it->second.mapConsensusVotes)
+                    mapTxLockVote.erase(v.second.GetHash());
             }
 
             mapTxLocks.erase(it++);
         } else
             it++;
     }
+
+    std::map<int, CInstantXQuorum>::iterator itQuorum = mapQuorums.begin();
+    while (itQuorum != mapQuorums.end())
+    {
+        if (GetTime() - itQuorum->second.nTime >= INSTANTX_QUORUM_CACHE_SECONDS)
+            mapQuorums.erase(itQuorum++);
+        else
+            itQuorum++;
+    }
 }
 
 uint256 CConsensusVote::GetHash() const
@@ -548,19 +706,12 @@ bool CConsensusVote::Sign()
 
 bool CTransactionLock::SignaturesValid()
 {
-    for (CConsensusVote vote : vecConsensusVotes)
+    for (PAIRTYPE(const COutPoint, CConsensusVote)& item : mapConsensusVotes)
     {
-        int n = mnodeman.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight, MIN_INSTANTX_PROTO_VERSION);
-
-        if (n == -1)
-        {
-            LogPrintf("CTransactionLock::SignaturesValid() - Unknown Masternode\n");
-            return false;
-        }
-
-        if (n > INSTANTX_SIGNATURES_TOTAL)
+        CConsensusVote& vote = item.second;
+        if (GetQuorumRank(vote.vinMasternode, vote.nBlockHeight) == -1)
         {
-            LogPrintf("CTransactionLock::SignaturesValid() - Masternode not in the top %s\n", INSTANTX_SIGNATURES_TOTAL);
+            LogPrintf("CTransactionLock::SignaturesValid() - Masternode not in the top %d\n", INSTANTX_SIGNATURES_TOTAL);
             return false;
         }
 
@@ -574,12 +725,12 @@ bool CTransactionLock::SignaturesValid()
     return true;
 }
 
-void CTransactionLock::AddSignature(CConsensusVote& cv)
+bool CTransactionLock::AddSignature(const CConsensusVote& cv)
 {
-    vecConsensusVotes.push_back(cv);
+    return mapConsensusVotes.insert(make_pair(cv.vinMasternode.prevout, cv)).second;
 }
 
-int CTransactionLock::CountSignatures()
+int CTransactionLock::CountSignatures() const
 {
     /*
         Only count signatures where the BlockHeight matches the transaction's blockheight.
@@ -589,8 +740,8 @@ int CTransactionLock::CountSignatures()
     if (nBlockHeight == 0) return -1;
 
     int n = 0;
-    for (CConsensusVote v : vecConsensusVotes)
-        if (v.nBlockHeight == nBlockHeight)
+    for (const PAIRTYPE(const COutPoint, CConsensusVote)& item : mapConsensusVotes)
+        if (item.second.nBlockHeight == nBlockHeight)
             n++;
     return n;
 }
@@ -35,6 +35,9 @@ class CConsensusVote;
 class CTransaction;
 class CTransactionLock;
 
+// protects the InstantX state below
+extern CCriticalSection cs_instantx;
+
 extern map<uint256, CTransaction> mapTxLockReq;
 extern map<uint256, CTransaction> mapTxLockReqRejected;
 extern map<uint256, CConsensusVote> mapTxLockVote;
@@ -54,8 +57,11 @@ void ProcessMessageInstantX(CNode* pfrom, std::string& strCommand, CDataStream&
 //check if we need to vote on this transaction
 void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight);
 
-//process consensus vote message
-bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx);
+// hand a received vote to the verification thread; false if it was dropped
+bool QueueConsensusVote(CNode* pnode, const CConsensusVote& ctx);
+
+// verify queued consensus votes in batches and apply them to their locks
+void ThreadInstantXVotes();
 
 // keep transaction locks in memory for an hour
 void CleanTransactionLocksList();
@@ -93,13 +99,15 @@ class CTransactionLock
 public:
     int nBlockHeight;
     uint256 txHash;
-    std::vector<CConsensusVote> vecConsensusVotes;
+    // one vote per masternode, by masternode outpoint
+    std::map<COutPoint, CConsensusVote> mapConsensusVotes;
     int nExpiration;
     int nTimeout;
 
     bool SignaturesValid();
-    int CountSignatures();
-    void AddSignature(CConsensusVote& cv);
+    int CountSignatures() const;
+    // false if this masternode already voted on the lock
+    bool AddSignature(const CConsensusVote& cv);
 
     uint256 GetHash()
     {
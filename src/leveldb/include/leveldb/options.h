@@ -135,6 +135,30 @@ struct Options {
   // Default: NULL
   const FilterPolicy* filter_policy;
 
+  // Leveldb will write up to this amount of bytes to a file before
+  // switching to a new one.  Larger files mean fewer open files and
+  // fewer, longer compactions.  The compaction byte limits below
+  // level-0 scale with this value.
+  //
+  // Default: 2MB
+  size_t max_file_size;
+
+  // Number of level-0 files that triggers a compaction of level-0.
+  //
+  // Default: 4
+  int l0_compaction_trigger;
+
+  // Number of level-0 files at which writes are delayed by 1ms each.
+  //
+  // Default: 8
+  int l0_slowdown_writes_trigger;
+
+  // Number of level-0 files at which writes stop until compaction
+  // catches up.
+  //
+  // Default: 12
+  int l0_stop_writes_trigger;
+
   // Create an Options object with default values for all fields.
   Options();
 };
@@ -41,6 +41,8 @@
 #include <stdint.h>
 #ifdef SNAPPY
 #include <snappy.h>
+#else
+#include "util/snappy.h"
 #endif
 
 namespace leveldb {
@@ -135,33 +137,22 @@ class AtomicPointer {
 
 inline bool Snappy_Compress(const char* input, size_t length,
                             ::std::string* output) {
-#ifdef SNAPPY
+  // Without SNAPPY this is the format-compatible codec in util/snappy.h
   output->resize(snappy::MaxCompressedLength(length));
   size_t outlen;
   snappy::RawCompress(input, length, &(*output)[0], &outlen);
   output->resize(outlen);
   return true;
-#endif
-
-  return false;
 }
 
 inline bool Snappy_GetUncompressedLength(const char* input, size_t length,
                                          size_t* result) {
-#ifdef SNAPPY
   return snappy::GetUncompressedLength(input, length, result);
-#else
-  return false;
-#endif
 }
 
 inline bool Snappy_Uncompress(const char* input, size_t length,
                               char* output) {
-#ifdef SNAPPY
   return snappy::RawUncompress(input, length, output);
-#else
-  return false;
-#endif
 }
 
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
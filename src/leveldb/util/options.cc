@@ -22,7 +22,11 @@ Options::Options()
       block_size(4096),
       block_restart_interval(16),
       compression(kSnappyCompression),
-      filter_policy(NULL) {
+      filter_policy(NULL),
+      max_file_size(2<<20),
+      l0_compaction_trigger(4),
+      l0_slowdown_writes_trigger(8),
+      l0_stop_writes_trigger(12) {
 }
 
 
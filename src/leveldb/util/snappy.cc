@@ -0,0 +1,310 @@
+// Copyright (c) 2018 The Monkey developers
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// The format: the uncompressed length as a varint32, followed by elements
+// whose tag byte says in its low two bits whether a literal or a copy of
+// earlier output follows.
+
+#include "util/snappy.h"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace leveldb {
+namespace snappy {
+
+namespace {
+
+enum {
+  LITERAL = 0,
+  COPY_1_BYTE_OFFSET = 1,  // 3 bit length, 3 bits of offset in tag
+  COPY_2_BYTE_OFFSET = 2,
+  COPY_4_BYTE_OFFSET = 3
+};
+
+// Input is compressed in independent fragments of this size, so that
+// offsets into the hash table fit in 16 bits
+const size_t kBlockSize = 1 << 16;
+const int kMaxHashTableBits = 14;
+const size_t kMaxHashTableSize = 1 << kMaxHashTableBits;
+// Matching stops this close to the end of a fragment so loads stay in bounds
+const size_t kInputMarginBytes = 15;
+
+inline uint32_t Load32(const char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t HashBytes(uint32_t bytes, int shift) {
+  return (bytes * 0x1e35a7bd) >> shift;
+}
+
+inline uint32_t Hash(const char* p, int shift) {
+  return HashBytes(Load32(p), shift);
+}
+
+// Number of leading bytes s1 and s2 share, not looking at s2_limit and after
+inline size_t FindMatchLength(const char* s1, const char* s2,
+                              const char* s2_limit) {
+  size_t matched = 0;
+  while (s2 + matched + 4 <= s2_limit &&
+         Load32(s1 + matched) == Load32(s2 + matched)) {
+    matched += 4;
+  }
+  while (s2 + matched < s2_limit && s1[matched] == s2[matched]) {
+    matched++;
+  }
+  return matched;
+}
+
+char* EmitLiteral(char* op, const char* literal, size_t len) {
+  size_t n = len - 1;
+  if (n < 60) {
+    *op++ = LITERAL | (n << 2);
+  } else {
+    // The length follows the tag in 1-4 little endian bytes
+    char* base = op++;
+    int count = 0;
+    while (n > 0) {
+      *op++ = n & 0xff;
+      n >>= 8;
+      count++;
+    }
+    *base = LITERAL | ((59 + count) << 2);
+  }
+  memcpy(op, literal, len);
+  return op + len;
+}
+
+char* EmitCopyAtMost64(char* op, size_t offset, size_t len) {
+  if (len < 12 && offset < 2048) {
+    *op++ = COPY_1_BYTE_OFFSET + ((len - 4) << 2) + ((offset >> 8) << 5);
+    *op++ = offset & 0xff;
+  } else {
+    *op++ = COPY_2_BYTE_OFFSET + ((len - 1) << 2);
+    *op++ = offset & 0xff;
+    *op++ = (offset >> 8) & 0xff;
+  }
+  return op;
+}
+
+char* EmitCopy(char* op, size_t offset, size_t len) {
+  // Split long copies so that every piece is at least 4 bytes, which the
+  // 1-byte-offset form needs
+  while (len >= 68) {
+    op = EmitCopyAtMost64(op, offset, 64);
+    len -= 64;
+  }
+  if (len > 64) {
+    op = EmitCopyAtMost64(op, offset, 60);
+    len -= 60;
+  }
+  return EmitCopyAtMost64(op, offset, len);
+}
+
+char* CompressFragment(const char* input, size_t input_size, char* op,
+                       uint16_t* table, size_t table_size) {
+  int shift = 32;
+  for (size_t n = table_size; n > 1; n >>= 1) {
+    shift--;
+  }
+  memset(table, 0, table_size * sizeof(*table));
+
+  const char* ip = input;
+  const char* ip_end = input + input_size;
+  const char* base_ip = input;
+  const char* next_emit = input;
+
+  if (input_size >= kInputMarginBytes) {
+    const char* ip_limit = input + input_size - kInputMarginBytes;
+    uint32_t next_hash = Hash(++ip, shift);
+    while (true) {
+      // Look for a 4-byte match, stepping further the longer nothing is
+      // found so that incompressible data is skipped quickly
+      uint32_t skip = 32;
+      const char* next_ip = ip;
+      const char* candidate;
+      do {
+        ip = next_ip;
+        uint32_t hash = next_hash;
+        next_ip = ip + (skip++ >> 5);
+        if (next_ip > ip_limit) {
+          goto emit_remainder;
+        }
+        next_hash = Hash(next_ip, shift);
+        candidate = base_ip + table[hash];
+        table[hash] = ip - base_ip;
+      } while (Load32(ip) != Load32(candidate));
+
+      op = EmitLiteral(op, next_emit, ip - next_emit);
+
+      // Emit copies for as long as the bytes after a match match again
+      do {
+        const char* base = ip;
+        size_t matched = 4 + FindMatchLength(candidate + 4, ip + 4, ip_end);
+        ip += matched;
+        op = EmitCopy(op, base - candidate, matched);
+        next_emit = ip;
+        if (ip >= ip_limit) {
+          goto emit_remainder;
+        }
+        table[Hash(ip - 1, shift)] = ip - base_ip - 1;
+        uint32_t cur_hash = Hash(ip, shift);
+        candidate = base_ip + table[cur_hash];
+        table[cur_hash] = ip - base_ip;
+      } while (Load32(ip) == Load32(candidate));
+
+      next_hash = Hash(++ip, shift);
+    }
+  }
+
+emit_remainder:
+  if (next_emit < ip_end) {
+    op = EmitLiteral(op, next_emit, ip_end - next_emit);
+  }
+  return op;
+}
+
+bool ReadVarint32(const uint8_t** p, const uint8_t* limit, uint32_t* value) {
+  uint32_t result = 0;
+  for (uint32_t shift = 0; shift <= 28 && *p < limit; shift += 7) {
+    uint32_t byte = *(*p)++;
+    result |= (byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+size_t MaxCompressedLength(size_t source_bytes) {
+  return 32 + source_bytes + source_bytes / 6;
+}
+
+void RawCompress(const char* input, size_t input_length,
+                 char* compressed, size_t* compressed_length) {
+  char* op = compressed;
+  uint32_t n = input_length;
+  while (n >= 0x80) {
+    *op++ = (n & 0x7f) | 0x80;
+    n >>= 7;
+  }
+  *op++ = n;
+
+  uint16_t table[kMaxHashTableSize];
+  while (input_length > 0) {
+    size_t fragment_size = input_length < kBlockSize ? input_length : kBlockSize;
+    size_t table_size = 256;
+    while (table_size < kMaxHashTableSize && table_size < fragment_size) {
+      table_size <<= 1;
+    }
+    op = CompressFragment(input, fragment_size, op, table, table_size);
+    input += fragment_size;
+    input_length -= fragment_size;
+  }
+  *compressed_length = op - compressed;
+}
+
+bool GetUncompressedLength(const char* compressed, size_t compressed_length,
+                           size_t* result) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(compressed);
+  uint32_t length;
+  if (!ReadVarint32(&p, p + compressed_length, &length)) {
+    return false;
+  }
+  *result = length;
+  return true;
+}
+
+bool RawUncompress(const char* compressed, size_t compressed_length,
+                   char* uncompressed) {
+  const uint8_t* ip = reinterpret_cast<const uint8_t*>(compressed);
+  const uint8_t* ip_end = ip + compressed_length;
+  uint32_t length;
+  if (!ReadVarint32(&ip, ip_end, &length)) {
+    return false;
+  }
+  char* op = uncompressed;
+  char* op_end = uncompressed + length;
+
+  while (ip < ip_end) {
+    uint8_t tag = *ip++;
+    size_t len;
+    size_t offset;
+    switch (tag & 3) {
+      case LITERAL: {
+        len = tag >> 2;
+        if (len >= 60) {
+          size_t bytes = len - 59;
+          if (static_cast<size_t>(ip_end - ip) < bytes) {
+            return false;
+          }
+          len = 0;
+          for (size_t i = 0; i < bytes; i++) {
+            len |= static_cast<size_t>(ip[i]) << (8 * i);
+          }
+          ip += bytes;
+        }
+        len++;
+        if (static_cast<size_t>(ip_end - ip) < len ||
+            static_cast<size_t>(op_end - op) < len) {
+          return false;
+        }
+        memcpy(op, ip, len);
+        ip += len;
+        op += len;
+        continue;
+      }
+      case COPY_1_BYTE_OFFSET:
+        if (ip_end - ip < 1) {
+          return false;
+        }
+        len = 4 + ((tag >> 2) & 7);
+        offset = (static_cast<size_t>(tag >> 5) << 8) | ip[0];
+        ip += 1;
+        break;
+      case COPY_2_BYTE_OFFSET:
+        if (ip_end - ip < 2) {
+          return false;
+        }
+        len = 1 + (tag >> 2);
+        offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        break;
+      default:
+        if (ip_end - ip < 4) {
+          return false;
+        }
+        len = 1 + (tag >> 2);
+        offset = ip[0] | (static_cast<size_t>(ip[1]) << 8) |
+                 (static_cast<size_t>(ip[2]) << 16) |
+                 (static_cast<size_t>(ip[3]) << 24);
+        ip += 4;
+        break;
+    }
+
+    if (offset == 0 || offset > static_cast<size_t>(op - uncompressed) ||
+        len > static_cast<size_t>(op_end - op)) {
+      return false;
+    }
+    const char* src = op - offset;
+    if (offset >= len) {
+      memcpy(op, src, len);
+    } else {
+      // Overlapping copy repeats the last offset bytes
+      for (size_t i = 0; i < len; i++) {
+        op[i] = src[i];
+      }
+    }
+    op += len;
+  }
+  return op == op_end;
+}
+
+}  // namespace snappy
+}  // namespace leveldb
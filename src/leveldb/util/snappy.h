@@ -0,0 +1,37 @@
+// Copyright (c) 2018 The Monkey developers
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A compressor for the Snappy block format, built into the library so that
+// table blocks are compressed without depending on libsnappy. Blocks it
+// writes can be read by libsnappy and the other way round; it follows the
+// same hash-and-skip matching, trading a little ratio for speed.
+
+#ifndef STORAGE_LEVELDB_UTIL_SNAPPY_H_
+#define STORAGE_LEVELDB_UTIL_SNAPPY_H_
+
+#include <stddef.h>
+
+namespace leveldb {
+namespace snappy {
+
+// Largest output RawCompress can produce for source_bytes of input
+size_t MaxCompressedLength(size_t source_bytes);
+
+// Compress input[0,input_length-1] into compressed, which must hold
+// MaxCompressedLength(input_length) bytes
+void RawCompress(const char* input, size_t input_length,
+                 char* compressed, size_t* compressed_length);
+
+bool GetUncompressedLength(const char* compressed, size_t compressed_length,
+                           size_t* result);
+
+// Decompress into uncompressed, which must hold the length returned by
+// GetUncompressedLength. Returns false on corrupt input.
+bool RawUncompress(const char* compressed, size_t compressed_length,
+                   char* uncompressed);
+
+}  // namespace snappy
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_SNAPPY_H_
@@ -0,0 +1,112 @@
+// Copyright (c) 2018 The Monkey developers
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/snappy.h"
+
+#include <string>
+#include "util/random.h"
+#include "util/testharness.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+static std::string Compress(const std::string& input) {
+  std::string output(snappy::MaxCompressedLength(input.size()), '\0');
+  size_t outlen;
+  snappy::RawCompress(input.data(), input.size(), &output[0], &outlen);
+  output.resize(outlen);
+  return output;
+}
+
+static bool Uncompress(const std::string& compressed, std::string* output) {
+  size_t ulength;
+  if (!snappy::GetUncompressedLength(compressed.data(), compressed.size(),
+                                     &ulength)) {
+    return false;
+  }
+  output->assign(ulength, '\0');
+  return snappy::RawUncompress(compressed.data(), compressed.size(),
+                               ulength ? &(*output)[0] : NULL);
+}
+
+static std::string Bytes(const char* data, size_t n) {
+  return std::string(data, n);
+}
+
+class SnappyTest { };
+
+// Output of libsnappy's RawCompress for the same inputs
+TEST(SnappyTest, ReferenceCompress) {
+  ASSERT_EQ(Bytes("\x00", 1), Compress(""));
+  ASSERT_EQ(Bytes("\x05\x10hello", 7), Compress("hello"));
+  // A one byte literal, then a 31 byte copy at offset 1
+  ASSERT_EQ(Bytes("\x20\x00" "a" "\x7a\x01\x00", 6),
+            Compress(std::string(32, 'a')));
+}
+
+// Streams using every element type, as libsnappy may write them
+TEST(SnappyTest, ReferenceUncompress) {
+  std::string output;
+
+  // 1 byte offset copy
+  ASSERT_TRUE(Uncompress(Bytes("\x08\x0c" "abcd" "\x01\x04", 8), &output));
+  ASSERT_EQ("abcdabcd", output);
+
+  // 2 byte offset copy that overlaps its own output
+  ASSERT_TRUE(Uncompress(Bytes("\x0a\x04" "ab" "\x1e\x02\x00", 7), &output));
+  ASSERT_EQ("ababababab", output);
+
+  // 4 byte offset copy
+  ASSERT_TRUE(Uncompress(Bytes("\x06\x08" "xyz" "\x0b\x03\x00\x00\x00", 10),
+                         &output));
+  ASSERT_EQ("xyzxyz", output);
+
+  // Literal whose length follows the tag
+  std::string literal(100, 'q');
+  ASSERT_TRUE(Uncompress(Bytes("\x64\xf0\x63", 3) + literal, &output));
+  ASSERT_EQ(literal, output);
+}
+
+TEST(SnappyTest, Corrupt) {
+  std::string output;
+  // Copy before any output
+  ASSERT_TRUE(!Uncompress(Bytes("\x04\x01\x01", 3), &output));
+  // Offset of zero
+  ASSERT_TRUE(!Uncompress(Bytes("\x08\x0c" "abcd" "\x01\x00", 8), &output));
+  // Offset past the start of the output
+  ASSERT_TRUE(!Uncompress(Bytes("\x08\x0c" "abcd" "\x01\x05", 8), &output));
+  // Truncated literal
+  ASSERT_TRUE(!Uncompress(Bytes("\x05\x10hel", 5), &output));
+  // Declared length longer than the data
+  ASSERT_TRUE(!Uncompress(Bytes("\x06\x10hello", 7), &output));
+}
+
+TEST(SnappyTest, RoundTrip) {
+  Random rnd(301);
+  std::string input, output;
+  // Sizes around the 64KB fragments the compressor works in
+  const int sizes[] = { 1, 15, 16, 100, 4096, 65535, 65536, 65537, 300000 };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    test::RandomString(&rnd, sizes[i], &input);
+    ASSERT_TRUE(Uncompress(Compress(input), &output));
+    ASSERT_EQ(input, output);
+
+    test::CompressibleString(&rnd, 0.25, sizes[i], &input);
+    std::string compressed = Compress(input);
+    ASSERT_LE(compressed.size(), snappy::MaxCompressedLength(input.size()));
+    ASSERT_TRUE(Uncompress(compressed, &output));
+    ASSERT_EQ(input, output);
+    // Matches are only found within a fragment, so the repeated quarter
+    // has to fit in one
+    if (sizes[i] >= 100 && sizes[i] / 4 < 65536) {
+      ASSERT_LT(compressed.size(), input.size() / 2);
+    }
+  }
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
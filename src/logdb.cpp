@@ -0,0 +1,447 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logdb.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+static const unsigned char LOGDB_MAGIC[8] = { 'm', 'n', 'k', 'y', 'w', 'l', 'o', 'g' };
+static const uint32_t LOGDB_VERSION = 1;
+static const size_t LOGDB_HEADER_SIZE = sizeof(LOGDB_MAGIC) + 4;
+static const size_t LOGDB_FRAME_HEADER_SIZE = 8;
+/** Snapshots are split into frames of about this many bytes */
+static const size_t LOGDB_SNAPSHOT_FRAME_SIZE = 1 << 20;
+
+enum
+{
+    LOGDB_WRITE = 1,
+    LOGDB_ERASE = 2,
+};
+
+static uint32_t Checksum(const unsigned char* p, size_t nSize)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(p, nSize).Finalize(hash);
+    return ReadLE32(hash);
+}
+
+static uint64_t RecordSize(const CSerializeData& key, const CSerializeData& value)
+{
+    return 9 + key.size() + value.size();
+}
+
+static void AppendData(CSerializeData& payload, const CSerializeData& data)
+{
+    unsigned char size[4];
+    WriteLE32(size, data.size());
+    payload.insert(payload.end(), (const char*)size, (const char*)size + 4);
+    payload.insert(payload.end(), data.begin(), data.end());
+}
+
+static void AppendWrite(CSerializeData& payload, const CSerializeData& key, const CSerializeData& value)
+{
+    payload.push_back((char)LOGDB_WRITE);
+    AppendData(payload, key);
+    AppendData(payload, value);
+}
+
+static void AppendErase(CSerializeData& payload, const CSerializeData& key)
+{
+    payload.push_back((char)LOGDB_ERASE);
+    AppendData(payload, key);
+}
+
+static bool WriteFrame(FILE* file, const CSerializeData& payload)
+{
+    unsigned char header[LOGDB_FRAME_HEADER_SIZE];
+    const unsigned char* p = payload.empty() ? NULL : (const unsigned char*)&payload[0];
+    WriteLE32(header, payload.size());
+    WriteLE32(header + 4, Checksum(p, payload.size()));
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+           fwrite(p, 1, payload.size(), file) == payload.size();
+}
+
+static bool ReadData(const unsigned char*& p, const unsigned char* pend, CSerializeData& data)
+{
+    if (pend - p < 4)
+        return false;
+    uint32_t nSize = ReadLE32(p);
+    p += 4;
+    if ((size_t)(pend - p) < nSize)
+        return false;
+    data.assign((const char*)p, (const char*)p + nSize);
+    p += nSize;
+    return true;
+}
+
+static bool IsSkipped(const CSerializeData& key, const char* pszSkip)
+{
+    return pszSkip && !key.empty() && memcmp(&key[0], pszSkip, std::min(key.size(), strlen(pszSkip))) == 0;
+}
+
+// Whether a whole, intact frame starts anywhere in [p, pend)
+static bool HasFrameAfter(const unsigned char* p, const unsigned char* pend)
+{
+    for (; pend - p >= (ptrdiff_t)LOGDB_FRAME_HEADER_SIZE; p++)
+    {
+        uint32_t nPayload = ReadLE32(p);
+        if (nPayload > 0 && (size_t)(pend - p - LOGDB_FRAME_HEADER_SIZE) >= nPayload &&
+            Checksum(p + LOGDB_FRAME_HEADER_SIZE, nPayload) == ReadLE32(p + 4))
+            return true;
+    }
+    return false;
+}
+
+// Append the bytes [nBegin, nEnd) of a file to <file>.bad
+static bool SaveDiscarded(const boost::filesystem::path& path, size_t nBegin, size_t nEnd)
+{
+    std::vector<char> vData(nEnd - nBegin);
+    FILE* fileIn = fopen(path.string().c_str(), "rb");
+    if (!fileIn)
+        return false;
+    bool fOk = fseek(fileIn, nBegin, SEEK_SET) == 0 && fread(&vData[0], 1, vData.size(), fileIn) == vData.size();
+    fclose(fileIn);
+    if (!fOk)
+        return false;
+
+    FILE* fileOut = fopen((path.string() + ".bad").c_str(), "ab");
+    if (!fileOut)
+        return false;
+    fOk = fwrite(&vData[0], 1, vData.size(), fileOut) == vData.size();
+    FileCommit(fileOut);
+    return fclose(fileOut) == 0 && fOk;
+}
+
+CLogDB::CLogDB(const boost::filesystem::path& pathIn) :
+    path(pathIn), file(NULL), nFileBytes(0), nLiveBytes(0), fDirty(false)
+{
+}
+
+CLogDB::~CLogDB()
+{
+    if (file)
+    {
+        FileCommit(file);
+        fclose(file);
+    }
+}
+
+bool CLogDB::Replay(const unsigned char* pbegin, size_t nSize, size_t& nGood)
+{
+    nGood = 0;
+    if (nSize < LOGDB_HEADER_SIZE || memcmp(pbegin, LOGDB_MAGIC, sizeof(LOGDB_MAGIC)) != 0)
+        return error("CLogDB::Replay() : %s is not a wallet log", path.string());
+    if (ReadLE32(pbegin + sizeof(LOGDB_MAGIC)) > LOGDB_VERSION)
+        return error("CLogDB::Replay() : %s has an unknown version", path.string());
+
+    const unsigned char* pend = pbegin + nSize;
+    const unsigned char* pframe = pbegin + LOGDB_HEADER_SIZE;
+    nGood = LOGDB_HEADER_SIZE;
+    CSerializeData key, value;
+    while (pend - pframe >= (ptrdiff_t)LOGDB_FRAME_HEADER_SIZE)
+    {
+        uint32_t nPayload = ReadLE32(pframe);
+        const unsigned char* p = pframe + LOGDB_FRAME_HEADER_SIZE;
+        const unsigned char* pnext = p + nPayload;
+        // A frame running past the end was cut short by a crash, but only if
+        // nothing follows it; otherwise its length field is damaged
+        if ((size_t)(pend - p) < nPayload)
+        {
+            if (HasFrameAfter(pframe + 1, pend))
+                return error("CLogDB::Replay() : bad frame length at offset %u of %s", pframe - pbegin, path.string());
+            return true;
+        }
+        if (Checksum(p, nPayload) != ReadLE32(pframe + 4))
+        {
+            // Only the last frame can be torn; anything earlier is damage
+            if (pnext == pend)
+                return true;
+            return error("CLogDB::Replay() : checksum mismatch at offset %u of %s", pframe - pbegin, path.string());
+        }
+
+        while (p < pnext)
+        {
+            unsigned char nType = *p++;
+            if (!ReadData(p, pnext, key))
+                return error("CLogDB::Replay() : bad record at offset %u of %s", pframe - pbegin, path.string());
+            if (nType == LOGDB_WRITE)
+            {
+                if (!ReadData(p, pnext, value))
+                    return error("CLogDB::Replay() : bad record at offset %u of %s", pframe - pbegin, path.string());
+                index[key].swap(value);
+            }
+            else if (nType == LOGDB_ERASE)
+                index.erase(key);
+            else
+                return error("CLogDB::Replay() : unknown record type %d at offset %u of %s", nType, pframe - pbegin, path.string());
+        }
+        pframe = pnext;
+        nGood = pframe - pbegin;
+    }
+    return true;
+}
+
+bool CLogDB::Load()
+{
+    LOCK(cs_log);
+    int64_t nStart = GetTimeMillis();
+    index.clear();
+    if (file)
+    {
+        fclose(file);
+        file = NULL;
+    }
+
+    if (!boost::filesystem::exists(path) && !WriteSnapshot(path, index))
+        return false;
+
+    size_t nSize = 0;
+    size_t nGood = 0;
+    bool fOk;
+    try {
+        nSize = boost::filesystem::file_size(path);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        return error("CLogDB::Load() : %s", e.what());
+    }
+#ifndef WIN32
+    // Map the file and parse it in place rather than reading it in pieces
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return error("CLogDB::Load() : cannot open %s", path.string());
+    void* pmap = nSize ? mmap(NULL, nSize, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (pmap == MAP_FAILED)
+        return error("CLogDB::Load() : cannot map %s", path.string());
+    if (pmap)
+        madvise(pmap, nSize, MADV_SEQUENTIAL);
+    fOk = Replay((const unsigned char*)pmap, nSize, nGood);
+    if (pmap)
+        munmap(pmap, nSize);
+#else
+    std::vector<unsigned char> vData(nSize);
+    FILE* fileIn = fopen(path.string().c_str(), "rb");
+    if (!fileIn)
+        return error("CLogDB::Load() : cannot open %s", path.string());
+    fOk = nSize == 0 || fread(&vData[0], 1, nSize, fileIn) == nSize;
+    fclose(fileIn);
+    if (!fOk)
+        return error("CLogDB::Load() : cannot read %s", path.string());
+    fOk = Replay(nSize ? &vData[0] : NULL, nSize, nGood);
+#endif
+    if (!fOk)
+        return false;
+
+    if (nGood < nSize)
+    {
+        LogPrintf("CLogDB::Load() : discarding %u bytes of a partly written batch at the end of %s, saved to %s.bad\n", nSize - nGood, path.string(), path.string());
+        if (!SaveDiscarded(path, nGood, nSize))
+            return error("CLogDB::Load() : cannot save the end of %s to %s.bad", path.string(), path.string());
+        try {
+            boost::filesystem::resize_file(path, nGood);
+        } catch (const boost::filesystem::filesystem_error& e) {
+            return error("CLogDB::Load() : %s", e.what());
+        }
+    }
+
+    nFileBytes = nGood;
+    nLiveBytes = LOGDB_HEADER_SIZE;
+    for (Index::const_iterator it = index.begin(); it != index.end(); ++it)
+        nLiveBytes += RecordSize(it->first, it->second);
+
+    LogPrint("db", "CLogDB::Load() : %u records, %u of %u bytes live in %s, %dms\n",
+        index.size(), nLiveBytes, nFileBytes, path.string(), GetTimeMillis() - nStart);
+    return Reopen();
+}
+
+bool CLogDB::Reopen()
+{
+    file = fopen(path.string().c_str(), "ab");
+    if (!file)
+        return error("CLogDB::Reopen() : cannot open %s for appending", path.string());
+    return true;
+}
+
+bool CLogDB::Read(const CSerializeData& key, CSerializeData& value) const
+{
+    LOCK(cs_log);
+    Index::const_iterator it = index.find(key);
+    if (it == index.end())
+        return false;
+    value = it->second;
+    return true;
+}
+
+bool CLogDB::Exists(const CSerializeData& key) const
+{
+    LOCK(cs_log);
+    return index.count(key) > 0;
+}
+
+void CLogDB::Apply(const CLogDBBatch& batch)
+{
+    for (std::map<CSerializeData, CSerializeData, CLogDBKeyCompare>::const_iterator it = batch.mapWrite.begin(); it != batch.mapWrite.end(); ++it)
+    {
+        Index::iterator mi = index.find(it->first);
+        if (mi != index.end())
+        {
+            nLiveBytes -= RecordSize(mi->first, mi->second);
+            mi->second = it->second;
+        }
+        else
+            index.insert(*it);
+        nLiveBytes += RecordSize(it->first, it->second);
+    }
+    BOOST_FOREACH(const CSerializeData& key, batch.setErase)
+    {
+        Index::iterator it = index.find(key);
+        if (it == index.end())
+            continue;
+        nLiveBytes -= RecordSize(it->first, it->second);
+        index.erase(it);
+    }
+}
+
+bool CLogDB::Write(const CLogDBBatch& batch)
+{
+    if (batch.IsEmpty())
+        return true;
+
+    CSerializeData payload;
+    for (std::map<CSerializeData, CSerializeData, CLogDBKeyCompare>::const_iterator it = batch.mapWrite.begin(); it != batch.mapWrite.end(); ++it)
+        AppendWrite(payload, it->first, it->second);
+    BOOST_FOREACH(const CSerializeData& key, batch.setErase)
+        AppendErase(payload, key);
+
+    LOCK(cs_log);
+    if (!file)
+        return false;
+    if (!WriteFrame(file, payload) || fflush(file) != 0)
+    {
+        // Cut off whatever part of the frame made it out, so later frames
+        // are not appended behind a damaged one
+        fclose(file);
+        file = NULL;
+        try {
+            boost::filesystem::resize_file(path, nFileBytes);
+        } catch (const boost::filesystem::filesystem_error& e) {
+            LogPrintf("CLogDB::Write() : %s\n", e.what());
+        }
+        Reopen();
+        return error("CLogDB::Write() : writing to %s failed", path.string());
+    }
+    nFileBytes += LOGDB_FRAME_HEADER_SIZE + payload.size();
+    fDirty = true;
+    Apply(batch);
+    return true;
+}
+
+bool CLogDB::Seek(const CSerializeData& key, bool fAfter, CSerializeData& keyRet, CSerializeData& valueRet) const
+{
+    LOCK(cs_log);
+    Index::const_iterator it = fAfter ? index.upper_bound(key) : index.lower_bound(key);
+    if (it == index.end())
+        return false;
+    keyRet = it->first;
+    valueRet = it->second;
+    return true;
+}
+
+bool CLogDB::Flush()
+{
+    LOCK(cs_log);
+    if (!file || !fDirty)
+        return true;
+    FileCommit(file);
+    fDirty = false;
+    return true;
+}
+
+bool CLogDB::NeedsCompaction() const
+{
+    LOCK(cs_log);
+    return nFileBytes > 2 * nLiveBytes && nFileBytes - nLiveBytes > LOGDB_MIN_COMPACT_BYTES;
+}
+
+bool CLogDB::Compact(const char* pszSkip)
+{
+    LOCK(cs_log);
+    int64_t nStart = GetTimeMillis();
+    boost::filesystem::path pathTmp = path.string() + ".compact";
+    if (!WriteSnapshot(pathTmp, index, pszSkip))
+        return false;
+
+    if (file)
+    {
+        fclose(file);
+        file = NULL;
+    }
+    if (!RenameOver(pathTmp, path))
+    {
+        Reopen();
+        return error("CLogDB::Compact() : cannot replace %s", path.string());
+    }
+
+    uint64_t nFileBytesOld = nFileBytes;
+    nLiveBytes = LOGDB_HEADER_SIZE;
+    for (Index::iterator it = index.begin(); it != index.end(); )
+    {
+        if (IsSkipped(it->first, pszSkip))
+            index.erase(it++);
+        else
+        {
+            nLiveBytes += RecordSize(it->first, it->second);
+            ++it;
+        }
+    }
+    nFileBytes = boost::filesystem::file_size(path);
+    fDirty = false;
+    LogPrint("db", "CLogDB::Compact() : %s from %u to %u bytes, %dms\n", path.string(), nFileBytesOld, nFileBytes, GetTimeMillis() - nStart);
+    return Reopen();
+}
+
+bool CLogDB::WriteSnapshot(const boost::filesystem::path& pathOut, const Index& indexIn, const char* pszSkip)
+{
+    FILE* fileOut = fopen(pathOut.string().c_str(), "wb");
+    if (!fileOut)
+        return error("CLogDB::WriteSnapshot() : cannot create %s", pathOut.string());
+
+    unsigned char header[LOGDB_HEADER_SIZE];
+    memcpy(header, LOGDB_MAGIC, sizeof(LOGDB_MAGIC));
+    WriteLE32(header + sizeof(LOGDB_MAGIC), LOGDB_VERSION);
+    bool fOk = fwrite(header, 1, sizeof(header), fileOut) == sizeof(header);
+
+    CSerializeData payload;
+    for (Index::const_iterator it = indexIn.begin(); fOk && it != indexIn.end(); ++it)
+    {
+        if (IsSkipped(it->first, pszSkip))
+            continue;
+        AppendWrite(payload, it->first, it->second);
+        if (payload.size() >= LOGDB_SNAPSHOT_FRAME_SIZE)
+        {
+            fOk = WriteFrame(fileOut, payload);
+            payload.clear();
+        }
+    }
+    if (fOk && !payload.empty())
+        fOk = WriteFrame(fileOut, payload);
+    if (fOk)
+        FileCommit(fileOut);
+    fclose(fileOut);
+    if (!fOk)
+        return error("CLogDB::WriteSnapshot() : writing %s failed", pathOut.string());
+    return true;
+}
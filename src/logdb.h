@@ -0,0 +1,123 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_LOGDB_H
+#define BITCOIN_LOGDB_H
+
+#include "serialize.h"
+#include "sync.h"
+
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+
+#include <boost/filesystem/path.hpp>
+
+/** Compaction is not worth it below this many bytes of superseded records */
+static const uint64_t LOGDB_MIN_COMPACT_BYTES = 1 << 20;
+
+/** Byte-wise key order, the same as the Berkeley DB btree default */
+struct CLogDBKeyCompare
+{
+    bool operator()(const CSerializeData& a, const CSerializeData& b) const
+    {
+        size_t nLen = std::min(a.size(), b.size());
+        if (nLen == 0)
+            return a.size() < b.size();
+        int r = memcmp(&a[0], &b[0], nLen);
+        return r < 0 || (r == 0 && a.size() < b.size());
+    }
+};
+
+/** Writes and erases that are applied to a CLogDB together */
+class CLogDBBatch
+{
+public:
+    std::map<CSerializeData, CSerializeData, CLogDBKeyCompare> mapWrite;
+    std::set<CSerializeData, CLogDBKeyCompare> setErase;
+
+    void Write(const CSerializeData& key, const CSerializeData& value)
+    {
+        setErase.erase(key);
+        mapWrite[key] = value;
+    }
+
+    void Erase(const CSerializeData& key)
+    {
+        mapWrite.erase(key);
+        setErase.insert(key);
+    }
+
+    bool IsEmpty() const { return mapWrite.empty() && setErase.empty(); }
+
+    void Clear()
+    {
+        mapWrite.clear();
+        setErase.clear();
+    }
+};
+
+/** Key/value store kept in memory and persisted as an append-only record log.
+ *
+ *  The file starts with a magic and version, followed by frames. A frame
+ *  holds the records of one batch behind its length and a checksum, so a
+ *  batch is applied completely or not at all. Loading replays all frames
+ *  into a sorted index and cuts off a final frame that was only partly
+ *  written. Superseded records stay in the file until Compact rewrites it
+ *  with only the live ones.
+ *
+ *  Appends reach the operating system when a batch is written; Flush makes
+ *  them durable, so one fsync covers every batch since the last one.
+ */
+class CLogDB
+{
+public:
+    typedef std::map<CSerializeData, CSerializeData, CLogDBKeyCompare> Index;
+
+private:
+    mutable CCriticalSection cs_log;
+    boost::filesystem::path path;
+    FILE* file;
+    Index index;
+    // Bytes in the file, and bytes the live records would take on their own
+    uint64_t nFileBytes;
+    uint64_t nLiveBytes;
+    bool fDirty;
+
+    CLogDB(const CLogDB&);
+    void operator=(const CLogDB&);
+
+    bool Replay(const unsigned char* pbegin, size_t nSize, size_t& nGood);
+    void Apply(const CLogDBBatch& batch);
+    bool Reopen();
+
+public:
+    explicit CLogDB(const boost::filesystem::path& pathIn);
+    ~CLogDB();
+
+    /** Read the whole file into the index, creating an empty log if there is none */
+    bool Load();
+
+    bool Read(const CSerializeData& key, CSerializeData& value) const;
+    bool Exists(const CSerializeData& key) const;
+    bool Write(const CLogDBBatch& batch);
+
+    /** First record at or after key, or strictly after it if fAfter */
+    bool Seek(const CSerializeData& key, bool fAfter, CSerializeData& keyRet, CSerializeData& valueRet) const;
+
+    /** Make all written batches durable */
+    bool Flush();
+
+    bool NeedsCompaction() const;
+    /** Rewrite the file with only the live records, dropping those whose
+     *  key starts with pszSkip. */
+    bool Compact(const char* pszSkip = NULL);
+
+    const boost::filesystem::path& GetPath() const { return path; }
+
+    /** Write index to a new log at pathOut, replacing any file there */
+    static bool WriteSnapshot(const boost::filesystem::path& pathOut, const Index& indexIn, const char* pszSkip = NULL);
+};
+
+#endif // BITCOIN_LOGDB_H
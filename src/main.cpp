@@ -9,10 +9,12 @@
 #include "alert.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "compactblock.h"
 #include "db.h"
 #include "init.h"
 #include "kernel.h"
 #include "net.h"
+#include "perfstats.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -22,6 +24,7 @@
 #include "masternode-payments.h"
 #include "spork.h"
 #include "util.h"
+#include "checkqueue.h"
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -58,6 +61,8 @@ bool fImporting = false;
 bool fReindex = false;
 bool fAddrIndex = false;
 bool fHaveGUI = false;
+int nScriptCheckThreads = 0;
+bool fCompactBlocks = true;
 
 struct COrphanBlock {
     uint256 hashBlock;
@@ -193,6 +198,8 @@ struct CNodeState {
     int nBlocksToDownload;
     int64_t nLastBlockReceive;
     int64_t nLastBlockProcess;
+    // Compact blocks from this peer waiting for a blocktxn answer.
+    map<uint256, CPartiallyDownloadedBlock> mapPartialBlocks;
 
     CNodeState() {
         nMisbehavior = 0;
@@ -256,6 +263,7 @@ void MarkBlockAsReceived(const uint256 &hash, NodeId nodeFrom = -1) {
         CNodeState *state = State(itInFlight->second.first);
         state->vBlocksInFlight.erase(itInFlight->second.second);
         state->nBlocksInFlight--;
+        state->mapPartialBlocks.erase(hash);
         if (itInFlight->second.first == nodeFrom)
             state->nLastBlockReceive = GetTimeMicros();
         mapBlocksInFlight.erase(itInFlight);
@@ -814,8 +822,61 @@ int64_t CTransaction::GetMinFee(unsigned int nBytes, bool fAllowFree, enum GetMi
 }
 
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
-                        bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
+void ThreadScriptCheck() {
+    RenameThread("monkey-scriptch");
+    scriptcheckqueue.Thread();
+}
+
+// Run a set of script checks on the check queue, or inline when no
+// script check threads are configured.
+static bool RunScriptChecks(std::vector<CScriptCheck>& vChecks)
+{
+    if (vChecks.empty())
+        return true;
+
+    if (!nScriptCheckThreads)
+    {
+        BOOST_FOREACH(const CScriptCheck& check, vChecks)
+            if (!check())
+                return false;
+        return true;
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
+// Re-run the script checks of one transaction serially, to find out which
+// input failed and to apply the same DoS scoring as ConnectInputs.
+static bool ExplainScriptChecks(CTransaction& tx, const std::vector<CScriptCheck>& vChecks)
+{
+    BOOST_FOREACH(const CScriptCheck& check, vChecks)
+    {
+        if (check())
+            continue;
+        unsigned int flags = check.GetFlags();
+        if (flags & STANDARD_NOT_MANDATORY_VERIFY_FLAGS) {
+            // Check whether the failure was caused by a non-mandatory script
+            // verification check only; if so, don't trigger DoS protection.
+            CScriptCheck checkMandatory(check);
+            checkMandatory.SetFlags(flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS);
+            if (checkMandatory())
+                return error("ConnectInputs() : %s non-mandatory VerifySignature failed", tx.GetHash().ToString());
+        }
+        return tx.DoS(100, error("ConnectInputs() : %s VerifySignature failed", tx.GetHash().ToString()));
+    }
+    return true;
+}
+
+// Contextual mempool admission checks for a single transaction. The
+// signature checks are appended to vChecks rather than run, so that the
+// caller can verify them in parallel and insert the transaction afterwards.
+static bool PrepareAcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
+                                      bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees,
+                                      std::vector<CScriptCheck>& vChecks)
 {
     AssertLockHeld(cs_main);
     if (pfMissingInputs)
@@ -853,10 +914,13 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
 
     // ----------- instantX transaction scanning -----------
 
-    for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return tx.DoS(0, error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason));
+    {
+        LOCK(cs_instantx);
+        for (const CTxIn& in : tx.vin) {
+            if (mapLockedInputs.count(in.prevout)) {
+                if (mapLockedInputs[in.prevout] != tx.GetHash()) {
+                    return tx.DoS(0, error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason));
+                }
             }
         }
     }
@@ -964,12 +1028,31 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        if (!tx.ConnectInputs(txdb, mapInputs, mapUnused, CDiskTxPos(1,1,1), pindexBest, false, false, STANDARD_SCRIPT_VERIFY_FLAGS))
+        if (!tx.ConnectInputs(txdb, mapInputs, mapUnused, CDiskTxPos(1,1,1), pindexBest, false, false, STANDARD_SCRIPT_VERIFY_FLAGS, true, &vChecks))
         {
             return error("AcceptToMemoryPool : ConnectInputs failed %s", hash.ToString());
         }
     }
 
+    return true;
+}
+
+// Final, serialized step of mempool admission: re-check for conflicts with
+// transactions that entered the pool since the contextual checks, then store.
+static bool FinishAcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx)
+{
+    AssertLockHeld(cs_main);
+    uint256 hash = tx.GetHash();
+
+    {
+        LOCK(pool.cs);
+        if (pool.mapTx.count(hash))
+            return false;
+        for (unsigned int i = 0; i < tx.vin.size(); i++)
+            if (pool.mapNextTx.count(tx.vin[i].prevout))
+                return false;
+    }
+
     // Store transaction in memory
     pool.addUnchecked(hash, tx);
     setValidatedTx.insert(hash);
@@ -983,6 +1066,67 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
     return true;
 }
 
+bool AcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
+                        bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+{
+    PERF_TIMER(PERF_ACCEPTTOMEMPOOL);
+    std::vector<CScriptCheck> vChecks;
+    if (!PrepareAcceptToMemoryPool(pool, tx, fLimitFree, pfMissingInputs, fRejectInsaneFee, ignoreFees, vChecks))
+        return false;
+
+    // Keep a copy to attribute a failure, the queue consumes the checks
+    std::vector<CScriptCheck> vChecksCopy(vChecks);
+    if (!RunScriptChecks(vChecks))
+    {
+        ExplainScriptChecks(tx, vChecksCopy);
+        return error("AcceptToMemoryPool : ConnectInputs failed %s", tx.GetHash().ToString());
+    }
+
+    return FinishAcceptToMemoryPool(pool, tx);
+}
+
+unsigned int AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransaction*>& vpTx, bool fLimitFree,
+                                     std::vector<bool>& vAccepted, std::vector<bool>& vMissingInputs)
+{
+    AssertLockHeld(cs_main);
+    vAccepted.assign(vpTx.size(), false);
+    vMissingInputs.assign(vpTx.size(), false);
+
+    // Contextual checks, collecting the signature checks of all candidates
+    std::vector<bool> vPrepared(vpTx.size(), false);
+    std::vector<std::vector<CScriptCheck> > vTxChecks(vpTx.size());
+    std::vector<CScriptCheck> vChecks;
+    for (unsigned int i = 0; i < vpTx.size(); i++)
+    {
+        bool fMissingInputs = false;
+        vPrepared[i] = PrepareAcceptToMemoryPool(pool, *vpTx[i], fLimitFree, &fMissingInputs, false, false, vTxChecks[i]);
+        vMissingInputs[i] = fMissingInputs;
+        if (vPrepared[i])
+            vChecks.insert(vChecks.end(), vTxChecks[i].begin(), vTxChecks[i].end());
+    }
+
+    // Verify every signature of the batch at once. Only when that fails are
+    // the transactions verified one by one to find the offending ones.
+    if (!RunScriptChecks(vChecks))
+    {
+        for (unsigned int i = 0; i < vpTx.size(); i++)
+            if (vPrepared[i] && !ExplainScriptChecks(*vpTx[i], vTxChecks[i]))
+                vPrepared[i] = false;
+    }
+
+    unsigned int nAccepted = 0;
+    for (unsigned int i = 0; i < vpTx.size(); i++)
+    {
+        if (vPrepared[i] && FinishAcceptToMemoryPool(pool, *vpTx[i]))
+        {
+            vAccepted[i] = true;
+            nAccepted++;
+        }
+    }
+
+    return nAccepted;
+}
+
 bool AcceptableInputs(CTxMemPool& pool, const CTransaction &txo, bool fLimitFree,
                          bool* pfMissingInputs, bool fRejectInsaneFee, bool isDSTX)
 {
@@ -1024,10 +1168,13 @@ bool AcceptableInputs(CTxMemPool& pool, const CTransaction &txo, bool fLimitFree
 
     // ----------- instantX transaction scanning -----------
 
-    BOOST_FOREACH(const CTxIn& in, tx.vin){
-        if(mapLockedInputs.count(in.prevout)){
-            if(mapLockedInputs[in.prevout] != tx.GetHash()){
-                return tx.DoS(0, error("AcceptableInputs : conflicts with existing transaction lock: %s", reason));
+    {
+        LOCK(cs_instantx);
+        BOOST_FOREACH(const CTxIn& in, tx.vin){
+            if(mapLockedInputs.count(in.prevout)){
+                if(mapLockedInputs[in.prevout] != tx.GetHash()){
+                    return tx.DoS(0, error("AcceptableInputs : conflicts with existing transaction lock: %s", reason));
+                }
             }
         }
     }
@@ -1168,6 +1315,7 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if(!fEnableInstantX) return -1;
 
     //compile consessus vote
+    LOCK(cs_instantx);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()){
         return (*i).second.CountSignatures();
@@ -1181,6 +1329,7 @@ bool CMerkleTx::IsTransactionLockTimedOut() const
     if(!fEnableInstantX) return -1;
 
     //compile consessus vote
+    LOCK(cs_instantx);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()){
         return GetTime() > (*i).second.nTimeout;
@@ -1272,6 +1421,7 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
     if(nResult < 0) nResult = 0;
 
     if (nResult < 6){
+        LOCK(cs_instantx);
         std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
         if (i != mapTxLocks.end()){
             sigs = (*i).second.CountSignatures();
@@ -1288,6 +1438,7 @@ int GetIXConfirmations(uint256 nTXHash)
 {
     int sigs = 0;
 
+    LOCK(cs_instantx);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
     if (i != mapTxLocks.end()){
         sigs = (*i).second.CountSignatures();
@@ -1605,6 +1756,35 @@ const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfSta
     return pindex;
 }
 
+static std::shared_ptr<const CChainSnapshot> pChainSnapshot = std::make_shared<const CChainSnapshot>();
+
+std::shared_ptr<const CChainSnapshot> GetChainSnapshot()
+{
+    return std::atomic_load(&pChainSnapshot);
+}
+
+// Called whenever pindexBest changes
+static void PublishChainSnapshot()
+{
+    std::shared_ptr<const CChainSnapshot> previous = GetChainSnapshot();
+    std::shared_ptr<CChainSnapshot> snapshot = std::make_shared<CChainSnapshot>();
+    snapshot->pindexTip = pindexBest;
+    // Proof-of-work blocks can be far back, so extend the previous snapshot
+    // rather than walking the chain when the tip just moved forward by one
+    if (previous->pindexTip && pindexBest->pprev == previous->pindexTip) {
+        snapshot->pindexLastPoW = pindexBest->IsProofOfStake() ? previous->pindexLastPoW : pindexBest;
+        snapshot->pindexLastPoS = pindexBest->IsProofOfStake() ? pindexBest : previous->pindexLastPoS;
+    } else {
+        snapshot->pindexLastPoW = GetLastBlockIndex(pindexBest, false);
+        snapshot->pindexLastPoS = GetLastBlockIndex(pindexBest, true);
+    }
+    snapshot->nHeight = pindexBest->nHeight;
+    snapshot->hashTip = pindexBest->GetBlockHash();
+    snapshot->nTime = pindexBest->GetBlockTime();
+    snapshot->nMoneySupply = pindexBest->nMoneySupply;
+    std::atomic_store(&pChainSnapshot, std::shared_ptr<const CChainSnapshot>(snapshot));
+}
+
 unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfStake)
 {
     CBigNum bnTargetLimit = fProofOfStake ? Params().ProofOfStakeLimit() : Params().ProofOfWorkLimit();
@@ -1855,8 +2035,16 @@ int64_t CTransaction::GetValueIn(const MapPrevTx& inputs) const
 
 }
 
+bool CScriptCheck::operator()() const {
+    PERF_TIMER(PERF_SCRIPTCHECK);
+    const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
+    if (!VerifyScript(scriptSig, scriptPubKey, *ptxTo, nIn, flags, nHashType, txdata.get()))
+        return error("CScriptCheck() : %s VerifySignature failed", ptxTo->GetHash().ToString());
+    return true;
+}
+
 bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx,
-    const CBlockIndex* pindexBlock, bool fBlock, bool fMiner, unsigned int flags, bool fValidateSig)
+    const CBlockIndex* pindexBlock, bool fBlock, bool fMiner, unsigned int flags, bool fValidateSig, std::vector<CScriptCheck> *pvChecks)
 {
     // Take over previous transactions' spent pointers
     // fBlock is true when this is called from AcceptBlock when a new best-block is added to the blockchain
@@ -1896,6 +2084,7 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
         // The first loop above does all the inexpensive checks.
         // Only if ALL inputs pass do we perform expensive ECDSA signature checks.
         // Helps prevent CPU exhaustion attacks.
+        boost::shared_ptr<const PrecomputedTransactionData> txdata;
         for (unsigned int i = 0; i < vin.size(); i++)
         {
             COutPoint prevout = vin[i].prevout;
@@ -1916,8 +2105,12 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
                 // still computed and checked, and any change will be caught at the next checkpoint.
                 if (!(fBlock && !IsInitialBlockDownload()))
                 {
-                    // Verify signature
-                    if (!VerifySignature(txPrev, *this, i, flags, 0))
+                    // Verify signature, or leave it to the caller's script check queue
+                    if (!txdata)
+                        txdata.reset(new PrecomputedTransactionData(*this));
+                    if (pvChecks)
+                        pvChecks->push_back(CScriptCheck(txPrev, *this, i, flags, 0, txdata));
+                    else if (!VerifySignature(txPrev, *this, i, flags, 0, txdata.get()))
                     {
                         if (flags & STANDARD_NOT_MANDATORY_VERIFY_FLAGS) {
                             // Check whether the failure was caused by a
@@ -1926,7 +2119,7 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
                             // if so, don't trigger DoS protection to
                             // avoid splitting the network between upgraded and
                             // non-upgraded nodes.
-                            if (VerifySignature(txPrev, *this, i, flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, 0))
+                            if (VerifySignature(txPrev, *this, i, flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, 0, txdata.get()))
                                 return error("ConnectInputs() : %s non-mandatory VerifySignature failed", GetHash().ToString());
                         }
                         // Failures of other flags indicate a transaction that is
@@ -2109,6 +2302,7 @@ void CBlock::RebuildAddressIndex(CTxDB& txdb)
 
 bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
 {
+    PERF_TIMER(PERF_CONNECTBLOCK);
     // Check it again in case a previous version let a bad block in, but skip BlockSig checking
     if (!CheckBlock(!fJustCheck, !fJustCheck, false))
         return false;
@@ -2131,6 +2325,8 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
     int64_t nStakeReward = 0;
     unsigned int nSigOps = 0;
 
+    CCheckQueueControl<CScriptCheck> control(nScriptCheckThreads ? &scriptcheckqueue : NULL);
+
     BOOST_FOREACH(CTransaction& tx, vtx)
     {
         uint256 hashTx = tx.GetHash();
@@ -2168,7 +2364,12 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
         else
         {
             bool fInvalid;
-            if (!tx.FetchInputs(txdb, mapQueuedChanges, true, false, mapInputs, fInvalid))
+            bool fFetched;
+            {
+                PERF_TIMER(PERF_FETCHINPUTS);
+                fFetched = tx.FetchInputs(txdb, mapQueuedChanges, true, false, mapInputs, fInvalid);
+            }
+            if (!fFetched)
                 return false;
 
             // Add in sigops done by pay-to-script-hash inputs;
@@ -2187,8 +2388,10 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
             if (tx.IsCoinStake())
                 nStakeReward = nTxValueOut - nTxValueIn;
 
-            if (!tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, flags))
+            std::vector<CScriptCheck> vChecks;
+            if (!tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, flags, true, nScriptCheckThreads ? &vChecks : NULL))
                 return false;
+            control.Add(vChecks);
         }
 
         mapQueuedChanges[hashTx] = CTxIndex(posThisTx, tx.vout.size());
@@ -2217,6 +2420,9 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
             return DoS(100, error("ConnectBlock() : coinstake pays too much(actual=%d vs calculated=%d)", nStakeReward, nCalculatedStakeReward));
     }
 
+    if (!control.Wait())
+        return DoS(100, error("ConnectBlock() : script verification failed"));
+
     // monkey: track money supply and mint amount info
     pindex->nMint = nValueOut - nValueIn + nFees;
     pindex->nMoneySupply = (pindex->pprev? pindex->pprev->nMoneySupply : 0) + nValueOut - nValueIn;
@@ -2492,6 +2698,8 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
     nBestChainTrust = pindexNew->nChainTrust;
     nTimeBestReceived = GetTime();
     mempool.AddTransactionsUpdated(1);
+    PublishChainSnapshot();
+    uiInterface.NotifyBlockTip(nBestHeight, pindexBest->GetBlockTime());
 
     uint256 nBestBlockTrust = pindexBest->nHeight != 0 ? (pindexBest->nChainTrust - pindexBest->pprev->nChainTrust) : pindexBest->nChainTrust;
 
@@ -2653,6 +2861,7 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
 
 bool CBlock::CheckBlock(bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig) const
 {
+    PERF_TIMER(PERF_CHECKBLOCK);
     // These are checks that are independent of context
     // that can be verified before saving an orphan block.
 
@@ -2698,6 +2907,7 @@ bool CBlock::CheckBlock(bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig) c
 
     if (IsSporkActive(SPORK_3_INSTANTX_BLOCK_FILTERING))
     {
+        LOCK(cs_instantx);
         for (const CTransaction& tx : vtx)
         {
             if (!tx.IsCoinBase())
@@ -3248,6 +3458,7 @@ bool LoadBlockIndex(bool fAllowNew)
     pindexBest = mapBlockIndex[hashBestChain];
     nBestHeight = pindexBest->nHeight;
     nBestChainTrust = pindexBest->nChainTrust;
+    PublishChainSnapshot();
 
     LogPrintf("LoadBlockIndex(): hashBestChain=%s  height=%d  trust=%s  date=%s\n",
       hashBestChain.ToString(), nBestHeight, CBigNum(nBestChainTrust).ToString(),
@@ -3273,6 +3484,7 @@ void UnloadBlockIndex()
 {
     mapBlockIndex.clear();
     pindexBest = NULL;
+    std::atomic_store(&pChainSnapshot, std::make_shared<const CChainSnapshot>());
 }
 
 CVerifyDB::CVerifyDB()
@@ -3458,7 +3670,7 @@ void PrintBlockTree()
     }
 }
 
-bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
+bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp, CImportStats* pstats)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
@@ -3500,13 +3712,30 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
             blkdat >> nSize;
             if (nSize > 0 && nSize <= MAX_BLOCK_SIZE)
             {
+                // Read and deserialize separately so they are timed apart
+                CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+                {
+                    PERF_TIMER(PERF_BLOCKREAD);
+                    ssBlock.resize(nSize);
+                    blkdat.read(&ssBlock[0], nSize);
+                }
                 CBlock block;
-                blkdat >> block;
+                {
+                    PERF_TIMER(PERF_BLOCKDESERIALIZE);
+                    ssBlock >> block;
+                }
                 LOCK(cs_main);
                 if (ProcessNewBlock(NULL,&block))
                 {
                     nLoaded++;
                     nPos += 4 + nSize;
+                    if (pstats)
+                    {
+                        pstats->nBlocks++;
+                        pstats->nTransactions += block.vtx.size();
+                        BOOST_FOREACH(const CTransaction& tx, block.vtx)
+                            pstats->nSigOps += tx.GetLegacySigOpCount();
+                    }
                 }
             }
         }
@@ -3611,10 +3840,16 @@ bool static AlreadyHave(CTxDB& txdb, const CInv& inv)
         return mapBlockIndex.count(inv.hash) ||
                mapOrphanBlocks.count(inv.hash);
     case MSG_TXLOCK_REQUEST:
-        return mapTxLockReq.count(inv.hash) ||
-               mapTxLockReqRejected.count(inv.hash);
+        {
+            LOCK(cs_instantx);
+            return mapTxLockReq.count(inv.hash) ||
+                   mapTxLockReqRejected.count(inv.hash);
+        }
     case MSG_TXLOCK_VOTE:
-        return mapTxLockVote.count(inv.hash);
+        {
+            LOCK(cs_instantx);
+            return mapTxLockVote.count(inv.hash);
+        }
     case MSG_SPORK:
         return mapSporks.count(inv.hash);
     case MSG_MASTERNODE_WINNER:
@@ -3655,7 +3890,7 @@ void static ProcessGetData(CNode* pfrom)
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
             {
                 // Send block from disk
                 map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(inv.hash);
@@ -3663,7 +3898,10 @@ void static ProcessGetData(CNode* pfrom)
                 {
                     CBlock block;
                     block.ReadFromDisk((*mi).second);
-                    pfrom->PushMessage("block", block);
+                    if (inv.type == MSG_CMPCT_BLOCK && pfrom->nVersion >= COMPACT_BLOCKS_VERSION)
+                        pfrom->PushMessage("cmpctblock", CCompactBlock(block));
+                    else
+                        pfrom->PushMessage("block", block);
 
                     // Trigger them to send a getblocks request for the next batch of inventory
                     if (inv.hash == pfrom->hashContinue)
@@ -3706,6 +3944,7 @@ void static ProcessGetData(CNode* pfrom)
                 }
 
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
+                    LOCK(cs_instantx);
                     if(mapTxLockVote.count(inv.hash)){
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
@@ -3716,6 +3955,7 @@ void static ProcessGetData(CNode* pfrom)
                 }
 
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
+                    LOCK(cs_instantx);
                     if(mapTxLockReq.count(inv.hash)){
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
@@ -3807,6 +4047,18 @@ void static ProcessGetData(CNode* pfrom)
     }
 }
 
+// Requires cs_main. Hand a block rebuilt from a compact block to the same
+// path a "block" message takes.
+void static ProcessReconstructedBlock(CNode* pfrom, CBlock& block)
+{
+    uint256 hashBlock = block.GetHash();
+    mapBlockSource[hashBlock] = pfrom->GetId();
+    MarkBlockAsReceived(hashBlock, pfrom->GetId());
+
+    ProcessNewBlock(pfrom, &block);
+    if (block.nDoS) Misbehaving(pfrom->GetId(), block.nDoS);
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
 {
     RandAddSeedPerfmon();
@@ -4216,28 +4468,33 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                 tx.GetHash().ToString(),
                 mempool.mapTx.size());
 
-            // Recursively process any orphan transactions that depended on this one
+            // Recursively process any orphan transactions that depended on this one.
+            // The children of each accepted transaction are admitted as one batch.
             for (unsigned int i = 0; i < vWorkQueue.size(); i++)
             {
                 map<uint256, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
                 if (itByPrev == mapOrphanTransactionsByPrev.end())
                     continue;
-                for (set<uint256>::iterator mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end();
-                     ++mi)
-                {
-                    const uint256& orphanTxHash = *mi;
-                    CTransaction& orphanTx = mapOrphanTransactions[orphanTxHash];
-                    bool fMissingInputs2 = false;
 
-                    if (AcceptToMemoryPool(mempool, orphanTx, true, &fMissingInputs2))
+                vector<uint256> vOrphanHashes(itByPrev->second.begin(), itByPrev->second.end());
+                vector<CTransaction*> vpOrphanTx;
+                BOOST_FOREACH(const uint256& orphanTxHash, vOrphanHashes)
+                    vpOrphanTx.push_back(&mapOrphanTransactions[orphanTxHash]);
+
+                vector<bool> vAccepted, vMissingInputs;
+                AcceptToMemoryPoolBatch(mempool, vpOrphanTx, true, vAccepted, vMissingInputs);
+
+                for (unsigned int j = 0; j < vOrphanHashes.size(); j++)
+                {
+                    const uint256& orphanTxHash = vOrphanHashes[j];
+                    if (vAccepted[j])
                     {
                         LogPrint("mempool", "   accepted orphan tx %s\n", orphanTxHash.ToString());
-                        RelayTransaction(orphanTx, orphanTxHash);
+                        RelayTransaction(*vpOrphanTx[j], orphanTxHash);
                         vWorkQueue.push_back(orphanTxHash);
                         vEraseQueue.push_back(orphanTxHash);
                     }
-                    else if (!fMissingInputs2)
+                    else if (!vMissingInputs[j])
                     {
                         // Has inputs but not accepted to mempool
                         // Probably non-standard or insufficient fee/priority
@@ -4289,6 +4546,112 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         if (block.nDoS) Misbehaving(pfrom->GetId(), block.nDoS);
     }
 
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex)
+    {
+        CCompactBlock cmpctblock;
+        vRecv >> cmpctblock;
+        uint256 hashBlock = cmpctblock.header.GetHash();
+
+        LogPrint("net", "received compact block %s peer=%d\n", hashBlock.ToString(), pfrom->id);
+
+        CInv inv(MSG_BLOCK, hashBlock);
+        pfrom->AddInventoryKnown(inv);
+
+        LOCK(cs_main);
+        // Only reconstruct blocks we asked this peer for
+        map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hashBlock);
+        if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != pfrom->GetId())
+            return true;
+
+        CNodeState *state = State(pfrom->GetId());
+        CPartiallyDownloadedBlock& partialBlock = state->mapPartialBlocks[hashBlock];
+        ReadStatus status = partialBlock.InitData(cmpctblock, mempool);
+        if (status == READ_STATUS_INVALID)
+        {
+            state->mapPartialBlocks.erase(hashBlock);
+            Misbehaving(pfrom->GetId(), 100);
+            return error("cmpctblock : invalid compact block %s from peer=%d", hashBlock.ToString(), pfrom->id);
+        }
+
+        if (status == READ_STATUS_OK && partialBlock.GetMissingCount() > 0)
+        {
+            CBlockTransactionsRequest req;
+            req.blockhash = hashBlock;
+            partialBlock.GetMissing(req.vIndexes);
+            pfrom->PushMessage("getblocktxn", req);
+            return true;
+        }
+
+        CBlock block;
+        if (status == READ_STATUS_OK)
+            status = partialBlock.FillBlock(block, vector<CTransaction>());
+        state->mapPartialBlocks.erase(hashBlock);
+
+        if (status == READ_STATUS_OK)
+            ProcessReconstructedBlock(pfrom, block);
+        else
+            pfrom->PushMessage("getdata", vector<CInv>(1, inv));
+    }
+
+    else if (strCommand == "getblocktxn")
+    {
+        CBlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+        map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(req.blockhash);
+        if (mi == mapBlockIndex.end())
+        {
+            LogPrint("net", "getblocktxn for unknown block %s peer=%d\n", req.blockhash.ToString(), pfrom->id);
+            return true;
+        }
+
+        CBlock block;
+        if (!block.ReadFromDisk(mi->second))
+            return error("getblocktxn : ReadFromDisk failed for %s", req.blockhash.ToString());
+
+        CBlockTransactions resp(req);
+        for (unsigned int i = 0; i < req.vIndexes.size(); i++)
+        {
+            if (req.vIndexes[i] >= block.vtx.size())
+            {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("getblocktxn : index %u out of range for block %s, peer=%d", req.vIndexes[i], req.blockhash.ToString(), pfrom->id);
+            }
+            resp.vtx[i] = block.vtx[req.vIndexes[i]];
+        }
+        pfrom->PushMessage("blocktxn", resp);
+    }
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex)
+    {
+        CBlockTransactions resp;
+        vRecv >> resp;
+
+        LOCK(cs_main);
+        CNodeState *state = State(pfrom->GetId());
+        map<uint256, CPartiallyDownloadedBlock>::iterator it = state->mapPartialBlocks.find(resp.blockhash);
+        if (it == state->mapPartialBlocks.end())
+        {
+            LogPrint("net", "unrequested blocktxn for %s peer=%d\n", resp.blockhash.ToString(), pfrom->id);
+            return true;
+        }
+
+        CBlock block;
+        ReadStatus status = it->second.FillBlock(block, resp.vtx);
+        state->mapPartialBlocks.erase(it);
+        if (status == READ_STATUS_INVALID)
+        {
+            Misbehaving(pfrom->GetId(), 100);
+            return error("blocktxn : peer=%d sent invalid transactions for %s", pfrom->id, resp.blockhash.ToString());
+        }
+
+        if (status == READ_STATUS_OK)
+            ProcessReconstructedBlock(pfrom, block);
+        else
+            pfrom->PushMessage("getdata", vector<CInv>(1, CInv(MSG_BLOCK, resp.blockhash)));
+    }
+
     // This asymmetric behavior for inbound and outbound connections was introduced
     // to prevent a fingerprinting attack: an attacker can send specific fake addresses
     // to users' AddrMan and later request them by sending getaddr messages.
@@ -4572,6 +4935,7 @@ bool ProcessMessages(CNode* pfrom)
         bool fRet = false;
         try
         {
+            CPerfTimer timer(GetMessagePerfHistogram(strCommand));
             fRet = ProcessMessage(pfrom, strCommand, vRecv);
             boost::this_thread::interruption_point();
         }
@@ -4800,9 +5164,14 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         //
         vector<CInv> vGetData;
         CTxDB txdb("r");
+        // Once synced, new blocks are mostly made of transactions we already
+        // have, so ask peers that support it for compact blocks.
+        int nBlockInvType = MSG_BLOCK;
+        if (fCompactBlocks && pto->nVersion >= COMPACT_BLOCKS_VERSION && state.nBlocksToDownload && !IsInitialBlockDownload())
+            nBlockInvType = MSG_CMPCT_BLOCK;
         while (!pto->fDisconnect && state.nBlocksToDownload && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
             uint256 hash = state.vBlocksToDownload.front();
-            vGetData.push_back(CInv(MSG_BLOCK, hash));
+            vGetData.push_back(CInv(nBlockInvType, hash));
             MarkBlockAsInFlight(pto->GetId(), hash);
             LogPrint("net", "Requesting block %s from %s\n", hash.ToString().c_str(), state.name.c_str());
             if (vGetData.size() >= 1000)
@@ -16,6 +16,9 @@
 #include <masternode-sync.h>
 
 #include <list>
+#include <memory>
+
+#include <boost/shared_ptr.hpp>
 
 class CValidationState;
 class CBlock;
@@ -83,6 +86,10 @@ inline unsigned int GetTargetSpacing(int nHeight) {
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 128;
 /** Timeout in seconds before considering a block download peer unresponsive. */
 static const unsigned int BLOCK_DOWNLOAD_TIMEOUT = 60;
+/** Maximum number of script-checking threads allowed */
+static const int MAX_SCRIPTCHECK_THREADS = 16;
+/** -par default (number of script-checking threads, 0 = auto) */
+static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
 
 static const int64_t MIN_TX_FEE = 1000;
 static const int64_t MIN_RELAY_TX_FEE = MIN_TX_FEE;
@@ -145,6 +152,8 @@ extern bool fHaveGUI;
 
 // Settings
 extern bool fUseFastIndex;
+extern int nScriptCheckThreads;
+extern bool fCompactBlocks;
 extern unsigned int nDerivationMethodIndex;
 
 extern bool fLargeWorkForkFound;
@@ -154,6 +163,7 @@ extern bool fLargeWorkInvalidChainFound;
 static const uint64_t nMinDiskSpace = 52428800;
 
 class CReserveKey;
+class CScriptCheck;
 class CTxDB;
 class CTxIndex;
 class CWalletInterface;
@@ -216,12 +226,46 @@ bool GetTransaction(const uint256 &hash, CTransaction &tx, uint256 &hashBlock);
 uint256 WantedByOrphan(const COrphanBlock* pblockOrphan);
 const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfStake);
 void ThreadStakeMiner(CWallet *pwallet);
+/** Run an instance of the script checking thread */
+void ThreadScriptCheck();
+
+/** The best chain as of one SetBestChain, for readers that do not hold
+ *  cs_main. Snapshots are immutable and replaced as a whole. Block index
+ *  entries are never freed, but of the ones referenced here only fields
+ *  that do not change once connected (so not pnext) may be read unlocked.
+ */
+struct CChainSnapshot
+{
+    const CBlockIndex* pindexTip;
+    const CBlockIndex* pindexLastPoW;
+    const CBlockIndex* pindexLastPoS;
+    int nHeight;
+    uint256 hashTip;
+    int64_t nTime;
+    CAmount nMoneySupply;
+
+    CChainSnapshot() : pindexTip(NULL), pindexLastPoW(NULL), pindexLastPoS(NULL), nHeight(-1), hashTip(0), nTime(0), nMoneySupply(0) {}
+};
+
+/** Snapshot of the chain tip; takes no lock */
+std::shared_ptr<const CChainSnapshot> GetChainSnapshot();
 
 
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
                         bool* pfMissingInputs, bool fRejectInsaneFee=false, bool ignoreFees=false);
 
+/** (try to) add a batch of independent transactions to the memory pool.
+ *  Contextual checks run per transaction, the signature checks of the whole
+ *  batch are verified together on the script check queue, and only the final
+ *  conflict check and insertion are done one transaction at a time.
+ *  @param[out] vAccepted       per transaction: added to the pool
+ *  @param[out] vMissingInputs  per transaction: rejected because inputs are unknown
+ *  @return number of transactions accepted
+ */
+unsigned int AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransaction*>& vpTx, bool fLimitFree,
+                                     std::vector<bool>& vAccepted, std::vector<bool>& vMissingInputs);
+
 bool AcceptableInputs(CTxMemPool& pool, const CTransaction &txo, bool fLimitFree,
                         bool* pfMissingInputs, bool fRejectInsaneFee=false, bool isDSTX=false);
 
@@ -489,11 +533,13 @@ public:
         @param[in] pindexBlock
         @param[in] fBlock   true if called from ConnectBlock
         @param[in] fMiner   true if called from CreateNewBlock
+        @param[out] pvChecks    if not NULL, signature checks are appended here instead of being run
         @return Returns true if all checks succeed
      */
     bool ConnectInputs(CTxDB& txdb, MapPrevTx inputs,
                        std::map<uint256, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx,
-                       const CBlockIndex* pindexBlock, bool fBlock, bool fMiner, unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS, bool fValidateSig = true);
+                       const CBlockIndex* pindexBlock, bool fBlock, bool fMiner, unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS, bool fValidateSig = true,
+                       std::vector<CScriptCheck> *pvChecks = NULL);
     bool CheckTransaction() const;
     bool GetCoinAge(CTxDB& txdb, const CBlockIndex* pindexPrev, CAmount& nCoinAge) const;
 
@@ -523,6 +569,45 @@ public:
 };
 
 
+/** Closure representing one script verification.
+ *  Note that this stores a reference to the spending transaction, which has
+ *  to outlive the check. The precomputed signature hash data is shared by
+ *  the checks of all inputs of that transaction.
+ */
+class CScriptCheck
+{
+private:
+    CScript scriptPubKey;
+    const CTransaction *ptxTo;
+    unsigned int nIn;
+    unsigned int flags;
+    int nHashType;
+    boost::shared_ptr<const PrecomputedTransactionData> txdata;
+
+public:
+    CScriptCheck() : ptxTo(NULL), nIn(0), flags(0), nHashType(0) {}
+    CScriptCheck(const CTransaction& txFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int flagsIn, int nHashTypeIn,
+                 const boost::shared_ptr<const PrecomputedTransactionData>& txdataIn) :
+        scriptPubKey(txFromIn.vout[txToIn.vin[nInIn].prevout.n].scriptPubKey),
+        ptxTo(&txToIn), nIn(nInIn), flags(flagsIn), nHashType(nHashTypeIn), txdata(txdataIn) { }
+
+    bool operator()() const;
+
+    void swap(CScriptCheck &check) {
+        scriptPubKey.swap(check.scriptPubKey);
+        std::swap(ptxTo, check.ptxTo);
+        std::swap(nIn, check.nIn);
+        std::swap(flags, check.flags);
+        std::swap(nHashType, check.nHashType);
+        txdata.swap(check.txdata);
+    }
+
+    const CTransaction* GetTransaction() const { return ptxTo; }
+    unsigned int GetFlags() const { return flags; }
+    void SetFlags(unsigned int flagsIn) { flags = flagsIn; }
+};
+
+
 /** wrapper for CTxOut that provides a more compact serialization */
 class CTxOutCompressor
 {
@@ -1537,10 +1622,20 @@ protected:
     friend void ::UnregisterAllWallets();
 };
 
+/** Totals over the blocks an import accepted; sigops are the legacy count */
+struct CImportStats
+{
+    uint64_t nBlocks;
+    uint64_t nTransactions;
+    uint64_t nSigOps;
+
+    CImportStats() : nBlocks(0), nTransactions(0), nSigOps(0) {}
+};
+/** Import blocks from an external file, adding to pstats if given */
+bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp, CImportStats* pstats = NULL);
+
 #endif
 /** Open a block file (blk?????.dat) */
 FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly);
 /** Translation to a filesystem path */
-boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
-/** Import blocks from an external file */
-bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp);
\ No newline at end of file
+boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
\ No newline at end of file
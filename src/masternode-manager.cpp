@@ -8,6 +8,7 @@
 #include "addrman.h"
 #include "masternode.h"
 #include "darksend.h"
+#include "perfstats.h"
 #include "spork.h"
 #include "util.h"
 #include <boost/lexical_cast.hpp>
@@ -589,16 +590,17 @@ CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight,
     return winner;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+bool CMasternodeMan::GetMasternodeScores(std::vector<pair<int64_t, CTxIn> >& vecMasternodeScores, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
+    LOCK(cs);
+
     int64_t nMasternode_Min_Age = GetSporkValue(SPORK_11_MN_WINNER_MINIMUM_AGE);
     int64_t nMasternode_Age = 0;
 
     //make sure we know about this block
     uint256 hash = 0;
     if (!GetBlockHash(hash, nBlockHeight))
-        return -1;
+        return false;
 
     // scan for winner
     for (CMasternode& mn : vMasternodes) {
@@ -626,6 +628,15 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
     }
 
     sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
+    return true;
+}
+
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+{
+    PERF_TIMER(PERF_MNRANK);
+    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
+    if (!GetMasternodeScores(vecMasternodeScores, nBlockHeight, minProtocol, fOnlyActive))
+        return -1;
 
     int rank = 0;
     for (PAIRTYPE(int64_t, CTxIn) & s : vecMasternodeScores) {
@@ -637,8 +648,25 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
     return -1;
 }
 
+std::vector<CTxIn> CMasternodeMan::GetMasternodeQuorum(int64_t nBlockHeight, unsigned int nCount, int minProtocol, bool fOnlyActive)
+{
+    LOCK(cs);
+
+    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
+    std::vector<CTxIn> vecQuorum;
+    if (!GetMasternodeScores(vecMasternodeScores, nBlockHeight, minProtocol, fOnlyActive))
+        return vecQuorum;
+
+    for (unsigned int i = 0; i < vecMasternodeScores.size() && i < nCount; i++)
+        vecQuorum.push_back(vecMasternodeScores[i].second);
+    return vecQuorum;
+}
+
 std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
 {
+    LOCK(cs);
+
+    PERF_TIMER(PERF_MNRANK);
     std::vector<pair<int64_t, CMasternode> > vecMasternodeScores;
     std::vector<pair<int, CMasternode> > vecMasternodeRanks;
 
@@ -68,6 +68,9 @@ private:
     // which masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // score the masternodes for a block, best first; false if the block is unknown
+    bool GetMasternodeScores(std::vector<pair<int64_t, CTxIn> >& vecMasternodeScores, int64_t nBlockHeight, int minProtocol, bool fOnlyActive);
+
 public:
     // Keep track of all broadcasts I've seen
     map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
@@ -143,6 +146,8 @@ public:
 
     std::vector<pair<int, CMasternode> > GetMasternodeRanks(int64_t nBlockHeight, int minProtocol = 0);
     int GetMasternodeRank(const CTxIn &vin, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
+    /// The nCount best ranked masternodes for a block, in rank order; empty if the block is unknown
+    std::vector<CTxIn> GetMasternodeQuorum(int64_t nBlockHeight, unsigned int nCount, int minProtocol = 0, bool fOnlyActive = true);
     CMasternode* GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
 
     void ProcessMasternodeConnections();
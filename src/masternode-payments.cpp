@@ -5,6 +5,7 @@
 #include "masternode-payments.h"
 #include "masternode-manager.h"
 #include "darksend.h"
+#include "perfstats.h"
 #include "util.h"
 #include "sync.h"
 #include "spork.h"
@@ -196,6 +197,7 @@ bool IsBlockValueValid(const CBlock& block, CAmount nExpectedValue, CAmount nMin
 
 bool IsBlockPayeeValid(const CBlock& block, int nBlockHeight)
 {
+    PERF_TIMER(PERF_MNPAYMENTS);
     // there is no data to use to check anything -- find the longest chain
     if (!masternodeSync.IsSynced()) {
         LogPrint("mnpayments", "Client not synced, skipping block payee checks\n");
@@ -219,6 +221,7 @@ bool IsBlockPayeeValid(const CBlock& block, int nBlockHeight)
 
 void FillBlockPayee(CTransaction& txNew, int64_t nFees, bool fProofOfStake)
 {
+    PERF_TIMER(PERF_MNPAYMENTS);
     if (!IsSporkActive(SPORK_1_ENABLE_MASTERNODE_PAYMENTS))
         return;
 
@@ -643,6 +646,7 @@ bool CMasternodePaymentWinner::IsValid(CNode* pnode, std::string& strError)
 
 bool CMasternodePayments::ProcessBlock(int nBlockHeight)
 {
+    PERF_TIMER(PERF_MNPAYMENTS);
     if (!fMasterNode) return false;
 
     //reference node - hybrid mode
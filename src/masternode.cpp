@@ -83,7 +83,7 @@ CMasternode::CMasternode()
     unitTest = false;
     allowFreeTx = true;
     nActiveState = MASTERNODE_ENABLED,
-    protocolVersion = PROTOCOL_VERSION;
+    protocolVersion = MASTERNODE_PROTO_VERSION;
     nLastDsq = 0;
     nScanningErrorCount = 0;
     nLastScanningErrorBlockHeight = 0;
@@ -362,7 +362,7 @@ CMasternodeBroadcast::CMasternodeBroadcast()
     cacheInputAgeBlock = 0;
     unitTest = false;
     allowFreeTx = true;
-    protocolVersion = PROTOCOL_VERSION;
+    protocolVersion = MASTERNODE_PROTO_VERSION;
     nLastDsq = 0;
     nScanningErrorCount = 0;
     nLastScanningErrorBlockHeight = 0;
@@ -477,7 +477,7 @@ bool CMasternodeBroadcast::Create(CTxIn txin, CService service, CKey keyCollater
         return false;
     }
 
-    mnbRet = CMasternodeBroadcast(service, txin, pubKeyCollateralAddressNew, pubKeyMasternodeNew, PROTOCOL_VERSION);
+    mnbRet = CMasternodeBroadcast(service, txin, pubKeyCollateralAddressNew, pubKeyMasternodeNew, MASTERNODE_PROTO_VERSION);
 
     mnbRet.lastPing = mnp;
     if (!mnbRet.Sign(keyCollateralAddressNew))
@@ -665,7 +665,7 @@ bool CMasternodeBroadcast::CheckInputsAndAdd(int& nDoS)
     mnodeman.Add(mn);
 
     // if it matches our Masternode privkey, then we've been remotely activated
-    if (pubKeyMasternode == activeMasternode.pubKeyMasternode && protocolVersion == PROTOCOL_VERSION)
+    if (pubKeyMasternode == activeMasternode.pubKeyMasternode && protocolVersion == MASTERNODE_PROTO_VERSION)
         activeMasternode.EnableHotColdMasterNode(vin, addr);
 
     bool isLocal = addr.IsRFC1918() || addr.IsLocal();
@@ -9,6 +9,7 @@
 #include "kernel.h"
 #include "masternode-sync.h"
 #include "masternode-payments.h"
+#include "perfstats.h"
 
 using namespace std;
 
@@ -102,6 +103,7 @@ public:
 // CreateNewBlock: create new block (without proof-of-work/proof-of-stake)
 CBlock* CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, CAmount* pFees)
 {
+    PERF_TIMER(PERF_CREATENEWBLOCK);
     // Create new block
     auto_ptr<CBlock> pblock(new CBlock());
     if (!pblock.get())
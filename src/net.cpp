@@ -540,7 +540,15 @@ void CNode::copyStats(CNodeStats &stats)
     X(fInbound);
     X(nStartingHeight);
     X(nSendBytes);
+    {
+        LOCK(cs_vSend);
+        X(mapSendBytesPerMsgCmd);
+    }
     X(nRecvBytes);
+    {
+        LOCK(cs_vRecvMsg);
+        X(mapRecvBytesPerMsgCmd);
+    }
     stats.fSyncNode = (this == pnodeSync);
 
     // It is common for nodes with good ping times to suddenly become lagged,
@@ -587,11 +595,27 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
 
         pch += handled;
         nBytes -= handled;
+
+        if (msg.complete())
+        {
+            // Commands from the wire are only trusted as map keys when well-formed
+            string strCommand = msg.hdr.IsValid() ? msg.hdr.GetCommand() : "*other*";
+            AccountForMsgBytes(mapRecvBytesPerMsgCmd, strCommand, msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE);
+        }
     }
 
     return true;
 }
 
+void CNode::AccountForMsgBytes(mapMsgCmdSize& mapBytes, const string& strCommand, uint64_t nBytes)
+{
+    static const size_t MAX_MSG_CMDS = 64;
+    mapMsgCmdSize::iterator it = mapBytes.find(strCommand);
+    if (it == mapBytes.end())
+        it = mapBytes.insert(make_pair(mapBytes.size() < MAX_MSG_CMDS ? strCommand : string("*other*"), (uint64_t)0)).first;
+    it->second += nBytes;
+}
+
 int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
@@ -157,6 +157,8 @@ struct LocalServiceInfo {
 extern CCriticalSection cs_mapLocalHost;
 extern map<CNetAddr, LocalServiceInfo> mapLocalHost;
 
+typedef std::map<std::string, uint64_t> mapMsgCmdSize; // command -> bytes, header included
+
 class CNodeStats
 {
 public:
@@ -173,7 +175,9 @@ public:
     bool fInbound;
     int nStartingHeight;
     uint64_t nSendBytes;
+    mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
+    mapMsgCmdSize mapRecvBytesPerMsgCmd;
     bool fSyncNode;
     double dPingTime;
     double dPingWait;
@@ -231,11 +235,13 @@ public:
     uint64_t nSendBytes;
     std::deque<CSerializeData> vSendMsg;
     CCriticalSection cs_vSend;
+    mapMsgCmdSize mapSendBytesPerMsgCmd; // protected by cs_vSend
 
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
     uint64_t nRecvBytes;
+    mapMsgCmdSize mapRecvBytesPerMsgCmd; // protected by cs_vRecvMsg
     int nRecvVersion;
 
     int64_t nLastSend;
@@ -549,6 +555,9 @@ public:
 
         LogPrint("net", "(%d bytes)\n", nSize);
 
+        const char* pchCommand = &ssSend[MESSAGE_START_SIZE];
+        AccountForMsgBytes(mapSendBytesPerMsgCmd, std::string(pchCommand, strnlen(pchCommand, CMessageHeader::COMMAND_SIZE)), ssSend.size());
+
         std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
         ssSend.GetAndClear(*it);
         nSendSize += (*it).size();
@@ -820,6 +829,10 @@ template<typename T1, typename T2, typename T3, typename T4, typename T5, typena
     static bool Ban(const CNetAddr &ip);
     void copyStats(CNodeStats &stats);
 
+    /** Add to the byte count of a command, keeping the number of distinct
+     *  commands per peer bounded */
+    static void AccountForMsgBytes(mapMsgCmdSize& mapBytes, const std::string& strCommand, uint64_t nBytes);
+
     // Network stats
     static void RecordBytesRecv(uint64_t bytes);
     static void RecordBytesSent(uint64_t bytes);
@@ -0,0 +1,189 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "perfstats.h"
+
+#include "util.h"
+
+#include <limits>
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+
+using namespace std;
+
+static const unsigned int MAX_MESSAGE_HISTOGRAMS = 64;
+
+// Values below 4 get a bucket each; above, the exponent picks a group of
+// four and the two bits after the leading one pick the bucket within it
+static int BucketIndex(uint64_t n)
+{
+    if (n < 4)
+        return n;
+    int nExp = 63 - __builtin_clzll(n);
+    int nIndex = 4 * (nExp - 1) + ((n >> (nExp - 2)) & 3);
+    return min(nIndex, CPerfHistogram::NUM_BUCKETS - 1);
+}
+
+// Largest value that falls in a bucket; the last one takes everything above
+static uint64_t BucketLimit(int nIndex)
+{
+    if (nIndex == CPerfHistogram::NUM_BUCKETS - 1)
+        return std::numeric_limits<uint64_t>::max();
+    if (nIndex < 4)
+        return nIndex;
+    int nExp = nIndex / 4 + 1;
+    return ((uint64_t)(5 + nIndex % 4) << (nExp - 2)) - 1;
+}
+
+void CPerfHistogram::Add(int64_t nMicros)
+{
+    uint64_t n = nMicros > 0 ? nMicros : 0;
+    nCount.fetch_add(1, memory_order_relaxed);
+    nTotal.fetch_add(n, memory_order_relaxed);
+    vBuckets[BucketIndex(n)].fetch_add(1, memory_order_relaxed);
+    uint64_t nPrevMax = nMax.load(memory_order_relaxed);
+    while (n > nPrevMax && !nMax.compare_exchange_weak(nPrevMax, n, memory_order_relaxed))
+        ;
+}
+
+void CPerfHistogram::GetSummary(CPerfSummary& summary) const
+{
+    uint64_t vCounts[NUM_BUCKETS];
+    uint64_t nSamples = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++)
+    {
+        vCounts[i] = vBuckets[i].load(memory_order_relaxed);
+        nSamples += vCounts[i];
+    }
+    summary.nCount = nCount.load(memory_order_relaxed);
+    summary.nTotal = nTotal.load(memory_order_relaxed);
+    summary.nMax = nMax.load(memory_order_relaxed);
+
+    // Report a bucket's upper end, but never more than the maximum seen
+    const double dPercentiles[] = { 0.50, 0.90, 0.99 };
+    uint64_t* pnResults[] = { &summary.nP50, &summary.nP90, &summary.nP99 };
+    for (int p = 0; p < 3; p++)
+    {
+        *pnResults[p] = 0;
+        if (nSamples == 0)
+            continue;
+        uint64_t nRank = (uint64_t)(dPercentiles[p] * nSamples);
+        uint64_t nSeen = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++)
+        {
+            nSeen += vCounts[i];
+            if (nSeen > nRank)
+            {
+                *pnResults[p] = min(BucketLimit(i), summary.nMax);
+                break;
+            }
+        }
+    }
+}
+
+void CPerfHistogram::Reset()
+{
+    nCount.store(0, memory_order_relaxed);
+    nTotal.store(0, memory_order_relaxed);
+    nMax.store(0, memory_order_relaxed);
+    for (int i = 0; i < NUM_BUCKETS; i++)
+        vBuckets[i].store(0, memory_order_relaxed);
+}
+
+static CPerfHistogram perfStages[PERF_STAGE_COUNT];
+
+static const char* const pszPerfStageNames[PERF_STAGE_COUNT] = {
+    "blockread",
+    "blockdeserialize",
+    "checkblock",
+    "connectblock",
+    "fetchinputs",
+    "scriptcheck",
+    "txdbcommit",
+    "accepttomemorypool",
+    "createnewblock",
+    "createcoinstake",
+    "masternodepayments",
+    "masternoderank",
+};
+
+// Histograms are created on first use and never freed, so references
+// handed out stay valid
+static boost::mutex csMessagePerf;
+static map<string, CPerfHistogram*> mapMessagePerf;
+
+CPerfHistogram& GetPerfHistogram(PerfStage stage)
+{
+    return perfStages[stage];
+}
+
+const char* GetPerfStageName(PerfStage stage)
+{
+    return pszPerfStageNames[stage];
+}
+
+CPerfHistogram& GetMessagePerfHistogram(const string& strCommand)
+{
+    boost::lock_guard<boost::mutex> lock(csMessagePerf);
+    map<string, CPerfHistogram*>::iterator it = mapMessagePerf.find(strCommand);
+    if (it != mapMessagePerf.end())
+        return *it->second;
+
+    string strKey = strCommand;
+    if (mapMessagePerf.size() >= MAX_MESSAGE_HISTOGRAMS)
+    {
+        strKey = "*other*";
+        it = mapMessagePerf.find(strKey);
+        if (it != mapMessagePerf.end())
+            return *it->second;
+    }
+    CPerfHistogram* phistogram = new CPerfHistogram();
+    mapMessagePerf[strKey] = phistogram;
+    return *phistogram;
+}
+
+void GetMessagePerfSummaries(vector<pair<string, CPerfSummary> >& vSummaries)
+{
+    boost::lock_guard<boost::mutex> lock(csMessagePerf);
+    vSummaries.clear();
+    for (map<string, CPerfHistogram*>::const_iterator it = mapMessagePerf.begin(); it != mapMessagePerf.end(); ++it)
+    {
+        CPerfSummary summary;
+        it->second->GetSummary(summary);
+        vSummaries.push_back(make_pair(it->first, summary));
+    }
+}
+
+void ResetPerfStats()
+{
+    for (int i = 0; i < PERF_STAGE_COUNT; i++)
+        perfStages[i].Reset();
+    boost::lock_guard<boost::mutex> lock(csMessagePerf);
+    for (map<string, CPerfHistogram*>::iterator it = mapMessagePerf.begin(); it != mapMessagePerf.end(); ++it)
+        it->second->Reset();
+}
+
+static void LogPerfSummary(const string& strName, const CPerfSummary& summary)
+{
+    if (summary.nCount == 0)
+        return;
+    LogPrintf("perf %-20s n=%u avg=%uus p50=%uus p90=%uus p99=%uus max=%uus\n", strName, summary.nCount,
+        summary.nTotal / summary.nCount, summary.nP50, summary.nP90, summary.nP99, summary.nMax);
+}
+
+void LogPerfStats()
+{
+    for (int i = 0; i < PERF_STAGE_COUNT; i++)
+    {
+        CPerfSummary summary;
+        perfStages[i].GetSummary(summary);
+        LogPerfSummary(pszPerfStageNames[i], summary);
+    }
+
+    vector<pair<string, CPerfSummary> > vSummaries;
+    GetMessagePerfSummaries(vSummaries);
+    for (unsigned int i = 0; i < vSummaries.size(); i++)
+        LogPerfSummary("msg " + vSummaries[i].first, vSummaries[i].second);
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+/** Hot paths that are timed */
+enum PerfStage
+{
+    PERF_BLOCKREAD,         // imported blocks only
+    PERF_BLOCKDESERIALIZE,  // imported blocks only
+    PERF_CHECKBLOCK,
+    PERF_CONNECTBLOCK,
+    PERF_FETCHINPUTS,       // per transaction
+    PERF_SCRIPTCHECK,       // per input, summed over the -par threads
+    PERF_TXDBCOMMIT,
+    PERF_ACCEPTTOMEMPOOL,
+    PERF_CREATENEWBLOCK,
+    PERF_CREATECOINSTAKE,
+    PERF_MNPAYMENTS,
+    PERF_MNRANK,
+
+    PERF_STAGE_COUNT
+};
+
+struct CPerfSummary
+{
+    uint64_t nCount;
+    uint64_t nTotal;
+    uint64_t nMax;
+    uint64_t nP50;
+    uint64_t nP90;
+    uint64_t nP99;
+};
+
+/** Histogram of durations in microseconds that any thread can add to
+ *  without locking. Buckets are log-linear, four per power of two, so
+ *  percentiles are exact below 8us and within 25% above. */
+class CPerfHistogram
+{
+public:
+    static const int NUM_BUCKETS = 160;
+
+    CPerfHistogram() { Reset(); }
+
+    void Add(int64_t nMicros);
+    void GetSummary(CPerfSummary& summary) const;
+    /** Samples added while resetting may be lost */
+    void Reset();
+
+private:
+    std::atomic<uint64_t> nCount;
+    std::atomic<uint64_t> nTotal;
+    std::atomic<uint64_t> nMax;
+    std::atomic<uint64_t> vBuckets[NUM_BUCKETS];
+};
+
+static inline int64_t GetPerfTimeMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Adds the lifetime of the scope to a histogram, also on exceptions and
+ *  early returns */
+class CPerfTimer
+{
+private:
+    CPerfHistogram& histogram;
+    int64_t nStart;
+
+public:
+    explicit CPerfTimer(CPerfHistogram& histogramIn) : histogram(histogramIn), nStart(GetPerfTimeMicros()) {}
+    ~CPerfTimer() { histogram.Add(GetPerfTimeMicros() - nStart); }
+};
+
+CPerfHistogram& GetPerfHistogram(PerfStage stage);
+/** Processing time of a P2P message command. Commands beyond the first 64
+ *  seen, or malformed ones, share the "*other*" histogram. */
+CPerfHistogram& GetMessagePerfHistogram(const std::string& strCommand);
+
+#define PERF_TIMER(stage) CPerfTimer perftimer(GetPerfHistogram(stage))
+
+const char* GetPerfStageName(PerfStage stage);
+void GetMessagePerfSummaries(std::vector<std::pair<std::string, CPerfSummary> >& vSummaries);
+void ResetPerfStats();
+/** Write a summary of every stage and command to debug.log (-perflog) */
+void LogPerfStats();
+
+#endif // PERFSTATS_H
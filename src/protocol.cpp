@@ -25,7 +25,8 @@ static const char* ppszTypeName[] =
     "mn scan error",
     "mn quorum",
     "mn announce",
-    "mn ping"
+    "mn ping",
+    "cmpct block"
 };
 
 CMessageHeader::CMessageHeader()
@@ -157,7 +157,9 @@ enum {
     MSG_MASTERNODE_QUORUM,
     MSG_MASTERNODE_ANNOUNCE,
     MSG_MASTERNODE_PING,
-    MSG_DSTX
+    MSG_DSTX,
+    // Only valid in getdata, asks for the block as a "cmpctblock" message
+    MSG_CMPCT_BLOCK
 };
 
 #endif // __INCLUDED_PROTOCOL_H__
@@ -91,7 +91,8 @@ BitcoinGUI::BitcoinGUI(const NetworkStyle* networkStyle, QWidget* parent): QMain
                                                                             notificator(0),
                                                                             rpcConsole(0),
                                                                             prevBlocks(0),
-                                                                            nWeight(0)
+                                                                            nWeight(0),
+                                                                            fSyncing(true)
 {
     GUIUtil::restoreWindowGeometry("nWindow", QSize(1006, 680), this);
 
@@ -546,6 +547,9 @@ void BitcoinGUI::setWalletModel(WalletModel *walletModel)
         signVerifyMessageDialog->setModel(walletModel);
         masternodePage->setWalletModel(walletModel);
 
+        // Staking weight is computed by the wallet model off the GUI thread
+        connect(walletModel, SIGNAL(stakingChanged(quint64,bool)), this, SLOT(updateStaking(quint64,bool)));
+
         setEncryptionStatus(walletModel->getEncryptionStatus());
         connect(walletModel, SIGNAL(encryptionStatusChanged(int)), this, SLOT(setEncryptionStatus(int)));
 
@@ -1125,27 +1129,16 @@ void BitcoinGUI::toggleHidden()
     showNormalIfMinimized(true);
 }
 
-void BitcoinGUI::updateWeight()
+void BitcoinGUI::updateStaking(quint64 nWeight, bool fSyncing)
 {
-    if (!pwalletMain)
-        return;
-
-    TRY_LOCK(cs_main, lockMain);
-    if (!lockMain)
-        return;
-
-    TRY_LOCK(pwalletMain->cs_wallet, lockWallet);
-    if (!lockWallet)
-        return;
-
-    if (pwalletMain)
-        pwalletMain->GetStakeWeight(nMinWeight, nMaxWeight, nWeight);
+    this->nWeight = nWeight;
+    this->fSyncing = fSyncing;
+    if (GetBoolArg("-staking", true))
+        setStakingStatus();
 }
 
 void BitcoinGUI::setStakingStatus()
 {
-    updateWeight();
-
     if (nLastCoinStakeSearchInterval && nWeight)
     {
         labelStakingIcon->setPixmap(QIcon(":/icons/staking_on").pixmap(STATUSBAR_ICONSIZE, STATUSBAR_ICONSIZE));
@@ -1158,7 +1151,7 @@ void BitcoinGUI::setStakingStatus()
             labelStakingIcon->setToolTip(tr("Not staking because wallet is locked"));
         else if (vNodes.empty())
             labelStakingIcon->setToolTip(tr("Not staking because wallet is offline"));
-        else if (IsInitialBlockDownload())
+        else if (fSyncing)
             labelStakingIcon->setToolTip(tr("Not staking because wallet is syncing"));
         else if (!nWeight)
             labelStakingIcon->setToolTip(tr("Not staking because you don't have mature coins"));
@@ -122,9 +122,9 @@ private:
     /** Keep track of previous number of blocks, to detect progress */
     int prevBlocks;
 
-    uint64_t nMinWeight;
-    uint64_t nMaxWeight;
+    /** Staking weight and sync state, as last reported by the wallet model */
     uint64_t nWeight;
+    bool fSyncing;
 
     /** Create the main UI actions. */
     void createActions();
@@ -227,7 +227,7 @@ private slots:
     /** simply calls showNormalIfMinimized(true) for use in SLOT() macro */
     void toggleHidden();
 
-    void updateWeight();
+    void updateStaking(quint64 nWeight, bool fSyncing);
     void setStakingStatus();
 
     /** called by a timer to check if fRequestShutdown has been set **/
@@ -21,29 +21,70 @@
 #include "masternode-manager.h"
 
 #include <QDateTime>
+#include <QThread>
 #include <QTimer>
 #include <QDebug>
 
 static const int64_t nClientStartupTime = GetTime();
 
+ClientModelWorker::ClientModelWorker() : QObject(0)
+{
+    timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(updateMasternodes()));
+}
+
+void ClientModelWorker::start()
+{
+    // no need to update as frequent as data for balances/txes/blocks
+    timer->start(MODEL_UPDATE_DELAY * 4);
+}
+
+void ClientModelWorker::updateMasternodes()
+{
+    QString newMasternodeCountString = tr("Total: %1 (OBF compatible: %2 / Enabled: %3)").arg(QString::number((int)mnodeman.size())).arg(QString::number((int)mnodeman.CountEnabled(ActiveProtocol()))).arg(QString::number((int)mnodeman.CountEnabled()));
+
+    if (cachedMasternodeCountString != newMasternodeCountString) {
+        cachedMasternodeCountString = newMasternodeCountString;
+
+        emit strMasternodesChanged(cachedMasternodeCountString);
+    }
+}
+
 ClientModel::ClientModel(OptionsModel* optionsModel, QObject* parent) : QObject(parent),
                                                                         optionsModel(optionsModel),
                                                                         peerTableModel(0),
+                                                                        fTipQueued(false),
                                                                         cachedNumBlocks(0),
-                                                                        cachedMasternodeCountString(""),
                                                                         numBlocksAtStartup(-1),
+                                                                        cachedMasternodeCountString(""),
                                                                         pollTimer(0)
 {
+    {
+        LOCK(cs_main);
+        nTipHeight = nBestHeight;
+        nTipTime = pindexBest ? pindexBest->GetBlockTime() : Params().GenesisBlock().nTime;
+    }
+    cachedNumBlocks = nTipHeight;
+
     peerTableModel = new PeerTableModel(this);
     pollTimer = new QTimer(this);
     connect(pollTimer, SIGNAL(timeout()), this, SLOT(updateTimer()));
     pollTimer->setInterval(MODEL_UPDATE_DELAY);
     pollTimer->start();
 
-    pollMnTimer = new QTimer(this);
-    connect(pollMnTimer, SIGNAL(timeout()), this, SLOT(updateMnTimer()));
-    // no need to update as frequent as data for balances/txes/blocks
-    pollMnTimer->start(MODEL_UPDATE_DELAY * 4);
+    // Blocks can arrive much faster than they are worth redrawing for, so
+    // tip notifications are gathered up for one update delay
+    tipTimer = new QTimer(this);
+    tipTimer->setSingleShot(true);
+    tipTimer->setInterval(MODEL_UPDATE_DELAY);
+    connect(tipTimer, SIGNAL(timeout()), this, SLOT(updateNumBlocks()));
+
+    workerThread = new QThread(this);
+    worker = new ClientModelWorker();
+    worker->moveToThread(workerThread);
+    connect(workerThread, SIGNAL(started()), worker, SLOT(start()));
+    connect(worker, SIGNAL(strMasternodesChanged(QString)), this, SLOT(updateMasternodeCount(QString)));
+    workerThread->start();
 
     subscribeToCoreSignals();
 }
@@ -51,6 +92,9 @@ ClientModel::ClientModel(OptionsModel* optionsModel, QObject* parent) : QObject(
 ClientModel::~ClientModel()
 {
     unsubscribeFromCoreSignals();
+    workerThread->quit();
+    workerThread->wait();
+    delete worker;
 }
 
 int ClientModel::getNumConnections(unsigned int flags) const
@@ -69,13 +113,12 @@ int ClientModel::getNumConnections(unsigned int flags) const
 
 QString ClientModel::getMasternodeCountString() const
 {
-    return tr("Total: %1 (OBF compatible: %2 / Enabled: %3)").arg(QString::number((int)mnodeman.size())).arg(QString::number((int)mnodeman.CountEnabled(ActiveProtocol()))).arg(QString::number((int)mnodeman.CountEnabled()));
+    return cachedMasternodeCountString;
 }
 
 int ClientModel::getNumBlocks() const
 {
-    LOCK(cs_main);
-    return nBestHeight;
+    return nTipHeight;
 }
 
 int ClientModel::getNumBlocksAtStartup()
@@ -96,24 +139,26 @@ quint64 ClientModel::getTotalBytesSent() const
 
 QDateTime ClientModel::getLastBlockDate() const
 {
-    LOCK(cs_main);
-    if (pindexBest)
-        return QDateTime::fromTime_t(pindexBest->GetBlockTime());
-    else
-        return QDateTime::fromTime_t(Params().GenesisBlock().nTime); // Genesis block's time of current network
+    return QDateTime::fromTime_t(nTipTime);
 }
 
 
+void ClientModel::setBlockTip(int nHeight, int64_t nTime)
+{
+    nTipHeight = nHeight;
+    nTipTime = nTime;
+    if (!fTipQueued.exchange(true))
+        QMetaObject::invokeMethod(tipTimer, "start", Qt::QueuedConnection);
+}
+
 void ClientModel::updateTimer()
 {
-    // Get required lock upfront. This avoids the GUI from getting stuck on
-    // periodical polls if the core is holding the locks for a longer time -
-    // for example, during a wallet rescan.
-    TRY_LOCK(cs_main, lockMain);
-    if (!lockMain)
-        return;
-    // Some quantities (such as number of blocks) change so fast that we don't want to be notified for each change.
-    // Periodically check and update with a timer.
+    emit bytesChanged(getTotalBytesRecv(), getTotalBytesSent());
+}
+
+void ClientModel::updateNumBlocks()
+{
+    fTipQueued = false;
     int newNumBlocks = getNumBlocks();
 
     if (cachedNumBlocks != newNumBlocks)
@@ -122,25 +167,12 @@ void ClientModel::updateTimer()
 
         emit numBlocksChanged(newNumBlocks);
     }
-
-    emit bytesChanged(getTotalBytesRecv(), getTotalBytesSent());
 }
 
-void ClientModel::updateMnTimer()
+void ClientModel::updateMasternodeCount(const QString& strMasternodes)
 {
-    // Get required lock upfront. This avoids the GUI from getting stuck on
-    // periodical polls if the core is holding the locks for a longer time -
-    // for example, during a wallet rescan.
-    TRY_LOCK(cs_main, lockMain);
-    if (!lockMain)
-        return;
-    QString newMasternodeCountString = getMasternodeCountString();
-
-    if (cachedMasternodeCountString != newMasternodeCountString) {
-        cachedMasternodeCountString = newMasternodeCountString;
-
-        emit strMasternodesChanged(cachedMasternodeCountString);
-    }
+    cachedMasternodeCountString = strMasternodes;
+    emit strMasternodesChanged(strMasternodes);
 }
 
 void ClientModel::updateNumConnections(int numConnections)
@@ -254,12 +286,18 @@ static void NotifyAlertChanged(ClientModel* clientmodel, const uint256& hash, Ch
         Q_ARG(int, status));
 }
 
+static void NotifyBlockTip(ClientModel* clientmodel, int nHeight, int64_t nTime)
+{
+    clientmodel->setBlockTip(nHeight, nTime);
+}
+
 void ClientModel::subscribeToCoreSignals()
 {
     // Connect signals to client
     uiInterface.ShowProgress.connect(boost::bind(ShowProgress, this, _1, _2));
     uiInterface.NotifyNumConnectionsChanged.connect(boost::bind(NotifyNumConnectionsChanged, this, _1));
     uiInterface.NotifyAlertChanged.connect(boost::bind(NotifyAlertChanged, this, _1, _2));
+    uiInterface.NotifyBlockTip.connect(boost::bind(NotifyBlockTip, this, _1, _2));
 }
 
 void ClientModel::unsubscribeFromCoreSignals()
@@ -268,4 +306,5 @@ void ClientModel::unsubscribeFromCoreSignals()
     uiInterface.ShowProgress.disconnect(boost::bind(ShowProgress, this, _1, _2));
     uiInterface.NotifyNumConnectionsChanged.disconnect(boost::bind(NotifyNumConnectionsChanged, this, _1));
     uiInterface.NotifyAlertChanged.disconnect(boost::bind(NotifyAlertChanged, this, _1, _2));
+    uiInterface.NotifyBlockTip.disconnect(boost::bind(NotifyBlockTip, this, _1, _2));
 }
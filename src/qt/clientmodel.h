@@ -10,6 +10,8 @@
 
 #include <QObject>
 
+#include <atomic>
+
 class OptionsModel;
 class PeerTableModel;
 class AddressTableModel;
@@ -18,6 +20,7 @@ class CWallet;
 
 QT_BEGIN_NAMESPACE
 class QDateTime;
+class QThread;
 class QTimer;
 QT_END_NAMESPACE
 
@@ -35,6 +38,30 @@ enum NumConnections {
     CONNECTIONS_ALL = (CONNECTIONS_IN | CONNECTIONS_OUT),
 };
 
+/** Samples the masternode list for ClientModel on a thread of its own.
+ *  Checking masternodes takes cs_main, which the GUI thread should not wait on.
+ */
+class ClientModelWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ClientModelWorker();
+
+private:
+    QTimer* timer;
+    QString cachedMasternodeCountString;
+
+public slots:
+    void start();
+
+private slots:
+    void updateMasternodes();
+
+signals:
+    void strMasternodesChanged(const QString& strMasternodes);
+};
+
 /** Model for Monkey network client. */
 class ClientModel : public QObject
 {
@@ -79,12 +106,18 @@ private:
     OptionsModel* optionsModel;
     PeerTableModel* peerTableModel;
 
+    // Chain tip as last announced by the core, readable without cs_main
+    std::atomic<int> nTipHeight;
+    std::atomic<int64_t> nTipTime;
+    std::atomic<bool> fTipQueued;
     int cachedNumBlocks;
     int numBlocksAtStartup;
     QString cachedMasternodeCountString;
 
     QTimer* pollTimer;
-    QTimer* pollMnTimer;
+    QTimer* tipTimer;
+    QThread* workerThread;
+    ClientModelWorker* worker;
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
@@ -102,9 +135,14 @@ signals:
     // Show progress dialog e.g. for verifychain
     void showProgress(const QString& title, int nProgress);
 
+public:
+    /** Record a new chain tip; safe to call from any thread */
+    void setBlockTip(int nHeight, int64_t nTime);
+
 public slots:
     void updateTimer();
-    void updateMnTimer();
+    void updateNumBlocks();
+    void updateMasternodeCount(const QString& strMasternodes);
     void updateNumConnections(int numConnections);
     void updateAlert(const QString& hash, int status);
 };
@@ -51,7 +51,8 @@ MasternodeList::MasternodeList(QWidget* parent) : QWidget(parent),
 
     timer = new QTimer(this);
     connect(timer, SIGNAL(timeout()), this, SLOT(updateMyNodeList()));
-    timer->start(1000);
+    // Started and stopped with the page, there is nothing to count down while it is hidden
+    timer->setInterval(1000);
 
     // Fill MN list
     fFilterUpdated = true;
@@ -220,6 +221,19 @@ void MasternodeList::updateMyNodeList(bool fForce)
     ui->labelAutoUpdateSeconds->setText("0");
 }
 
+void MasternodeList::showEvent(QShowEvent* event)
+{
+    QWidget::showEvent(event);
+    updateMyNodeList();
+    timer->start();
+}
+
+void MasternodeList::hideEvent(QHideEvent* event)
+{
+    timer->stop();
+    QWidget::hideEvent(event);
+}
+
 void MasternodeList::on_startButton_clicked()
 {
     // Find selected node alias
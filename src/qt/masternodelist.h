@@ -23,7 +23,9 @@ class ClientModel;
 class WalletModel;
 
 QT_BEGIN_NAMESPACE
+class QHideEvent;
 class QModelIndex;
+class QShowEvent;
 QT_END_NAMESPACE
 
 /** Masternode Manager page widget */
@@ -45,6 +47,10 @@ private:
     int64_t nTimeFilterUpdated;
     bool fFilterUpdated;
 
+protected:
+    void showEvent(QShowEvent* event);
+    void hideEvent(QHideEvent* event);
+
 public Q_SLOTS:
     void updateMyMasternodeInfo(QString strAlias, QString strAddr, CMasternode* pmn);
     void updateMyNodeList(bool fForce = false);
@@ -14,6 +14,7 @@
 
 #include <QList>
 #include <QColor>
+#include <QTimer>
 #include <QIcon>
 #include <QDateTime>
 #include <QDebug>
@@ -28,20 +29,16 @@ static int column_alignments[] = {
     Qt::AlignRight | Qt::AlignVCenter /* amount */
 };
 
-// Comparison operator for sort/binary search of model tx list
-struct TxLessThan {
-    bool operator()(const TransactionRecord& a, const TransactionRecord& b) const
-    {
-        return a.hash < b.hash;
-    }
-    bool operator()(const TransactionRecord& a, const uint256& b) const
-    {
-        return a.hash < b;
-    }
-    bool operator()(const uint256& a, const TransactionRecord& b) const
-    {
-        return a < b.hash;
-    }
+// Wallet transactions decomposed when the table is created; older ones
+// follow in chunks as the view scrolls down to them, or while the GUI is idle
+static const int TX_TABLE_INITIAL_LOAD = 1000;
+static const int TX_TABLE_FETCH_CHUNK = 500;
+
+// Change notification waiting to be applied to the model
+struct TransactionTableUpdate {
+    uint256 hash;
+    int status;
+    bool showTransaction;
 };
 
 // Private implementation
@@ -49,106 +46,179 @@ class TransactionTablePriv
 {
 public:
     TransactionTablePriv(CWallet* wallet, TransactionTableModel* parent) : wallet(wallet),
-                                                                           parent(parent)
+                                                                           parent(parent),
+                                                                           nLoadedOrderPos(std::numeric_limits<int64_t>::max()),
+                                                                           fFullyLoaded(false)
     {
     }
 
     CWallet* wallet;
     TransactionTableModel* parent;
 
-    /* Local cache of wallet.
-     * As it is in the same order as the CWallet, by definition
-     * this is sorted by sha256.
+    /* Local cache of wallet, filled newest first from CWallet::wtxOrdered.
+     * Records of one transaction are adjacent; transactions that came in
+     * after loading are appended at the end. The proxy model does the
+     * sorting, so the order here does not matter otherwise.
      */
     QList<TransactionRecord> cachedWallet;
+    /* Row of the first record of each transaction in cachedWallet */
+    std::map<uint256, int> mapRows;
+    /* Order position of the oldest transaction loaded so far */
+    int64_t nLoadedOrderPos;
+    bool fFullyLoaded;
 
-    /* Query entire wallet anew from core.
+    std::vector<TransactionTableUpdate> vPendingUpdates;
+
+    /* Query wallet anew from core, up to TX_TABLE_INITIAL_LOAD transactions.
      */
     void refreshWallet()
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
+        mapRows.clear();
+        nLoadedOrderPos = std::numeric_limits<int64_t>::max();
+        fFullyLoaded = false;
+        loadMore(TX_TABLE_INITIAL_LOAD, false);
+    }
+
+    /* Decompose about the next nCount older transactions and append them. */
+    void loadMore(int nCount, bool fNotify)
+    {
+        if (fFullyLoaded)
+            return;
+
+        QList<TransactionRecord> toInsert;
         {
             LOCK2(cs_main, wallet->cs_wallet);
-            for (std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
-                if (TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+            CWallet::TxItems::reverse_iterator it(wallet->wtxOrdered.lower_bound(nLoadedOrderPos));
+            for (int n = 0; it != wallet->wtxOrdered.rend(); ++it, ++n) {
+                // Never stop between entries sharing an order position, the
+                // next chunk starts below it
+                if (n >= nCount && it->first != nLoadedOrderPos)
+                    break;
+                nLoadedOrderPos = it->first;
+                CWalletTx* pwtx = it->second.first;
+                if (pwtx && !mapRows.count(pwtx->GetHash()) && TransactionRecord::showTransaction(*pwtx))
+                    toInsert.append(TransactionRecord::decomposeTransaction(wallet, *pwtx));
+            }
+            fFullyLoaded = (it == wallet->wtxOrdered.rend());
         }
+        append(toInsert, fNotify);
+    }
+
+    void append(const QList<TransactionRecord>& toInsert, bool fNotify)
+    {
+        if (toInsert.isEmpty())
+            return;
+        if (fNotify)
+            parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size() + toInsert.size() - 1);
+        foreach (const TransactionRecord& rec, toInsert) {
+            mapRows.insert(std::make_pair(rec.hash, cachedWallet.size()));
+            cachedWallet.append(rec);
+        }
+        if (fNotify)
+            parent->endInsertRows();
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
        with that of the core.
 
-       Call with transaction that was added, removed or changed.
+       Applies the queued notifications about transactions that were added,
+       removed or changed. Consecutive additions become one row insertion.
      */
-    void updateWallet(const uint256& hash, int status, bool showTransaction)
+    void updateWallet()
     {
-        qDebug() << "TransactionTablePriv::updateWallet : " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
-
-        // Find bounds of this transaction in model
-        QList<TransactionRecord>::iterator lower = qLowerBound(
-            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-        QList<TransactionRecord>::iterator upper = qUpperBound(
-            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-        int lowerIndex = (lower - cachedWallet.begin());
-        int upperIndex = (upper - cachedWallet.begin());
-        bool inModel = (lower != upper);
-
-        if (status == CT_UPDATED) {
-            if (showTransaction && !inModel)
-                status = CT_NEW; /* Not in model, but want to show, treat as new */
-            if (!showTransaction && inModel)
-                status = CT_DELETED; /* In model, but want to hide, treat as deleted */
-        }
+        std::vector<TransactionTableUpdate> vUpdates;
+        vUpdates.swap(vPendingUpdates);
+
+        QList<TransactionRecord> toInsert;
+        std::set<uint256> setInserting;
+        BOOST_FOREACH (TransactionTableUpdate& update, vUpdates) {
+            const uint256& hash = update.hash;
+            int status = update.status;
+            bool showTransaction = update.showTransaction;
+
+            std::map<uint256, int>::iterator itRow = mapRows.find(hash);
+            bool inModel = (itRow != mapRows.end() || setInserting.count(hash));
+
+            if (status == CT_UPDATED) {
+                if (showTransaction && !inModel)
+                    status = CT_NEW; /* Not in model, but want to show, treat as new */
+                if (!showTransaction && inModel)
+                    status = CT_DELETED; /* In model, but want to hide, treat as deleted */
+            }
 
-        qDebug() << "    inModel=" + QString::number(inModel) +
-                        " Index=" + QString::number(lowerIndex) + "-" + QString::number(upperIndex) +
-                        " showTransaction=" + QString::number(showTransaction) + " derivedStatus=" + QString::number(status);
+            qDebug() << "TransactionTablePriv::updateWallet : " + QString::fromStdString(hash.ToString()) +
+                            " inModel=" + QString::number(inModel) +
+                            " showTransaction=" + QString::number(showTransaction) + " derivedStatus=" + QString::number(status);
 
-        switch (status) {
-        case CT_NEW:
-            if (inModel) {
-                qWarning() << "TransactionTablePriv::updateWallet : Warning: Got CT_NEW, but transaction is already in model";
-                break;
-            }
-            if (showTransaction) {
-                LOCK2(cs_main, wallet->cs_wallet);
-                // Find transaction in wallet
-                std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
-                if (mi == wallet->mapWallet.end()) {
-                    qWarning() << "TransactionTablePriv::updateWallet : Warning: Got CT_NEW, but transaction is not in wallet";
+            switch (status) {
+            case CT_NEW:
+                if (inModel) {
+                    qWarning() << "TransactionTablePriv::updateWallet : Warning: Got CT_NEW, but transaction is already in model";
                     break;
                 }
-                // Added -- insert at the right position
-                QList<TransactionRecord> toInsert =
-                    TransactionRecord::decomposeTransaction(wallet, mi->second);
-                if (!toInsert.isEmpty()) /* only if something to insert */
-                {
-                    parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex + toInsert.size() - 1);
-                    int insert_idx = lowerIndex;
-                    foreach (const TransactionRecord& rec, toInsert) {
-                        cachedWallet.insert(insert_idx, rec);
-                        insert_idx += 1;
+                if (showTransaction) {
+                    LOCK2(cs_main, wallet->cs_wallet);
+                    // Find transaction in wallet
+                    std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
+                    if (mi == wallet->mapWallet.end()) {
+                        qWarning() << "TransactionTablePriv::updateWallet : Warning: Got CT_NEW, but transaction is not in wallet";
+                        break;
+                    }
+                    // Added -- inserted at the end together with the ones that follow
+                    QList<TransactionRecord> records = TransactionRecord::decomposeTransaction(wallet, mi->second);
+                    if (!records.isEmpty()) {
+                        toInsert.append(records);
+                        setInserting.insert(hash);
                     }
-                    parent->endInsertRows();
                 }
-            }
-            break;
-        case CT_DELETED:
-            if (!inModel) {
-                qWarning() << "TransactionTablePriv::updateWallet : Warning: Got CT_DELETED, but transaction is not in model";
+                break;
+            case CT_DELETED:
+                if (!inModel) {
+                    qWarning() << "TransactionTablePriv::updateWallet : Warning: Got CT_DELETED, but transaction is not in model";
+                    break;
+                }
+                append(toInsert, true);
+                toInsert.clear();
+                setInserting.clear();
+                remove(hash);
+                break;
+            case CT_UPDATED:
+                // Miscellaneous updates -- drop the cached status, it is
+                // computed again when the rows are next looked at
+                if (itRow != mapRows.end()) {
+                    int row = itRow->second;
+                    int rowEnd = row;
+                    for (; rowEnd < cachedWallet.size() && cachedWallet[rowEnd].hash == hash; rowEnd++)
+                        cachedWallet[rowEnd].status.cur_num_blocks = -1;
+                    parent->emitDataChanged(row, rowEnd - 1);
+                }
                 break;
             }
-            // Removed -- remove entire transaction from table
-            parent->beginRemoveRows(QModelIndex(), lowerIndex, upperIndex - 1);
-            cachedWallet.erase(lower, upper);
-            parent->endRemoveRows();
-            break;
-        case CT_UPDATED:
-            // Miscellaneous updates -- nothing to do, status update will take care of this, and is only computed for
-            // visible transactions.
-            break;
         }
+        append(toInsert, true);
+    }
+
+    /* Remove all records of a transaction */
+    void remove(const uint256& hash)
+    {
+        std::map<uint256, int>::iterator itRow = mapRows.find(hash);
+        if (itRow == mapRows.end())
+            return;
+        int row = itRow->second;
+        int rowEnd = row;
+        while (rowEnd < cachedWallet.size() && cachedWallet[rowEnd].hash == hash)
+            rowEnd++;
+
+        parent->beginRemoveRows(QModelIndex(), row, rowEnd - 1);
+        cachedWallet.erase(cachedWallet.begin() + row, cachedWallet.begin() + rowEnd);
+        // Rows after the removed ones moved up
+        mapRows.erase(itRow);
+        for (std::map<uint256, int>::iterator it = mapRows.begin(); it != mapRows.end(); ++it)
+            if (it->second > row)
+                it->second -= rowEnd - row;
+        parent->endRemoveRows();
     }
 
     int size()
@@ -204,6 +274,19 @@ TransactionTableModel::TransactionTableModel(CWallet* wallet, WalletModel* paren
     columns << QString() << QString() << tr("Date") << tr("Type") << tr("Address") << BitcoinUnits::getAmountColumnTitle(walletModel->getOptionsModel()->getDisplayUnit());
     priv->refreshWallet();
 
+    // Notifications arrive one transaction at a time, a rescan sends thousands
+    updateTimer = new QTimer(this);
+    updateTimer->setSingleShot(true);
+    updateTimer->setInterval(MODEL_UPDATE_DELAY);
+    connect(updateTimer, SIGNAL(timeout()), this, SLOT(processPendingUpdates()));
+
+    // The rest of the history is loaded a chunk at a time when the event
+    // loop is idle, so that filters and totals see all of it
+    loadTimer = new QTimer(this);
+    connect(loadTimer, SIGNAL(timeout()), this, SLOT(loadInBackground()));
+    if (!priv->fFullyLoaded)
+        loadTimer->start(0);
+
     connect(walletModel->getOptionsModel(), SIGNAL(displayUnitChanged(int)), this, SLOT(updateDisplayUnit()));
 
     subscribeToCoreSignals();
@@ -224,20 +307,65 @@ void TransactionTableModel::updateAmountColumnTitle()
 
 void TransactionTableModel::updateTransaction(const QString& hash, int status, bool showTransaction)
 {
-    uint256 updated;
-    updated.SetHex(hash.toStdString());
+    TransactionTableUpdate update;
+    update.hash.SetHex(hash.toStdString());
+    update.status = status;
+    update.showTransaction = showTransaction;
+    priv->vPendingUpdates.push_back(update);
+
+    if (!updateTimer->isActive())
+        updateTimer->start();
+}
 
-    priv->updateWallet(updated, status, showTransaction);
+void TransactionTableModel::processPendingUpdates()
+{
+    priv->updateWallet();
+}
+
+void TransactionTableModel::loadInBackground()
+{
+    priv->loadMore(TX_TABLE_FETCH_CHUNK, true);
+    if (priv->fFullyLoaded)
+        loadTimer->stop();
+}
+
+bool TransactionTableModel::canFetchMore(const QModelIndex& parent) const
+{
+    Q_UNUSED(parent);
+    return !priv->fFullyLoaded;
+}
+
+void TransactionTableModel::fetchMore(const QModelIndex& parent)
+{
+    Q_UNUSED(parent);
+    loadInBackground();
+}
+
+void TransactionTableModel::emitDataChanged(int rowFirst, int rowLast)
+{
+    emit dataChanged(index(rowFirst, 0), index(rowLast, columns.length() - 1));
 }
 
 void TransactionTableModel::updateConfirmations()
 {
     // Blocks came in since last poll.
     // Invalidate status (number of confirmations) and (possibly) description
-    //  for all rows. Qt is smart enough to only actually request the data for the
-    //  visible rows.
-    emit dataChanged(index(0, Status), index(priv->size() - 1, Status));
-    emit dataChanged(index(0, ToAddress), index(priv->size() - 1, ToAddress));
+    //  of the rows whose status can still change. A confirmed transaction
+    //  keeps its icon and sort key, and its tooltip is computed when shown,
+    //  so with a long history most rows are left alone. Qt is smart enough to
+    //  only actually request the data for the visible rows.
+    int rowFirst = -1;
+    for (int row = 0; row <= priv->size(); row++) {
+        bool fSettled = row == priv->size() || (priv->cachedWallet[row].status.status == TransactionStatus::Confirmed &&
+                                                   priv->cachedWallet[row].status.cur_num_blocks != -1);
+        if (!fSettled && rowFirst == -1)
+            rowFirst = row;
+        if (fSettled && rowFirst != -1) {
+            emit dataChanged(index(rowFirst, Status), index(row - 1, Status));
+            emit dataChanged(index(rowFirst, ToAddress), index(row - 1, ToAddress));
+            rowFirst = -1;
+        }
+    }
 }
 
 int TransactionTableModel::rowCount(const QModelIndex& parent) const
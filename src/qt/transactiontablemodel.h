@@ -11,6 +11,10 @@ class TransactionTablePriv;
 class TransactionRecord;
 class WalletModel;
 
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
 /** UI model for the transaction table of a wallet.
  */
 class TransactionTableModel : public QAbstractTableModel
@@ -67,12 +71,16 @@ public:
     QVariant data(const QModelIndex& index, int role) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const;
+    bool canFetchMore(const QModelIndex& parent) const;
+    void fetchMore(const QModelIndex& parent);
 
 private:
     CWallet* wallet;
     WalletModel* walletModel;
     QStringList columns;
     TransactionTablePriv* priv;
+    QTimer* updateTimer;
+    QTimer* loadTimer;
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
@@ -88,6 +96,7 @@ private:
     QVariant txStatusDecoration(const TransactionRecord* wtx) const;
     QVariant txWatchonlyDecoration(const TransactionRecord* wtx) const;
     QVariant txAddressDecoration(const TransactionRecord* wtx) const;
+    void emitDataChanged(int rowFirst, int rowLast);
 
 public slots:
     /* New transaction, or transaction changed status */
@@ -98,6 +107,10 @@ public slots:
     void updateAmountColumnTitle();
 
     friend class TransactionTablePriv;
+
+private slots:
+    void processPendingUpdates();
+    void loadInBackground();
 };
 
 #endif // QT_TRANSACTIONTABLEMODEL_H
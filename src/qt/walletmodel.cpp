@@ -13,6 +13,7 @@
 #include "base58.h"
 #include "checkpoints.h"
 #include "db.h"
+#include "init.h"
 #include "keystore.h"
 #include "main.h"
 #include "ui_interface.h"
@@ -24,35 +25,104 @@
 
 #include <QDebug>
 #include <QSet>
+#include <QThread>
 #include <QTimer>
 
 using namespace std;
 
+WalletModelWorker::WalletModelWorker(CWallet* wallet) : QObject(0), wallet(wallet), fQueued(false)
+{
+    // Moves to the worker thread along with this object
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setInterval(MODEL_UPDATE_DELAY);
+    connect(timer, SIGNAL(timeout()), this, SLOT(update()));
+}
+
+void WalletModelWorker::queueUpdate()
+{
+    if (!fQueued.exchange(true))
+        QMetaObject::invokeMethod(this, "startTimer", Qt::QueuedConnection);
+}
+
+void WalletModelWorker::startTimer()
+{
+    if (!timer->isActive())
+        timer->start();
+}
+
+void WalletModelWorker::update()
+{
+    // Requests arriving from here on need another pass
+    fQueued = false;
+    if (ShutdownRequested())
+        return;
+
+    CAmount balance, unconfirmedBalance, immatureBalance, anonymizedBalance;
+    CAmount watchOnlyBalance = 0, watchUnconfBalance = 0, watchImmatureBalance = 0;
+    uint64_t nMinWeight = 0, nMaxWeight = 0, nWeight = 0;
+    int nNumBlocks;
+    bool fSyncing = IsInitialBlockDownload();
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        nNumBlocks = nBestHeight;
+        balance = wallet->GetBalance();
+        unconfirmedBalance = wallet->GetUnconfirmedBalance();
+        immatureBalance = wallet->GetImmatureBalance();
+        anonymizedBalance = wallet->GetAnonymizedBalance();
+        if (wallet->HaveWatchOnly()) {
+            watchOnlyBalance = wallet->GetWatchOnlyBalance();
+            watchUnconfBalance = wallet->GetUnconfirmedWatchOnlyBalance();
+            watchImmatureBalance = wallet->GetImmatureWatchOnlyBalance();
+        }
+        if (GetBoolArg("-staking", true))
+            wallet->GetStakeWeight(nMinWeight, nMaxWeight, nWeight);
+    }
+
+    emit balancesUpdated(balance, unconfirmedBalance, immatureBalance, anonymizedBalance,
+        watchOnlyBalance, watchUnconfBalance, watchImmatureBalance, nNumBlocks);
+    emit stakingUpdated(nWeight, fSyncing);
+}
+
 WalletModel::WalletModel(CWallet* wallet, OptionsModel* optionsModel, QObject* parent) :
     QObject(parent), wallet(wallet),
     fProcessingQueuedTransactions(false),
     optionsModel(optionsModel), addressTableModel(0), transactionTableModel(0),
     cachedBalance(0), cachedUnconfirmedBalance(0), cachedImmatureBalance(0),
     cachedEncryptionStatus(Unencrypted),
-    cachedNumBlocks(0)
+    cachedNumBlocks(0), cachedTxLocks(0), cachedDarksendRounds(0), cachedStakeWeight(0)
 {
     fHaveWatchOnly = wallet->HaveWatchOnly();
-    fForceCheckBalanceChanged = false;
 
     addressTableModel = new AddressTableModel(wallet, this);
     transactionTableModel = new TransactionTableModel(wallet, this);
 
-    // This timer will be fired repeatedly to update the balance
+    // Balances are computed on a thread of their own and handed back here
+    qRegisterMetaType<CAmount>("CAmount");
+    workerThread = new QThread(this);
+    worker = new WalletModelWorker(wallet);
+    worker->moveToThread(workerThread);
+    connect(worker, SIGNAL(balancesUpdated(CAmount, CAmount, CAmount, CAmount, CAmount, CAmount, CAmount, int)),
+        this, SLOT(updateBalances(CAmount, CAmount, CAmount, CAmount, CAmount, CAmount, CAmount, int)));
+    connect(worker, SIGNAL(stakingUpdated(quint64, bool)), this, SLOT(updateStaking(quint64, bool)));
+    workerThread->start();
+
+    // Darksend rounds and InstantX locks have no notifications; this timer
+    // only compares counters and takes no locks
     pollTimer = new QTimer(this);
     connect(pollTimer, SIGNAL(timeout()), this, SLOT(pollBalanceChanged()));
     pollTimer->start(MODEL_UPDATE_DELAY);
 
     subscribeToCoreSignals();
+    requestBalanceUpdate();
 }
 
 WalletModel::~WalletModel()
 {
     unsubscribeFromCoreSignals();
+    workerThread->quit();
+    workerThread->wait();
+    delete worker;
 }
 
 CAmount WalletModel::getBalance(const CCoinControl* coinControl) const
@@ -117,57 +187,32 @@ void WalletModel::updateStatus()
 
 void WalletModel::pollBalanceChanged()
 {
-    // Get required locks upfront. This avoids the GUI from getting stuck on
-    // periodical polls if the core is holding the locks for a longer time -
-    // for example, during a wallet rescan.
-    TRY_LOCK(cs_main, lockMain);
-    if (!lockMain)
-        return;
-    TRY_LOCK(wallet->cs_wallet, lockWallet);
-    if (!lockWallet)
-        return;
-
-    if (fForceCheckBalanceChanged || nBestHeight != cachedNumBlocks ||
-        nDarksendRounds != cachedDarksendRounds || cachedTxLocks != nCompleteTXLocks)
+    if (nDarksendRounds != cachedDarksendRounds || cachedTxLocks != nCompleteTXLocks)
     {
-        fForceCheckBalanceChanged = false;
-
-        // Balance and number of transactions might have changed
-        cachedNumBlocks = nBestHeight;
         cachedDarksendRounds = nDarksendRounds;
-
-        checkBalanceChanged();
-        if (transactionTableModel)
-            transactionTableModel->updateConfirmations();
+        cachedTxLocks = nCompleteTXLocks;
+        requestBalanceUpdate();
     }
 }
 
-void WalletModel::checkBalanceChanged()
+void WalletModel::updateBalances(const CAmount& newBalance, const CAmount& newUnconfirmedBalance, const CAmount& newImmatureBalance, const CAmount& newAnonymizedBalance,
+    const CAmount& newWatchOnlyBalance, const CAmount& newWatchUnconfBalance, const CAmount& newWatchImmatureBalance, int nNumBlocks)
 {
-    TRY_LOCK(cs_main, lockMain);
-    if (!lockMain) return;
-
-    CAmount newBalance = getBalance();
-    CAmount newUnconfirmedBalance = getUnconfirmedBalance();
-    CAmount newImmatureBalance = getImmatureBalance();
-    CAmount newAnonymizedBalance = getAnonymizedBalance();
-    CAmount newWatchOnlyBalance = 0;
-    CAmount newWatchUnconfBalance = 0;
-    CAmount newWatchImmatureBalance = 0;
-    if (haveWatchOnly()) {
-        newWatchOnlyBalance = getWatchBalance();
-        newWatchUnconfBalance = getWatchUnconfirmedBalance();
-        newWatchImmatureBalance = getWatchImmatureBalance();
+    if (nNumBlocks != cachedNumBlocks)
+    {
+        // Number of confirmations might have changed
+        cachedNumBlocks = nNumBlocks;
+        if (transactionTableModel)
+            transactionTableModel->updateConfirmations();
     }
 
     if (cachedBalance != newBalance || cachedUnconfirmedBalance != newUnconfirmedBalance || cachedImmatureBalance != newImmatureBalance || cachedAnonymizedBalance != newAnonymizedBalance ||
-        cachedTxLocks != nCompleteTXLocks || cachedWatchOnlyBalance != newWatchOnlyBalance || cachedWatchUnconfBalance != newWatchUnconfBalance || cachedWatchImmatureBalance != newWatchImmatureBalance)
+        cachedWatchOnlyBalance != newWatchOnlyBalance || cachedWatchUnconfBalance != newWatchUnconfBalance || cachedWatchImmatureBalance != newWatchImmatureBalance)
     {
         cachedBalance = newBalance;
         cachedUnconfirmedBalance = newUnconfirmedBalance;
         cachedImmatureBalance = newImmatureBalance;
         cachedAnonymizedBalance = newAnonymizedBalance;
-        cachedTxLocks = nCompleteTXLocks;
         cachedWatchOnlyBalance = newWatchOnlyBalance;
         cachedWatchUnconfBalance = newWatchUnconfBalance;
         cachedWatchImmatureBalance = newWatchImmatureBalance;
@@ -176,10 +221,16 @@ void WalletModel::checkBalanceChanged()
     }
 }
 
+void WalletModel::updateStaking(quint64 nWeight, bool fSyncing)
+{
+    cachedStakeWeight = nWeight;
+    emit stakingChanged(nWeight, fSyncing);
+}
+
 void WalletModel::updateTransaction()
 {
     // Balance and number of transactions might have changed
-    fForceCheckBalanceChanged = true;
+    requestBalanceUpdate();
 }
 
 void WalletModel::updateAddressBook(const QString& address, const QString& label, bool isMine, int status)
@@ -357,7 +408,7 @@ WalletModel::SendCoinsReturn WalletModel::sendCoins(WalletModelTransaction& tran
         }
         emit coinsSent(wallet, rcp, transaction_array);
     }
-    checkBalanceChanged(); // update balance immediately, otherwise there could be a short noticeable delay until pollBalanceChanged hits
+    requestBalanceUpdate();
 
     return SendCoinsReturn(OK);
 }
@@ -503,6 +554,12 @@ static void ShowProgress(WalletModel* walletmodel, const std::string& title, int
     }
 }
 
+static void NotifyBlockTip(WalletModel* walletmodel, int nHeight, int64_t nTime)
+{
+    // Maturity, confirmations and staking weight move with the chain
+    walletmodel->requestBalanceUpdate();
+}
+
 static void NotifyWatchonlyChanged(WalletModel* walletmodel, bool fHaveWatchonly)
 {
     QMetaObject::invokeMethod(walletmodel, "updateWatchOnlyFlag", Qt::QueuedConnection,
@@ -517,6 +574,7 @@ void WalletModel::subscribeToCoreSignals()
     wallet->NotifyTransactionChanged.connect(boost::bind(NotifyTransactionChanged, this, _1, _2, _3));
     wallet->ShowProgress.connect(boost::bind(ShowProgress, this, _1, _2));
     wallet->NotifyWatchonlyChanged.connect(boost::bind(NotifyWatchonlyChanged, this, _1));
+    uiInterface.NotifyBlockTip.connect(boost::bind(NotifyBlockTip, this, _1, _2));
 }
 
 void WalletModel::unsubscribeFromCoreSignals()
@@ -527,6 +585,7 @@ void WalletModel::unsubscribeFromCoreSignals()
     wallet->NotifyTransactionChanged.disconnect(boost::bind(NotifyTransactionChanged, this, _1, _2, _3));
     wallet->ShowProgress.disconnect(boost::bind(ShowProgress, this, _1, _2));
     wallet->NotifyWatchonlyChanged.disconnect(boost::bind(NotifyWatchonlyChanged, this, _1));
+    uiInterface.NotifyBlockTip.disconnect(boost::bind(NotifyBlockTip, this, _1, _2));
 }
 
 // WalletModel::UnlockContext implementation
@@ -11,6 +11,7 @@
 #include "instantx.h"
 #include "wallet.h"
 
+#include <atomic>
 #include <map>
 #include <vector>
 
@@ -30,9 +31,40 @@ class uint256;
 class CCoinControl;
 
 QT_BEGIN_NAMESPACE
+class QThread;
 class QTimer;
 QT_END_NAMESPACE
 
+/** Computes the wallet's balances and staking weight on a background thread.
+ *  Requests made within MODEL_UPDATE_DELAY of each other are served by one
+ *  pass, which waits for the core locks rather than competing for them on the
+ *  GUI thread.
+ */
+class WalletModelWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WalletModelWorker(CWallet* wallet);
+
+    /** Ask for an update; safe to call from any thread */
+    void queueUpdate();
+
+private:
+    CWallet* wallet;
+    QTimer* timer;
+    std::atomic<bool> fQueued;
+
+private slots:
+    void startTimer();
+    void update();
+
+signals:
+    void balancesUpdated(const CAmount& balance, const CAmount& unconfirmedBalance, const CAmount& immatureBalance, const CAmount& anonymizedBalance,
+        const CAmount& watchOnlyBalance, const CAmount& watchUnconfBalance, const CAmount& watchImmatureBalance, int nNumBlocks);
+    void stakingUpdated(quint64 nWeight, bool fSyncing);
+};
+
 class SendCoinsRecipient
 {
 public:
@@ -199,10 +231,12 @@ public:
     void listLockedCoins(std::vector<COutPoint>& vOutpts);
     bool processingQueuedTransactions() { return fProcessingQueuedTransactions; }
 
+    /** Recompute balances and staking weight in the background; safe to call from any thread */
+    void requestBalanceUpdate() { worker->queueUpdate(); }
+
 private:
     CWallet *wallet;
     bool fHaveWatchOnly;
-    bool fForceCheckBalanceChanged;
     bool fProcessingQueuedTransactions;
 
     // Wallet has an options model for wallet-specific options
@@ -224,12 +258,14 @@ private:
     int cachedNumBlocks;
     int cachedTxLocks;
     int cachedDarksendRounds;
+    quint64 cachedStakeWeight;
 
     QTimer* pollTimer;
+    QThread* workerThread;
+    WalletModelWorker* worker;
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
-    void checkBalanceChanged();
 
 signals:
     // Signal that balance in wallet changed
@@ -255,6 +291,9 @@ signals:
     // Watch-only address added
     void notifyWatchonlyChanged(bool fHaveWatchonly);
 
+    // Staking weight recomputed
+    void stakingChanged(quint64 nWeight, bool fSyncing);
+
 public slots:
     /* Wallet status might have changed */
     void updateStatus();
@@ -264,8 +303,12 @@ public slots:
     void updateAddressBook(const QString &address, const QString &label, bool isMine, int status);
     /* Watch-only added */
     void updateWatchOnlyFlag(bool fHaveWatchonly);
-    /* Current, immature or unconfirmed balance might have changed - emit 'balanceChanged' if so */
+    /* Darksend rounds or InstantX locks might have changed - queue a balance update if so */
     void pollBalanceChanged();
+    /* Balances computed by the worker - emit 'balanceChanged' if they changed */
+    void updateBalances(const CAmount& balance, const CAmount& unconfirmedBalance, const CAmount& immatureBalance, const CAmount& anonymizedBalance,
+        const CAmount& watchOnlyBalance, const CAmount& watchUnconfBalance, const CAmount& watchImmatureBalance, int nNumBlocks);
+    void updateStaking(quint64 nWeight, bool fSyncing);
     /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
     void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
 
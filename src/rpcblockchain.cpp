@@ -7,6 +7,8 @@
 #include "main.h"
 #include "kernel.h"
 #include "checkpoints.h"
+#include "rpcjson.h"
+#include "txdb.h"
 
 using namespace json_spirit;
 using namespace std;
@@ -71,37 +73,37 @@ double GetPoWMHashPS()
     return GetDifficulty() * 4294.967296 / nTargetSpacingWork;
 }
 
-Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool fPrintTransactionDetail)
+void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool fPrintTransactionDetail, CJSONWriter& writer)
 {
-    Object result;
-    result.push_back(Pair("hash", block.GetHash().GetHex()));
+    writer.BeginObject();
+    writer.Key("hash").String(block.GetHash().GetHex());
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (blockindex->IsInMainChain())
         confirmations = nBestHeight - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    result.push_back(Pair("mint", ValueFromAmount(blockindex->nMint)));
-    result.push_back(Pair("time", (int64_t)block.GetBlockTime()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("blocktrust", leftTrim(blockindex->GetBlockTrust().GetHex(), '0')));
-    result.push_back(Pair("chaintrust", leftTrim(blockindex->nChainTrust.GetHex(), '0')));
+    writer.Key("confirmations").Int(confirmations);
+    writer.Key("size").Int(::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    writer.Key("height").Int(blockindex->nHeight);
+    writer.Key("version").Int(block.nVersion);
+    writer.Key("merkleroot").String(block.hashMerkleRoot.GetHex());
+    writer.Key("mint").Value(ValueFromAmount(blockindex->nMint));
+    writer.Key("time").Int(block.GetBlockTime());
+    writer.Key("nonce").UInt64(block.nNonce);
+    writer.Key("bits").String(strprintf("%08x", block.nBits));
+    writer.Key("difficulty").Real(GetDifficulty(blockindex));
+    writer.Key("blocktrust").String(leftTrim(blockindex->GetBlockTrust().GetHex(), '0'));
+    writer.Key("chaintrust").String(leftTrim(blockindex->nChainTrust.GetHex(), '0'));
     if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+        writer.Key("previousblockhash").String(blockindex->pprev->GetBlockHash().GetHex());
     if (blockindex->pnext)
-        result.push_back(Pair("nextblockhash", blockindex->pnext->GetBlockHash().GetHex()));
-
-    result.push_back(Pair("flags", strprintf("%s%s", blockindex->IsProofOfStake()? "proof-of-stake" : "proof-of-work", blockindex->GeneratedStakeModifier()? " stake-modifier": "")));
-    result.push_back(Pair("proofhash", blockindex->IsProofOfStake()? blockindex->hashProof.GetHex() : blockindex->GetBlockHash().GetHex()));
-    result.push_back(Pair("entropybit", (int)blockindex->GetStakeEntropyBit()));
-    result.push_back(Pair("modifier", strprintf("%016x", blockindex->nStakeModifier)));
-    result.push_back(Pair("modifierchecksum", strprintf("%016x", blockindex->nStakeModifierChecksum)));
-    Array txinfo;
+        writer.Key("nextblockhash").String(blockindex->pnext->GetBlockHash().GetHex());
+
+    writer.Key("flags").String(strprintf("%s%s", blockindex->IsProofOfStake()? "proof-of-stake" : "proof-of-work", blockindex->GeneratedStakeModifier()? " stake-modifier": ""));
+    writer.Key("proofhash").String(blockindex->IsProofOfStake()? blockindex->hashProof.GetHex() : blockindex->GetBlockHash().GetHex());
+    writer.Key("entropybit").Int(blockindex->GetStakeEntropyBit());
+    writer.Key("modifier").String(strprintf("%016x", blockindex->nStakeModifier));
+    writer.Key("modifierchecksum").String(strprintf("%016x", blockindex->nStakeModifierChecksum));
+    writer.Key("tx").BeginArray();
     BOOST_FOREACH (const CTransaction& tx, block.vtx)
     {
         if (fPrintTransactionDetail)
@@ -111,18 +113,17 @@ Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool fPri
             entry.push_back(Pair("txid", tx.GetHash().GetHex()));
             TxToJSON(tx, 0, entry);
 
-            txinfo.push_back(entry);
+            writer.Value(entry);
         }
         else
-            txinfo.push_back(tx.GetHash().GetHex());
+            writer.String(tx.GetHash().GetHex());
     }
-
-    result.push_back(Pair("tx", txinfo));
+    writer.EndArray();
 
     if (block.IsProofOfStake())
-        result.push_back(Pair("signature", HexStr(block.vchBlockSig.begin(), block.vchBlockSig.end())));
+        writer.Key("signature").String(HexStr(block.vchBlockSig.begin(), block.vchBlockSig.end()));
 
-    return result;
+    writer.EndObject();
 }
 
 Value getbestblockhash(const Array& params, bool fHelp)
@@ -132,7 +133,7 @@ Value getbestblockhash(const Array& params, bool fHelp)
             "getbestblockhash\n"
             "Returns the hash of the best block in the longest block chain.");
 
-    return hashBestChain.GetHex();
+    return GetChainSnapshot()->hashTip.GetHex();
 }
 
 Value getblockcount(const Array& params, bool fHelp)
@@ -142,7 +143,7 @@ Value getblockcount(const Array& params, bool fHelp)
             "getblockcount\n"
             "Returns the number of blocks in the longest block chain.");
 
-    return nBestHeight;
+    return GetChainSnapshot()->nHeight;
 }
 
 
@@ -156,11 +157,14 @@ Value getdifficulty(const Array& params, bool fHelp)
     //Object obj;
     //obj.push_back(Pair("proof-of-work",        GetDifficulty()));
     //obj.push_back(Pair("proof-of-stake",       GetDifficulty(GetLastBlockIndex(pindexBest, true))));
-    return GetDifficulty(GetLastBlockIndex(pindexBest, true));
+    std::shared_ptr<const CChainSnapshot> snapshot = GetChainSnapshot();
+    if (!snapshot->pindexTip)
+        return 1.0;
+    return GetDifficulty(snapshot->pindexLastPoS);
 }
 
 
-Value getrawmempool(const Array& params, bool fHelp)
+void getrawmempool_writer(const Array& params, bool fHelp, CJSONWriter& writer)
 {
     if (fHelp || params.size() != 0)
         throw runtime_error(
@@ -170,11 +174,16 @@ Value getrawmempool(const Array& params, bool fHelp)
     vector<uint256> vtxid;
     mempool.queryHashes(vtxid);
 
-    Array a;
+    writer.Reserve(writer.str().size() + vtxid.size() * 67 + 2);
+    writer.BeginArray();
     BOOST_FOREACH(const uint256& hash, vtxid)
-        a.push_back(hash.ToString());
+        writer.String(hash.ToString());
+    writer.EndArray();
+}
 
-    return a;
+Value getrawmempool(const Array& params, bool fHelp)
+{
+    return RPCValueFromWriter(getrawmempool_writer, params, fHelp);
 }
 
 Value getblockhash(const Array& params, bool fHelp)
@@ -185,6 +194,8 @@ Value getblockhash(const Array& params, bool fHelp)
             "Returns hash of block in best-block-chain at <index>.");
 
     int nHeight = params[0].get_int();
+
+    LOCK(cs_main);
     if (nHeight < 0 || nHeight > nBestHeight)
         throw runtime_error("Block number out of range.");
 
@@ -192,7 +203,7 @@ Value getblockhash(const Array& params, bool fHelp)
     return pblockindex->phashBlock->GetHex();
 }
 
-Value getblock(const Array& params, bool fHelp)
+void getblock_writer(const Array& params, bool fHelp, CJSONWriter& writer)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
@@ -203,6 +214,7 @@ Value getblock(const Array& params, bool fHelp)
     std::string strHash = params[0].get_str();
     uint256 hash(strHash);
 
+    LOCK(cs_main);
     if (mapBlockIndex.count(hash) == 0)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
@@ -210,10 +222,15 @@ Value getblock(const Array& params, bool fHelp)
     CBlockIndex* pblockindex = mapBlockIndex[hash];
     block.ReadFromDisk(pblockindex, true);
 
-    return blockToJSON(block, pblockindex, params.size() > 1 ? params[1].get_bool() : false);
+    blockToJSON(block, pblockindex, params.size() > 1 ? params[1].get_bool() : false, writer);
 }
 
-Value getblockbynumber(const Array& params, bool fHelp)
+Value getblock(const Array& params, bool fHelp)
+{
+    return RPCValueFromWriter(getblock_writer, params, fHelp);
+}
+
+void getblockbynumber_writer(const Array& params, bool fHelp, CJSONWriter& writer)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
@@ -235,7 +252,12 @@ Value getblockbynumber(const Array& params, bool fHelp)
     pblockindex = mapBlockIndex[hash];
     block.ReadFromDisk(pblockindex, true);
 
-    return blockToJSON(block, pblockindex, params.size() > 1 ? params[1].get_bool() : false);
+    blockToJSON(block, pblockindex, params.size() > 1 ? params[1].get_bool() : false, writer);
+}
+
+Value getblockbynumber(const Array& params, bool fHelp)
+{
+    return RPCValueFromWriter(getblockbynumber_writer, params, fHelp);
 }
 
 // ppcoin: get information of sync-checkpoint
@@ -257,3 +279,73 @@ Value getcheckpoint(const Array& params, bool fHelp)
 
     return result;
 }
+
+Value getdbstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getdbstats [sstables=false]\n"
+            "Returns statistics of the block index database: the tuning it was opened with,\n"
+            "files per level, approximate on-disk size per key type, block cache hit rate\n"
+            "and LevelDB's compaction statistics. With sstables=true the list of table\n"
+            "files is included.");
+
+    bool fSSTables = params.size() > 0 && params[0].get_bool();
+
+    CTxDB txdb("r");
+    Object result;
+
+    const CDBTuning& tuning = GetDBTuning();
+    Object options;
+    options.push_back(Pair("profile", tuning.pszProfile));
+    options.push_back(Pair("cache_mb", tuning.nCacheMB));
+    options.push_back(Pair("write_buffer_mb", tuning.nWriteBufferMB));
+    options.push_back(Pair("max_open_files", tuning.nMaxOpenFiles));
+    options.push_back(Pair("block_size_kb", tuning.nBlockSizeKB));
+    options.push_back(Pair("file_size_mb", tuning.nFileSizeMB));
+    options.push_back(Pair("l0_compaction_trigger", tuning.nL0CompactionTrigger));
+    options.push_back(Pair("l0_slowdown_trigger", tuning.nL0SlowdownTrigger));
+    options.push_back(Pair("l0_stop_trigger", tuning.nL0StopTrigger));
+    options.push_back(Pair("compression", tuning.fCompression));
+    options.push_back(Pair("sync", tuning.fSync));
+    result.push_back(Pair("options", options));
+
+    Array levels;
+    for (int nLevel = 0; ; nLevel++)
+    {
+        string strFiles;
+        if (!txdb.GetProperty(strprintf("leveldb.num-files-at-level%d", nLevel), strFiles))
+            break;
+        levels.push_back(atoi(strFiles));
+    }
+    result.push_back(Pair("files_per_level", levels));
+
+    Object sizes;
+    const char* pszPrefixes[] = { "tx", "blockindex", "adr" };
+    BOOST_FOREACH(const char* pszPrefix, pszPrefixes)
+        sizes.push_back(Pair(pszPrefix, txdb.GetApproximateSize(pszPrefix)));
+    result.push_back(Pair("approximate_sizes", sizes));
+
+    uint64_t nLookups, nHits, nCapacity;
+    if (GetDBCacheStats(nLookups, nHits, nCapacity))
+    {
+        Object cache;
+        cache.push_back(Pair("capacity", nCapacity));
+        cache.push_back(Pair("lookups", nLookups));
+        cache.push_back(Pair("hits", nHits));
+        cache.push_back(Pair("hit_rate", nLookups ? (double)nHits / nLookups : 0.0));
+        result.push_back(Pair("block_cache", cache));
+    }
+
+    string strStats;
+    if (txdb.GetProperty("leveldb.stats", strStats))
+        result.push_back(Pair("stats", strStats));
+    if (fSSTables)
+    {
+        string strSSTables;
+        if (txdb.GetProperty("leveldb.sstables", strSSTables))
+            result.push_back(Pair("sstables", strSSTables));
+    }
+
+    return result;
+}
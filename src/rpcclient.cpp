@@ -6,6 +6,7 @@
 #include <set>
 #include "rpcclient.h"
 
+#include "rpcjson.h"
 #include "rpcprotocol.h"
 #include "util.h"
 #include "ui_interface.h"
@@ -86,7 +87,7 @@ Object CallRPC(const string& strMethod, const Array& params)
 
     // Parse reply
     Value valReply;
-    if (!read_string(strReply, valReply))
+    if (!JSONRead(strReply, valReply))
         throw runtime_error("couldn't parse reply from server");
     const Object& reply = valReply.get_obj();
     if (reply.empty())
@@ -121,6 +122,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblock", 1 },
     { "getblockbynumber", 0 },
     { "getblockbynumber", 1 },
+    { "getdbstats", 0 },
     { "getblockhash", 0 },
     { "cclistcoins", 0 },
     { "move", 2 },
@@ -137,6 +139,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblocktemplate", 0 },
     { "listsinceblock", 1 },
     { "listsinceblock", 2 },
+    { "listsinceblock", 3 },
     { "sendalert", 2 },
     { "sendalert", 3 },
     { "sendalert", 4 },
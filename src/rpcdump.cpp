@@ -152,7 +152,8 @@ Value importprivkey(const Array& params, bool fHelp)
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
 
         if (fRescan) {
-            pwalletMain->ScanForWalletTransactions(pindexGenesisBlock, true);
+            if (pwalletMain->ScanForWalletTransactions(pindexGenesisBlock, true) < 0)
+                throw JSONRPCError(RPC_WALLET_ERROR, "Key added, but another wallet rescan is running; rescan later");
             pwalletMain->ReacceptWalletTransactions();
         }
     }
@@ -220,7 +221,8 @@ Value importaddress(const Array& params, bool fHelp)
 
         if (fRescan)
         {
-            pwalletMain->ScanForWalletTransactions(pindexGenesisBlock, true);
+            if (pwalletMain->ScanForWalletTransactions(pindexGenesisBlock, true) < 0)
+                throw JSONRPCError(RPC_WALLET_ERROR, "Address added, but another wallet rescan is running; rescan later");
             pwalletMain->ReacceptWalletTransactions();
         }
     }
@@ -247,6 +249,13 @@ Value importwallet(const Array& params, bool fHelp)
     int64_t nFilesize = std::max((int64_t)1, (int64_t)file.tellg());
     bool fGood = true;
 
+    // Write all imported keys and labels in one database transaction. The
+    // batch handle is shared wallet state, so cs_wallet stays held until the
+    // batch is committed and no other thread writes through it.
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+    CWalletBatch batch(pwalletMain, walletdb);
+
     pwalletMain->ShowProgress(_("Importing..."), 0); // show progress dialog in GUI
     while (file.good()) {
         pwalletMain->ShowProgress("", std::max(1, std::min(99, (int)(((double)file.tellg() / (double)nFilesize) * 100))));
@@ -296,6 +305,8 @@ Value importwallet(const Array& params, bool fHelp)
         nTimeBegin = std::min(nTimeBegin, nTime);
     }
     file.close();
+    if (!batch.Commit())
+        fGood = false;
     pwalletMain->ShowProgress("", 100); // hide progress dialog in GUI
 
     CBlockIndex *pindex = pindexBest;
@@ -306,7 +317,8 @@ Value importwallet(const Array& params, bool fHelp)
         pwalletMain->nTimeFirstKey = nTimeBegin;
 
     LogPrintf("Rescanning last %i blocks\n", pindexBest->nHeight - pindex->nHeight + 1);
-    pwalletMain->ScanForWalletTransactions(pindex);
+    if (pwalletMain->ScanForWalletTransactions(pindex) < 0)
+        throw JSONRPCError(RPC_WALLET_ERROR, "Keys imported, but another wallet rescan is running; rescan later");
     pwalletMain->ReacceptWalletTransactions();
     pwalletMain->MarkDirty();
 
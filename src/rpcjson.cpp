@@ -0,0 +1,546 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpcjson.h"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <locale>
+#include <sstream>
+
+#include <string.h>
+
+using namespace std;
+using namespace json_spirit;
+
+/** Nesting deeper than this is refused rather than risking the stack */
+static const int JSON_MAX_DEPTH = 512;
+
+static void AppendUInt(string& str, uint64_t n)
+{
+    char buf[20];
+    char* p = buf + sizeof(buf);
+    do {
+        *--p = '0' + (n % 10);
+        n /= 10;
+    } while (n);
+    str.append(p, buf + sizeof(buf) - p);
+}
+
+static void AppendInt(string& str, int64_t n)
+{
+    if (n < 0) {
+        str += '-';
+        AppendUInt(str, 0 - (uint64_t)n);
+    } else
+        AppendUInt(str, n);
+}
+
+static void AppendReal(string& str, double d)
+{
+    // Reals are written fixed with 8 decimals. Values in the range of coin
+    // amounts can be rounded in integers: below 2^50 the scaled value is
+    // within 1/16 of the exact product, so unless it is near a tie the
+    // rounding is the same as printf's.
+    if (d > -1e7 && d < 1e7) {
+        double dScaled = fabs(d) * 1e8;
+        double dRound = floor(dScaled + 0.5);
+        if (fabs(dScaled - dRound) < 0.4) {
+            uint64_t n = (uint64_t)dRound;
+            if (std::signbit(d))
+                str += '-';
+            AppendUInt(str, n / 100000000);
+            char buf[9];
+            uint64_t nFrac = n % 100000000;
+            for (int i = 8; i > 0; i--) {
+                buf[i] = '0' + (nFrac % 10);
+                nFrac /= 10;
+            }
+            buf[0] = '.';
+            str.append(buf, sizeof(buf));
+            return;
+        }
+    }
+    ostringstream os;
+    os.imbue(locale::classic());
+    os << showpoint << fixed << setprecision(8) << d;
+    str += os.str();
+}
+
+static void AppendString(string& str, const string& s)
+{
+    static const char* pszHex = "0123456789ABCDEF";
+    str += '"';
+    const char* p = s.data();
+    const char* pend = p + s.size();
+    const char* pcopy = p;
+    for (; p < pend; p++) {
+        unsigned char c = *p;
+        if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\')
+            continue;
+        str.append(pcopy, p - pcopy);
+        pcopy = p + 1;
+        switch (c) {
+        case '"':  str += "\\\""; break;
+        case '\\': str += "\\\\"; break;
+        case '\b': str += "\\b"; break;
+        case '\f': str += "\\f"; break;
+        case '\n': str += "\\n"; break;
+        case '\r': str += "\\r"; break;
+        case '\t': str += "\\t"; break;
+        default:
+            // Like json_spirit, bytes that are not printable ASCII go out
+            // as \u00XX
+            str += "\\u00";
+            str += pszHex[c >> 4];
+            str += pszHex[c & 0xf];
+        }
+    }
+    str.append(pcopy, pend - pcopy);
+    str += '"';
+}
+
+void JSONAppend(string& str, const Value& value)
+{
+    switch (value.type()) {
+    case obj_type: {
+        const Object& obj = value.get_obj();
+        str += '{';
+        for (Object::const_iterator it = obj.begin(); it != obj.end(); ++it) {
+            if (it != obj.begin())
+                str += ',';
+            AppendString(str, it->name_);
+            str += ':';
+            JSONAppend(str, it->value_);
+        }
+        str += '}';
+        break;
+    }
+    case array_type: {
+        const Array& arr = value.get_array();
+        str += '[';
+        for (Array::const_iterator it = arr.begin(); it != arr.end(); ++it) {
+            if (it != arr.begin())
+                str += ',';
+            JSONAppend(str, *it);
+        }
+        str += ']';
+        break;
+    }
+    case str_type:
+        AppendString(str, value.get_str());
+        break;
+    case bool_type:
+        str += value.get_bool() ? "true" : "false";
+        break;
+    case int_type:
+        if (value.is_uint64())
+            AppendUInt(str, value.get_uint64());
+        else
+            AppendInt(str, value.get_int64());
+        break;
+    case real_type:
+        AppendReal(str, value.get_real());
+        break;
+    case null_type:
+        str += "null";
+        break;
+    }
+}
+
+string JSONWrite(const Value& value)
+{
+    string str;
+    JSONAppend(str, value);
+    return str;
+}
+
+namespace {
+
+class CJSONReader
+{
+private:
+    const char* p;
+    const char* pend;
+    int nDepth;
+
+    static int HexNum(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return 0;
+    }
+
+    static bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+    }
+
+    static bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    void SkipSpace()
+    {
+        while (p < pend && IsSpace(*p))
+            p++;
+    }
+
+    bool Match(const char* psz, size_t nLen)
+    {
+        if ((size_t)(pend - p) < nLen || memcmp(p, psz, nLen) != 0)
+            return false;
+        p += nLen;
+        return true;
+    }
+
+    bool ParseString(string& str)
+    {
+        // p is at the opening quote. Escapes are decoded as json_spirit does:
+        // \uXXXX and \xXX keep only the low byte, unknown escapes are dropped.
+        const char* pbegin = ++p;
+        while (p < pend && *p != '"') {
+            if (*p == '\\' && p + 1 < pend)
+                p++;
+            p++;
+        }
+        if (p >= pend)
+            return false;
+        const char* pcontent = pbegin;
+        const char* pcontentEnd = p++;
+
+        str.reserve(pcontentEnd - pcontent);
+        const char* pcopy = pcontent;
+        for (const char* i = pcontent; i < pcontentEnd - 1; i++) {
+            if (*i != '\\')
+                continue;
+            str.append(pcopy, i - pcopy);
+            i++;
+            switch (*i) {
+            case 't':  str += '\t'; break;
+            case 'b':  str += '\b'; break;
+            case 'f':  str += '\f'; break;
+            case 'n':  str += '\n'; break;
+            case 'r':  str += '\r'; break;
+            case '\\': str += '\\'; break;
+            case '/':  str += '/'; break;
+            case '"':  str += '"'; break;
+            case 'x':
+                if (pcontentEnd - i >= 3) {
+                    str += (char)((HexNum(i[1]) << 4) + HexNum(i[2]));
+                    i += 2;
+                }
+                break;
+            case 'u':
+                if (pcontentEnd - i >= 5) {
+                    str += (char)((HexNum(i[3]) << 4) + HexNum(i[4]));
+                    i += 4;
+                }
+                break;
+            }
+            pcopy = i + 1;
+        }
+        if (pcopy < pcontentEnd)
+            str.append(pcopy, pcontentEnd - pcopy);
+        return true;
+    }
+
+    bool ParseNumber(Value& value)
+    {
+        const char* pstart = p;
+        bool fNegative = false;
+        if (*p == '+' || *p == '-')
+            fNegative = (*p++ == '-');
+        const char* pdigits = p;
+        while (p < pend && IsDigit(*p))
+            p++;
+        const char* pdigitsEnd = p;
+        bool fReal = false;
+        bool fFracDigits = false;
+        if (p < pend && *p == '.') {
+            fReal = true;
+            p++;
+            while (p < pend && IsDigit(*p)) {
+                p++;
+                fFracDigits = true;
+            }
+        }
+        if (pdigits == pdigitsEnd && !fFracDigits)
+            return false;
+        if (p < pend && (*p == 'e' || *p == 'E')) {
+            const char* pexp = p++;
+            if (p < pend && (*p == '+' || *p == '-'))
+                p++;
+            if (p < pend && IsDigit(*p)) {
+                fReal = true;
+                while (p < pend && IsDigit(*p))
+                    p++;
+            } else
+                p = pexp;
+        }
+
+        if (fReal) {
+            istringstream is(string(pstart, p));
+            is.imbue(locale::classic());
+            double d;
+            if (!(is >> d))
+                return false;
+            value = d;
+            return true;
+        }
+
+        uint64_t n = 0;
+        for (const char* i = pdigits; i < pdigitsEnd; i++) {
+            if (n > (std::numeric_limits<uint64_t>::max() - (*i - '0')) / 10)
+                return false;
+            n = n * 10 + (*i - '0');
+        }
+        if (fNegative) {
+            if (n > (uint64_t)std::numeric_limits<int64_t>::max() + 1)
+                return false;
+            value = (int64_t)(0 - n);
+        } else if (n <= (uint64_t)std::numeric_limits<int64_t>::max())
+            value = (int64_t)n;
+        else
+            value = n;
+        return true;
+    }
+
+    bool ParseValue(Value& value)
+    {
+        SkipSpace();
+        if (p >= pend)
+            return false;
+        switch (*p) {
+        case '{': {
+            if (++nDepth > JSON_MAX_DEPTH)
+                return false;
+            p++;
+            value = Object();
+            Object& obj = value.get_obj();
+            SkipSpace();
+            if (p < pend && *p == '}') {
+                p++;
+                nDepth--;
+                return true;
+            }
+            while (true) {
+                SkipSpace();
+                if (p >= pend || *p != '"')
+                    return false;
+                obj.push_back(Pair(string(), Value::null));
+                if (!ParseString(obj.back().name_))
+                    return false;
+                SkipSpace();
+                if (p >= pend || *p++ != ':')
+                    return false;
+                if (!ParseValue(obj.back().value_))
+                    return false;
+                SkipSpace();
+                if (p >= pend)
+                    return false;
+                if (*p == '}')
+                    break;
+                if (*p++ != ',')
+                    return false;
+            }
+            p++;
+            nDepth--;
+            return true;
+        }
+        case '[': {
+            if (++nDepth > JSON_MAX_DEPTH)
+                return false;
+            p++;
+            value = Array();
+            Array& arr = value.get_array();
+            SkipSpace();
+            if (p < pend && *p == ']') {
+                p++;
+                nDepth--;
+                return true;
+            }
+            while (true) {
+                arr.push_back(Value::null);
+                if (!ParseValue(arr.back()))
+                    return false;
+                SkipSpace();
+                if (p >= pend)
+                    return false;
+                if (*p == ']')
+                    break;
+                if (*p++ != ',')
+                    return false;
+            }
+            p++;
+            nDepth--;
+            return true;
+        }
+        case '"': {
+            string str;
+            if (!ParseString(str))
+                return false;
+            value = str;
+            return true;
+        }
+        case 't':
+            if (!Match("true", 4))
+                return false;
+            value = true;
+            return true;
+        case 'f':
+            if (!Match("false", 5))
+                return false;
+            value = false;
+            return true;
+        case 'n':
+            if (!Match("null", 4))
+                return false;
+            value = Value::null;
+            return true;
+        default:
+            return ParseNumber(value);
+        }
+    }
+
+public:
+    CJSONReader(const string& str) : p(str.data()), pend(str.data() + str.size()), nDepth(0) {}
+
+    bool Read(Value& value)
+    {
+        // Like json_spirit, anything after the first value is ignored
+        return ParseValue(value);
+    }
+};
+
+}
+
+bool JSONRead(const string& str, Value& value)
+{
+    CJSONReader reader(str);
+    return reader.Read(value);
+}
+
+void CJSONWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vEmpty.empty()) {
+        if (!vEmpty.back())
+            strOut += ',';
+        vEmpty.back() = false;
+    }
+}
+
+CJSONWriter& CJSONWriter::BeginObject()
+{
+    Separate();
+    strOut += '{';
+    vEmpty.push_back(true);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::EndObject()
+{
+    strOut += '}';
+    vEmpty.pop_back();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::BeginArray()
+{
+    Separate();
+    strOut += '[';
+    vEmpty.push_back(true);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::EndArray()
+{
+    strOut += ']';
+    vEmpty.pop_back();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Key(const char* pszKey)
+{
+    return Key(string(pszKey));
+}
+
+CJSONWriter& CJSONWriter::Key(const string& strKey)
+{
+    Separate();
+    AppendString(strOut, strKey);
+    strOut += ':';
+    fAfterKey = true;
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::String(const string& str)
+{
+    Separate();
+    AppendString(strOut, str);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Int(int64_t n)
+{
+    Separate();
+    AppendInt(strOut, n);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::UInt64(uint64_t n)
+{
+    Separate();
+    AppendUInt(strOut, n);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Real(double d)
+{
+    Separate();
+    AppendReal(strOut, d);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Bool(bool f)
+{
+    Separate();
+    strOut += f ? "true" : "false";
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Null()
+{
+    Separate();
+    strOut += "null";
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Value(const json_spirit::Value& value)
+{
+    Separate();
+    JSONAppend(strOut, value);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Raw(const string& strJSON)
+{
+    Separate();
+    strOut += strJSON;
+    return *this;
+}
+
+void CJSONWriter::Clear()
+{
+    strOut.clear();
+    vEmpty.clear();
+    fAfterKey = false;
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_RPCJSON_H
+#define BITCOIN_RPCJSON_H
+
+#include "json/json_spirit_value.h"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+/** Append the compact JSON text of value to str. The output is the same as
+ *  json_spirit::write_string(value, false), without the stream and the
+ *  temporary strings it builds for every element. */
+void JSONAppend(std::string& str, const json_spirit::Value& value);
+std::string JSONWrite(const json_spirit::Value& value);
+
+/** Parse JSON text into value with a recursive-descent parser. Accepts what
+ *  json_spirit::read_string accepts and builds the same Value, constructing
+ *  members and elements in place. */
+bool JSONRead(const std::string& str, json_spirit::Value& value);
+
+/** Builds JSON text directly, for replies too large to be worth building as
+ *  a Value tree first. Commas and key quoting are handled by the writer:
+ *
+ *    writer.BeginObject().Key("hash").String(strHash).Key("tx").BeginArray();
+ *    ...
+ *    writer.EndArray().EndObject();
+ */
+class CJSONWriter
+{
+private:
+    std::string strOut;
+    // Per open object or array: whether it has no members yet
+    std::vector<bool> vEmpty;
+    bool fAfterKey;
+
+    void Separate();
+
+public:
+    CJSONWriter() : fAfterKey(false) {}
+
+    CJSONWriter& BeginObject();
+    CJSONWriter& EndObject();
+    CJSONWriter& BeginArray();
+    CJSONWriter& EndArray();
+    CJSONWriter& Key(const char* pszKey);
+    CJSONWriter& Key(const std::string& strKey);
+
+    CJSONWriter& String(const std::string& str);
+    CJSONWriter& Int(int64_t n);
+    CJSONWriter& UInt64(uint64_t n);
+    CJSONWriter& Real(double d);
+    CJSONWriter& Bool(bool f);
+    CJSONWriter& Null();
+    CJSONWriter& Value(const json_spirit::Value& value);
+    /** Splice in text that is already valid JSON */
+    CJSONWriter& Raw(const std::string& strJSON);
+
+    const std::string& str() const { return strOut; }
+    std::string& str() { return strOut; }
+    void Reserve(size_t n) { strOut.reserve(n); }
+    void Clear();
+};
+
+#endif // BITCOIN_RPCJSON_H
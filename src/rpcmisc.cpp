@@ -7,6 +7,7 @@
 #include "init.h"
 #include "main.h"
 #include "net.h"
+#include "perfstats.h"
 #include "netbase.h"
 #include "rpcserver.h"
 #include "util.h"
@@ -62,34 +63,44 @@ Value getinfo(const Array& params, bool fHelp)
     proxyType proxy;
     GetProxy(NET_IPV4, proxy);
 
+    // Chain state comes from the snapshot; only the wallet fields need locks
+    std::shared_ptr<const CChainSnapshot> snapshot = GetChainSnapshot();
+    int nConnections;
+    {
+        LOCK(cs_vNodes);
+        nConnections = vNodes.size();
+    }
+
     Object obj, diff;
     obj.push_back(Pair("version", FormatFullVersion()));
     obj.push_back(Pair("protocolversion", PROTOCOL_VERSION));
 #ifdef ENABLE_WALLET
     if (pwalletMain)
     {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
         obj.push_back(Pair("walletversion", pwalletMain->GetVersion()));
         obj.push_back(Pair("balance", ValueFromAmount(pwalletMain->GetBalance())));
         if(!fLiteMode)
             obj.push_back(Pair("darksend_balance", ValueFromAmount(pwalletMain->GetAnonymizedBalance())));
     }
 #endif
-    obj.push_back(Pair("blocks",  (int)nBestHeight));
+    obj.push_back(Pair("blocks",  snapshot->nHeight));
     obj.push_back(Pair("timeoffset", (int64_t)GetTimeOffset()));
-    obj.push_back(Pair("moneysupply", ValueFromAmount(pindexBest->nMoneySupply)));
-    obj.push_back(Pair("connections",   (int)vNodes.size()));
+    obj.push_back(Pair("moneysupply", ValueFromAmount(snapshot->nMoneySupply)));
+    obj.push_back(Pair("connections",   nConnections));
     obj.push_back(Pair("proxy", (proxy.first.IsValid() ? proxy.first.ToStringIPPort() : string())));
     obj.push_back(Pair("ip", GetLocalAddress(NULL).ToStringIP()));
-    obj.push_back(Pair("difficulty", (double)GetDifficulty()));
+    obj.push_back(Pair("difficulty", snapshot->pindexTip ? GetDifficulty(snapshot->pindexLastPoW) : 1.0));
     obj.push_back(Pair("testnet",       TestNet()));
 #ifdef ENABLE_WALLET
     if (pwalletMain)
     {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
         obj.push_back(Pair("keypoololdest", (int64_t)pwalletMain->GetOldestKeyPoolTime()));
         obj.push_back(Pair("keypoolsize",   (int)pwalletMain->GetKeyPoolSize()));
+        if (pwalletMain->IsCrypted())
+            obj.push_back(Pair("unlocked_until", (int64_t)nWalletUnlockTime));
     }
-    if (pwalletMain && pwalletMain->IsCrypted())
-        obj.push_back(Pair("unlocked_until", (int64_t)nWalletUnlockTime));
     obj.push_back(Pair("paytxfee", ValueFromAmount(nTransactionFee)));
     obj.push_back(Pair("mininput", ValueFromAmount(nMinimumInputValue)));
 #endif
@@ -259,6 +270,105 @@ Value spork(const Array& params, bool fHelp)
         HelpRequiringPassphrase());
 }
 
+static bool LockStatsByWait(const CLockSiteStats& a, const CLockSiteStats& b)
+{
+    return a.nWaitNanos > b.nWaitNanos || (a.nWaitNanos == b.nWaitNanos && a.nHoldNanos > b.nHoldNanos);
+}
+
+Value getlockstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getlockstats ( \"start\"|\"stop\"|\"reset\" )\n"
+            "Returns lock profiling statistics per LOCK site (lock name and file:line),\n"
+            "most waited on first: acquisitions, how many of them had to wait, and the\n"
+            "total time spent waiting for and holding the lock, in microseconds.\n"
+            "Hold times of recursive acquisitions include the nested ones.\n"
+            "\"start\" and \"stop\" switch profiling on and off (see -lockprofile),\n"
+            "\"reset\" starts counting from zero.");
+
+    if (params.size() == 1)
+    {
+        string strCommand = params[0].get_str();
+        if (strCommand == "start")
+            SetLockProfiling(true);
+        else if (strCommand == "stop")
+            SetLockProfiling(false);
+        else if (strCommand == "reset")
+            ResetLockStats();
+        else
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown command: " + strCommand);
+    }
+
+    vector<CLockSiteStats> vStats;
+    GetLockStats(vStats);
+    sort(vStats.begin(), vStats.end(), LockStatsByWait);
+
+    Array sites;
+    BOOST_FOREACH(const CLockSiteStats& stats, vStats)
+    {
+        Object site;
+        site.push_back(Pair("lock", stats.strName));
+        site.push_back(Pair("site", strprintf("%s:%d", stats.strFile, stats.nLine)));
+        site.push_back(Pair("acquired", stats.nAcquired));
+        site.push_back(Pair("contended", stats.nContended));
+        site.push_back(Pair("wait_us", stats.nWaitNanos / 1000));
+        site.push_back(Pair("hold_us", stats.nHoldNanos / 1000));
+        sites.push_back(site);
+    }
+
+    Object result;
+    result.push_back(Pair("enabled", fLockProfiling.load()));
+    result.push_back(Pair("sites", sites));
+    return result;
+}
+
+static Object PerfSummaryToJSON(const CPerfSummary& summary)
+{
+    Object obj;
+    obj.push_back(Pair("count", summary.nCount));
+    obj.push_back(Pair("avg_us", summary.nCount ? summary.nTotal / summary.nCount : 0));
+    obj.push_back(Pair("p50_us", summary.nP50));
+    obj.push_back(Pair("p90_us", summary.nP90));
+    obj.push_back(Pair("p99_us", summary.nP99));
+    obj.push_back(Pair("max_us", summary.nMax));
+    return obj;
+}
+
+Value getperfstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1 || (params.size() == 1 && params[0].get_str() != "reset"))
+        throw runtime_error(
+            "getperfstats ( \"reset\" )\n"
+            "Returns timing of block validation, mining, masternode payment and rank\n"
+            "computations, and of processing each P2P message command: count, average,\n"
+            "50th, 90th and 99th percentile and maximum, in microseconds. Percentiles are\n"
+            "accurate to within 25%. Bytes per command are in getpeerinfo.\n"
+            "\"reset\" clears the counters after returning them.");
+
+    Object stages;
+    for (int i = 0; i < PERF_STAGE_COUNT; i++)
+    {
+        CPerfSummary summary;
+        GetPerfHistogram((PerfStage)i).GetSummary(summary);
+        stages.push_back(Pair(GetPerfStageName((PerfStage)i), PerfSummaryToJSON(summary)));
+    }
+
+    vector<pair<string, CPerfSummary> > vSummaries;
+    GetMessagePerfSummaries(vSummaries);
+    Object messages;
+    for (unsigned int i = 0; i < vSummaries.size(); i++)
+        messages.push_back(Pair(vSummaries[i].first, PerfSummaryToJSON(vSummaries[i].second)));
+
+    if (params.size() == 1)
+        ResetPerfStats();
+
+    Object result;
+    result.push_back(Pair("stages", stages));
+    result.push_back(Pair("messages", messages));
+    return result;
+}
+
 Value validateaddress(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -86,6 +86,14 @@ Value getpeerinfo(const Array& params, bool fHelp)
         obj.push_back(Pair("lastrecv", (int64_t)stats.nLastRecv));
         obj.push_back(Pair("bytessent", (int64_t)stats.nSendBytes));
         obj.push_back(Pair("bytesrecv", (int64_t)stats.nRecvBytes));
+        Object sendPerMsg;
+        BOOST_FOREACH(const mapMsgCmdSize::value_type& i, stats.mapSendBytesPerMsgCmd)
+            sendPerMsg.push_back(Pair(i.first, i.second));
+        obj.push_back(Pair("bytessent_per_msg", sendPerMsg));
+        Object recvPerMsg;
+        BOOST_FOREACH(const mapMsgCmdSize::value_type& i, stats.mapRecvBytesPerMsgCmd)
+            recvPerMsg.push_back(Pair(i.first, i.second));
+        obj.push_back(Pair("bytesrecv_per_msg", recvPerMsg));
         obj.push_back(Pair("conntime", (int64_t)stats.nTimeConnected));
         obj.push_back(Pair("timeoffset", stats.nTimeOffset));
         obj.push_back(Pair("pingtime", stats.dPingTime));
@@ -5,6 +5,7 @@
 
 #include "rpcprotocol.h"
 
+#include "rpcjson.h"
 #include "util.h"
 
 #include <stdint.h>
@@ -84,6 +85,7 @@ string HTTPReply(int nStatus, const string& strMsg, bool keepalive)
     else if (nStatus == HTTP_FORBIDDEN) cStatus = "Forbidden";
     else if (nStatus == HTTP_NOT_FOUND) cStatus = "Not Found";
     else if (nStatus == HTTP_INTERNAL_SERVER_ERROR) cStatus = "Internal Server Error";
+    else if (nStatus == HTTP_SERVICE_UNAVAILABLE) cStatus = "Service Unavailable";
     else cStatus = "";
     return strprintf(
             "HTTP/1.1 %d %s\r\n"
@@ -138,6 +140,129 @@ bool ReadHTTPRequestLine(std::basic_istream<char>& stream, int &proto,
     return true;
 }
 
+// Longest request or header line accepted
+static const size_t HTTP_MAX_LINE = 16 * 1024;
+
+HTTPRequestParser::HTTPRequestParser(size_t nMaxSizeIn) : nMaxSize(nMaxSizeIn)
+{
+    Reset();
+}
+
+void HTTPRequestParser::Reset()
+{
+    state = STATE_REQUEST_LINE;
+    strMethod.clear();
+    strURI.clear();
+    strAuthorization.clear();
+    strBody.clear();
+    strLine.clear();
+    strConnection.clear();
+    nProto = 0;
+    nContentLength = 0;
+    fKeepAlive = false;
+}
+
+bool HTTPRequestParser::ParseRequestLine()
+{
+    // Same rules as ReadHTTPRequestLine
+    vector<string> vWords;
+    boost::split(vWords, strLine, boost::is_any_of(" "));
+    if (vWords.size() < 2)
+        return false;
+
+    strMethod = vWords[0];
+    if (strMethod != "GET" && strMethod != "POST")
+        return false;
+
+    strURI = vWords[1];
+    if (strURI.size() == 0 || strURI[0] != '/')
+        return false;
+
+    nProto = 0;
+    if (vWords.size() > 2) {
+        const char *ver = strstr(vWords[2].c_str(), "HTTP/1.");
+        if (ver != NULL)
+            nProto = atoi(ver+7);
+    }
+    return true;
+}
+
+bool HTTPRequestParser::ParseHeader()
+{
+    string::size_type nColon = strLine.find(':');
+    if (nColon == string::npos)
+        return true;
+    string strHeader = strLine.substr(0, nColon);
+    boost::trim(strHeader);
+    if (boost::iequals(strHeader, "content-length")) {
+        string strValue = strLine.substr(nColon + 1);
+        boost::trim(strValue);
+        int nLen = atoi(strValue.c_str());
+        if (nLen < 0 || (size_t)nLen > nMaxSize)
+            return false;
+        nContentLength = nLen;
+    } else if (boost::iequals(strHeader, "authorization")) {
+        strAuthorization = strLine.substr(nColon + 1);
+        boost::trim(strAuthorization);
+    } else if (boost::iequals(strHeader, "connection")) {
+        strConnection = strLine.substr(nColon + 1);
+        boost::trim(strConnection);
+        boost::to_lower(strConnection);
+    }
+    return true;
+}
+
+HTTPRequestParser::Result HTTPRequestParser::Parse(const char* pbegin, size_t nSize, size_t& nConsumed)
+{
+    const char* p = pbegin;
+    const char* pend = pbegin + nSize;
+    while (p < pend && state != STATE_COMPLETE)
+    {
+        if (state == STATE_BODY) {
+            size_t nTake = std::min((size_t)(pend - p), nContentLength - strBody.size());
+            strBody.append(p, nTake);
+            p += nTake;
+            if (strBody.size() == nContentLength)
+                state = STATE_COMPLETE;
+            continue;
+        }
+
+        const char* pnewline = (const char*)memchr(p, '\n', pend - p);
+        strLine.append(p, pnewline ? pnewline : pend);
+        p = pnewline ? pnewline + 1 : pend;
+        if (strLine.size() > HTTP_MAX_LINE) {
+            nConsumed = p - pbegin;
+            return BAD_REQUEST;
+        }
+        if (!pnewline)
+            break;
+        if (!strLine.empty() && strLine[strLine.size() - 1] == '\r')
+            strLine.erase(strLine.size() - 1);
+
+        if (state == STATE_REQUEST_LINE) {
+            if (!ParseRequestLine()) {
+                nConsumed = p - pbegin;
+                return BAD_REQUEST;
+            }
+            state = STATE_HEADERS;
+        } else if (strLine.empty()) {
+            // End of headers
+            if (strConnection == "close" || strConnection == "keep-alive")
+                fKeepAlive = (strConnection == "keep-alive");
+            else
+                fKeepAlive = (nProto >= 1);
+            strBody.reserve(nContentLength);
+            state = nContentLength > 0 ? STATE_BODY : STATE_COMPLETE;
+        } else if (!ParseHeader()) {
+            nConsumed = p - pbegin;
+            return BAD_REQUEST;
+        }
+        strLine.clear();
+    }
+    nConsumed = p - pbegin;
+    return state == STATE_COMPLETE ? COMPLETE : INCOMPLETE;
+}
+
 int ReadHTTPStatus(std::basic_istream<char>& stream, int &proto)
 {
     string str;
@@ -233,29 +358,39 @@ int ReadHTTPMessage(std::basic_istream<char>& stream, map<string,
 
 string JSONRPCRequest(const string& strMethod, const Array& params, const Value& id)
 {
-    Object request;
-    request.push_back(Pair("method", strMethod));
-    request.push_back(Pair("params", params));
-    request.push_back(Pair("id", id));
-    return write_string(Value(request), false) + "\n";
+    CJSONWriter writer;
+    writer.BeginObject();
+    writer.Key("method").String(strMethod);
+    writer.Key("params").Value(params);
+    writer.Key("id").Value(id);
+    writer.EndObject();
+    return writer.str() + "\n";
 }
 
-Object JSONRPCReplyObj(const Value& result, const Value& error, const Value& id)
+string JSONRPCReply(const Value& result, const Value& error, const Value& id)
 {
-    Object reply;
+    CJSONWriter writer;
+    writer.BeginObject().Key("result");
     if (error.type() != null_type)
-        reply.push_back(Pair("result", Value::null));
+        writer.Null();
     else
-        reply.push_back(Pair("result", result));
-    reply.push_back(Pair("error", error));
-    reply.push_back(Pair("id", id));
-    return reply;
+        writer.Value(result);
+    writer.Key("error").Value(error);
+    writer.Key("id").Value(id);
+    writer.EndObject();
+    return writer.str() + "\n";
 }
 
-string JSONRPCReply(const Value& result, const Value& error, const Value& id)
+void JSONRPCWriteReply(CJSONWriter& writer, const string& strResult, const Value& error, const Value& id)
 {
-    Object reply = JSONRPCReplyObj(result, error, id);
-    return write_string(Value(reply), false) + "\n";
+    writer.BeginObject().Key("result");
+    if (error.type() != null_type)
+        writer.Null();
+    else
+        writer.Raw(strResult);
+    writer.Key("error").Value(error);
+    writer.Key("id").Value(id);
+    writer.EndObject();
 }
 
 Object JSONRPCError(int code, const string& message)
@@ -22,6 +22,8 @@
 #include "json/json_spirit_utils.h"
 #include "json/json_spirit_writer_template.h"
 
+class CJSONWriter;
+
 // HTTP status codes
 enum HTTPStatusCode
 {
@@ -31,6 +33,7 @@ enum HTTPStatusCode
     HTTP_FORBIDDEN             = 403,
     HTTP_NOT_FOUND             = 404,
     HTTP_INTERNAL_SERVER_ERROR = 500,
+    HTTP_SERVICE_UNAVAILABLE   = 503,
 };
 
 // Bitcoin RPC error codes
@@ -125,6 +128,51 @@ private:
     boost::asio::ssl::stream<typename Protocol::socket>& stream;
 };
 
+/** Parser for HTTP requests that arrive in arbitrary pieces, as read from a
+ *  socket. Only the parts of a request the RPC server acts on are kept, and
+ *  the strings keep their storage across Reset for the next request.
+ */
+class HTTPRequestParser
+{
+public:
+    enum Result {
+        INCOMPLETE,
+        COMPLETE,
+        BAD_REQUEST,
+    };
+
+    std::string strMethod;
+    std::string strURI;
+    std::string strAuthorization;
+    std::string strBody;
+    int nProto;
+    bool fKeepAlive;
+
+    explicit HTTPRequestParser(size_t nMaxSizeIn);
+
+    /** Consume bytes of the request. nConsumed is set to the number used;
+     *  once the request is complete the rest belongs to the next one. */
+    Result Parse(const char* pbegin, size_t nSize, size_t& nConsumed);
+    void Reset();
+
+private:
+    enum State {
+        STATE_REQUEST_LINE,
+        STATE_HEADERS,
+        STATE_BODY,
+        STATE_COMPLETE,
+    };
+
+    State state;
+    std::string strLine;
+    std::string strConnection;
+    size_t nContentLength;
+    size_t nMaxSize;
+
+    bool ParseRequestLine();
+    bool ParseHeader();
+};
+
 std::string HTTPPost(const std::string& strMsg, const std::map<std::string,std::string>& mapRequestHeaders);
 std::string HTTPReply(int nStatus, const std::string& strMsg, bool keepalive);
 bool ReadHTTPRequestLine(std::basic_istream<char>& stream, int &proto,
@@ -134,8 +182,9 @@ int ReadHTTPHeaders(std::basic_istream<char>& stream, std::map<std::string, std:
 int ReadHTTPMessage(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet,
                     std::string& strMessageRet, int nProto, size_t max_size);
 std::string JSONRPCRequest(const std::string& strMethod, const json_spirit::Array& params, const json_spirit::Value& id);
-json_spirit::Object JSONRPCReplyObj(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
 std::string JSONRPCReply(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
+/** Write a reply object around a result that is already JSON text */
+void JSONRPCWriteReply(CJSONWriter& writer, const std::string& strResult, const json_spirit::Value& error, const json_spirit::Value& id);
 json_spirit::Object JSONRPCError(int code, const std::string& message);
 
 /** Get name of RPC authentication cookie file */
@@ -7,6 +7,7 @@
 
 #include "base58.h"
 #include "rpcserver.h"
+#include "rpcjson.h"
 #include "txdb.h"
 #include "init.h"
 #include "main.h"
@@ -520,6 +521,7 @@ Value signrawtransaction(const Array& params, bool fHelp)
     bool fHashSingle = ((nHashType & ~SIGHASH_ANYONECANPAY) == SIGHASH_SINGLE);
 
     // Sign what we can:
+    PrecomputedTransactionData txdata(mergedTx);
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++)
     {
         CTxIn& txin = mergedTx.vin[i];
@@ -533,14 +535,14 @@ Value signrawtransaction(const Array& params, bool fHelp)
         txin.scriptSig.clear();
         // Only sign SIGHASH_SINGLE if there's a corresponding output:
         if (!fHashSingle || (i < mergedTx.vout.size()))
-            SignSignature(keystore, prevPubKey, mergedTx, i, nHashType);
+            SignSignature(keystore, prevPubKey, mergedTx, i, nHashType, &txdata);
 
         // ... and merge in other signatures:
         BOOST_FOREACH(const CTransaction& txv, txVariants)
         {
             txin.scriptSig = CombineSignatures(prevPubKey, mergedTx, i, txin.scriptSig, txv.vin[i].scriptSig);
         }
-        if (!VerifyScript(txin.scriptSig, prevPubKey, mergedTx, i, STANDARD_SCRIPT_VERIFY_FLAGS, 0))
+        if (!VerifyScript(txin.scriptSig, prevPubKey, mergedTx, i, STANDARD_SCRIPT_VERIFY_FLAGS, 0, &txdata))
             fComplete = false;
     }
 
@@ -599,7 +601,7 @@ Value sendrawtransaction(const Array& params, bool fHelp)
 }
 
 
-Value searchrawtransactions(const Array &params, bool fHelp)
+void searchrawtransactions_writer(const Array &params, bool fHelp, CJSONWriter& writer)
 {
     if (fHelp || params.size() < 1 || params.size() > 4)
         throw runtime_error(
@@ -634,16 +636,14 @@ Value searchrawtransactions(const Array &params, bool fHelp)
     std::vector<uint256>::const_iterator it = vtxhash.begin();
     while (it != vtxhash.end() && nSkip--) it++;
 
-    Array result;
+    writer.BeginArray();
     while (it != vtxhash.end() && nCount--) {
         CTransaction tx;
         uint256 hashBlock;
         if (!GetTransaction(*it, tx, hashBlock))
         {
            // throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Cannot read transaction from disk");
-           Object obj;
-	   obj.push_back(Pair("ERROR", "Cannot read transaction from disk"));
-	   result.push_back(obj);
+           writer.BeginObject().Key("ERROR").String("Cannot read transaction from disk").EndObject();
 	}
 	else
 	{
@@ -655,13 +655,18 @@ Value searchrawtransactions(const Array &params, bool fHelp)
             Object object;
             TxToJSON(tx, hashBlock, object);
             object.push_back(Pair("hex", strHex));
-            result.push_back(object);
+            writer.Value(object);
         } else {
-            result.push_back(strHex);
+            writer.String(strHex);
         }
 
         }
         it++;
     }
-    return result;
+    writer.EndArray();
+}
+
+Value searchrawtransactions(const Array &params, bool fHelp)
+{
+    return RPCValueFromWriter(searchrawtransactions_writer, params, fHelp);
 }
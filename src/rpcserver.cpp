@@ -7,6 +7,7 @@
 
 #include "base58.h"
 #include "init.h"
+#include "rpcjson.h"
 #include "util.h"
 #include "sync.h"
 #include "base58.h"
@@ -42,6 +43,8 @@ static boost::asio::io_service* rpc_io_service = NULL;
 static map<string, boost::shared_ptr<deadline_timer> > deadlineTimers;
 static ssl::context* rpc_ssl_context = NULL;
 static boost::thread_group* rpc_worker_group = NULL;
+class CRPCWorkQueue;
+static CRPCWorkQueue* rpc_work_queue = NULL;
 
 void RPCTypeCheck(const Array& params,
                   const list<Value_type>& typesExpected,
@@ -216,32 +219,35 @@ Value stop(const Array& params, bool fHelp)
 //
 
 
+// Commands with large replies can also give a writer, which produces the
+// reply text directly when it is sent over HTTP.
 static const CRPCCommand vRPCCommands[] =
-{ //  name                      actor (function)         okSafeMode threadSafe reqWallet
-  //  ------------------------  -----------------------  ---------- ---------- ---------
+{ //  name                      actor (function)         okSafeMode threadSafe reqWallet  writer
+  //  ------------------------  -----------------------  ---------- ---------- ---------  ------------------------------
     /* Overall control/query calls */
     { "help",                   &help,                   true,      true,      false },
     { "stop",                   &stop,                   true,      true,      false },
-    { "getinfo",                &getinfo,                true,      false,     false },
+    { "getinfo",                &getinfo,                true,      true,      false },
 
     /* P2P networking */
     { "addnode",                &addnode,                true,      true,      false },
     { "getaddednodeinfo",       &getaddednodeinfo,       true,      true,      false },
-    { "getconnectioncount",     &getconnectioncount,     true,      false,     false },
+    { "getconnectioncount",     &getconnectioncount,     true,      true,      false },
     { "getnettotals",           &getnettotals,           true,      true,      false },
-    { "getpeerinfo",            &getpeerinfo,            true,      false,     false },
+    { "getpeerinfo",            &getpeerinfo,            true,      true,      false },
     { "ping",                   &ping,                   true,      false,     false },
     { "sendalert",              &sendalert,              false,     false,     false },
 
     /* Block chain and UTXO */
-    { "getbestblockhash",       &getbestblockhash,       true,      false,     false },
-    { "getblockcount",          &getblockcount,          true,      false,     false },
-    { "getblock",               &getblock,               false,     false,     false },
-    { "getblockhash",           &getblockhash,           false,     false,     false },
-    { "getdifficulty",          &getdifficulty,          true,      false,     false },
-    { "getrawmempool",          &getrawmempool,          true,      false,     false },
-    { "getblockbynumber",       &getblockbynumber,       false,     false,     false },
+    { "getbestblockhash",       &getbestblockhash,       true,      true,      false },
+    { "getblockcount",          &getblockcount,          true,      true,      false },
+    { "getblock",               &getblock,               false,     true,      false,     &getblock_writer },
+    { "getblockhash",           &getblockhash,           false,     true,      false },
+    { "getdifficulty",          &getdifficulty,          true,      true,      false },
+    { "getrawmempool",          &getrawmempool,          true,      true,      false,     &getrawmempool_writer },
+    { "getblockbynumber",       &getblockbynumber,       false,     false,     false,     &getblockbynumber_writer },
     { "getcheckpoint",          &getcheckpoint,          true,      false,     false },
+    { "getdbstats",             &getdbstats,             true,      true,      false },
 
     /* Mining */
     { "getblocktemplate",       &getblocktemplate,       true,      false,     false },
@@ -256,13 +262,15 @@ static const CRPCCommand vRPCCommands[] =
     { "getrawtransaction",      &getrawtransaction,      false,     false,     false },
     { "sendrawtransaction",     &sendrawtransaction,     false,     false,     false },
     { "signrawtransaction",     &signrawtransaction,     false,     false,     false },
-    { "searchrawtransactions",  &searchrawtransactions,  false,     false,     false },
+    { "searchrawtransactions",  &searchrawtransactions,  false,     false,     false,     &searchrawtransactions_writer },
 
     /* Utility functions */
     { "createmultisig",         &createmultisig,         true,      true,      false },
     { "validateaddress",        &validateaddress,        true,      false,     false },
     { "verifymessage",          &verifymessage,          false,     false,     false },
     { "reorganize",             &reorganize,             false,     false,     false },
+    { "getlockstats",           &getlockstats,           true,      true,      false },
+    { "getperfstats",           &getperfstats,           true,      true,      false },
 
     /* Monkey features */
     { "masternode",             &masternode,             true,      false,     true },
@@ -333,7 +341,8 @@ static const CRPCCommand vRPCCommands[] =
     { "repairwallet",           &repairwallet,           false,     true,      true },
     { "resendtx",               &resendtx,               false,     true,      true },
     { "makekeypair",            &makekeypair,            false,     true,      false },
-    { "scanforalltxns",         &scanforalltxns,         false,     false,     false },
+    { "scanforalltxns",         &scanforalltxns,         false,     true,      false },
+    { "abortrescan",            &abortrescan,            false,     true,      true },
     { "setstakesplitthreshold", &setstakesplitthreshold, false,     false,     true },
     { "getstakesplitthreshold", &getstakesplitthreshold, false,     false,     true },
 #endif
@@ -360,9 +369,8 @@ const CRPCCommand *CRPCTable::operator[](string name) const
 }
 
 
-bool HTTPAuthorized(map<string, string>& mapHeaders)
+bool HTTPAuthorized(const string& strAuth)
 {
-    string strAuth = mapHeaders["authorization"];
     if (strAuth.substr(0,6) != "Basic ")
         return false;
     string strUserPass64 = strAuth.substr(6); boost::trim(strUserPass64);
@@ -370,15 +378,15 @@ bool HTTPAuthorized(map<string, string>& mapHeaders)
     return TimingResistantEqual(strUserPass, strRPCUserColonPass);
 }
 
-void ErrorReply(std::ostream& stream, const Object& objError, const Value& id)
+string ErrorReply(const Object& objError, const Value& id)
 {
-    // Send error reply from json-rpc error object
+    // Error reply from json-rpc error object
     int nStatus = HTTP_INTERNAL_SERVER_ERROR;
     int code = find_value(objError, "code").get_int();
     if (code == RPC_INVALID_REQUEST) nStatus = HTTP_BAD_REQUEST;
     else if (code == RPC_METHOD_NOT_FOUND) nStatus = HTTP_NOT_FOUND;
     string strReply = JSONRPCReply(Value::null, objError, id);
-    stream << HTTPReply(nStatus, strReply, false) << std::flush;
+    return HTTPReply(nStatus, strReply, false);
 }
 
 bool ClientAllowed(const boost::asio::ip::address& address)
@@ -404,78 +412,268 @@ bool ClientAllowed(const boost::asio::ip::address& address)
     return false;
 }
 
-class AcceptedConnection
+/**
+ * Requests waiting for an RPC worker thread. The queue is bounded, so that a
+ * flood of requests is answered with 503 rather than piling up.
+ */
+class CRPCWorkQueue
 {
+private:
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<boost::function<void(void)> > queue;
+    size_t nMaxDepth;
+    bool fRunning;
+
 public:
-    virtual ~AcceptedConnection() {}
+    CRPCWorkQueue(size_t nMaxDepthIn) : nMaxDepth(nMaxDepthIn), fRunning(true) {}
+
+    bool Enqueue(const boost::function<void(void)>& func)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (!fRunning || queue.size() >= nMaxDepth)
+            return false;
+        queue.push_back(func);
+        cond.notify_one();
+        return true;
+    }
+
+    void Run()
+    {
+        while (true) {
+            boost::function<void(void)> func;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (fRunning && queue.empty())
+                    cond.wait(lock);
+                if (!fRunning)
+                    return;
+                func = queue.front();
+                queue.pop_front();
+            }
+            func();
+        }
+    }
 
-    virtual std::iostream& stream() = 0;
-    virtual std::string peer_address_to_string() const = 0;
-    virtual void close() = 0;
+    void Interrupt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fRunning = false;
+        cond.notify_all();
+    }
 };
 
-template <typename Protocol>
-class AcceptedConnectionImpl : public AcceptedConnection
+bool JSONRPCExecHTTP(const string& strRequest, bool fKeepAlive, string& strReply);
+
+/**
+ * One client connection. All of its I/O runs on the RPC I/O thread and never
+ * blocks: requests are parsed as bytes come in, executed by the work queue,
+ * and their replies written back asynchronously. An idle keep-alive
+ * connection costs a socket and a buffer, not a thread.
+ */
+class RPCConnection : public boost::enable_shared_from_this<RPCConnection>
 {
 public:
-    AcceptedConnectionImpl(
-            boost::asio::io_service& io_service,
-            ssl::context &context,
-            bool fUseSSL) :
+    ip::tcp::endpoint peer;
+    ssl::stream<ip::tcp::socket> sslStream;
+
+    RPCConnection(io_service& io_service, ssl::context& context, bool fUseSSLIn) :
         sslStream(io_service, context),
-        _d(sslStream, fUseSSL),
-        _stream(_d)
+        fUseSSL(fUseSSLIn),
+        timer(io_service),
+        parser(MAX_SIZE),
+        vchBuffer(16 * 1024),
+        nBufferBegin(0),
+        nBufferEnd(0),
+        fKeepAlive(false)
     {
     }
 
-    virtual std::iostream& stream()
+    void Start()
     {
-        return _stream;
+        if (fUseSSL)
+            sslStream.async_handshake(ssl::stream_base::server,
+                boost::bind(&RPCConnection::HandleHandshake, shared_from_this(), _1));
+        else
+            ReadRequest();
     }
 
-    virtual std::string peer_address_to_string() const
+    /** Refuse the client with a reply that needs no request */
+    void Refuse(int nStatus)
     {
-        return peer.address().to_string();
+        // Only send a reply if we're not using SSL to prevent a DoS during the SSL handshake.
+        if (fUseSSL)
+            Close();
+        else
+            Send(HTTPReply(nStatus, "", false), false);
     }
 
-    virtual void close()
+    /** Write a reply; call on the I/O thread */
+    void Send(const string& strReplyIn, bool fKeepAliveIn)
     {
-        _stream.close();
+        strReply = strReplyIn;
+        fKeepAlive = fKeepAliveIn;
+        if (fUseSSL)
+            async_write(sslStream, buffer(strReply), boost::bind(&RPCConnection::HandleWrite, shared_from_this(), _1));
+        else
+            async_write(sslStream.next_layer(), buffer(strReply), boost::bind(&RPCConnection::HandleWrite, shared_from_this(), _1));
     }
 
-    typename Protocol::endpoint peer;
-    boost::asio::ssl::stream<typename Protocol::socket> sslStream;
+    /** Run the parsed request; called by a worker thread */
+    void Execute()
+    {
+        string strReplyNew;
+        bool fKeepAliveNew = JSONRPCExecHTTP(parser.strBody, parser.fKeepAlive, strReplyNew) && parser.fKeepAlive;
+        sslStream.get_io_service().post(boost::bind(&RPCConnection::Send, shared_from_this(), strReplyNew, fKeepAliveNew));
+    }
 
 private:
-    SSLIOStreamDevice<Protocol> _d;
-    boost::iostreams::stream< SSLIOStreamDevice<Protocol> > _stream;
-};
+    bool fUseSSL;
+    deadline_timer timer;
+    HTTPRequestParser parser;
+    // Bytes read but not parsed yet are vchBuffer[nBufferBegin, nBufferEnd)
+    std::vector<char> vchBuffer;
+    size_t nBufferBegin;
+    size_t nBufferEnd;
+    string strReply;
+    bool fKeepAlive;
+
+    void Close()
+    {
+        boost::system::error_code ec;
+        timer.cancel(ec);
+        sslStream.lowest_layer().close(ec);
+    }
+
+    void HandleHandshake(const boost::system::error_code& error)
+    {
+        if (error) {
+            Close();
+            return;
+        }
+        ReadRequest();
+    }
+
+    void ReadRequest()
+    {
+        parser.Reset();
+        timer.expires_from_now(posix_time::seconds(GetArg("-rpcservertimeout", DEFAULT_RPC_SERVER_TIMEOUT)));
+        timer.async_wait(boost::bind(&RPCConnection::HandleTimeout, shared_from_this(), _1));
+        ParseBuffered();
+    }
+
+    void ParseBuffered()
+    {
+        // Pipelined requests may already be waiting in the buffer
+        if (nBufferBegin < nBufferEnd) {
+            size_t nConsumed = 0;
+            HTTPRequestParser::Result result = parser.Parse(&vchBuffer[nBufferBegin], nBufferEnd - nBufferBegin, nConsumed);
+            nBufferBegin += nConsumed;
+            if (result == HTTPRequestParser::BAD_REQUEST) {
+                timer.cancel();
+                Send(HTTPReply(HTTP_BAD_REQUEST, "", false), false);
+                return;
+            }
+            if (result == HTTPRequestParser::COMPLETE) {
+                timer.cancel();
+                HandleRequest();
+                return;
+            }
+        }
+        nBufferBegin = nBufferEnd = 0;
+        if (fUseSSL)
+            sslStream.async_read_some(buffer(vchBuffer),
+                boost::bind(&RPCConnection::HandleRead, shared_from_this(), _1, _2));
+        else
+            sslStream.next_layer().async_read_some(buffer(vchBuffer),
+                boost::bind(&RPCConnection::HandleRead, shared_from_this(), _1, _2));
+    }
+
+    void HandleRead(const boost::system::error_code& error, size_t nBytes)
+    {
+        if (error) {
+            Close();
+            return;
+        }
+        nBufferBegin = 0;
+        nBufferEnd = nBytes;
+        ParseBuffered();
+    }
+
+    void HandleTimeout(const boost::system::error_code& error)
+    {
+        if (error != boost::asio::error::operation_aborted)
+            Close();
+    }
 
-void ServiceConnection(AcceptedConnection *conn);
+    void HandleRequest()
+    {
+        if (parser.strURI != "/") {
+            Send(HTTPReply(HTTP_NOT_FOUND, "", false), false);
+            return;
+        }
+
+        // Check authorization
+        if (parser.strAuthorization.empty()) {
+            Send(HTTPReply(HTTP_UNAUTHORIZED, "", false), false);
+            return;
+        }
+        if (!HTTPAuthorized(parser.strAuthorization)) {
+            LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", peer.address().to_string());
+            /* Deter brute-forcing short passwords.
+               If this results in a DoS the user really
+               shouldn't have their RPC port exposed. */
+            if (mapArgs["-rpcpassword"].size() < 20) {
+                timer.expires_from_now(posix_time::milliseconds(250));
+                timer.async_wait(boost::bind(&RPCConnection::HandleUnauthorized, shared_from_this(), _1));
+            } else
+                Send(HTTPReply(HTTP_UNAUTHORIZED, "", false), false);
+            return;
+        }
+
+        if (!rpc_work_queue->Enqueue(boost::bind(&RPCConnection::Execute, shared_from_this()))) {
+            LogPrint("rpc", "ThreadRPCServer work queue full, refusing request from %s\n", peer.address().to_string());
+            Send(HTTPReply(HTTP_SERVICE_UNAVAILABLE, JSONRPCReply(Value::null, JSONRPCError(RPC_MISC_ERROR, "Work queue depth exceeded"), Value::null), false), false);
+        }
+    }
+
+    void HandleUnauthorized(const boost::system::error_code& error)
+    {
+        if (error != boost::asio::error::operation_aborted)
+            Send(HTTPReply(HTTP_UNAUTHORIZED, "", false), false);
+    }
+
+    void HandleWrite(const boost::system::error_code& error)
+    {
+        if (error || !fKeepAlive) {
+            Close();
+            return;
+        }
+        ReadRequest();
+    }
+};
 
 // Forward declaration required for RPCListen
-template <typename Protocol>
-static void RPCAcceptHandler(boost::shared_ptr< basic_socket_acceptor<Protocol> > acceptor,
+static void RPCAcceptHandler(boost::shared_ptr<ip::tcp::acceptor> acceptor,
                              ssl::context& context,
                              bool fUseSSL,
-                             boost::shared_ptr< AcceptedConnection > conn,
+                             boost::shared_ptr<RPCConnection> conn,
                              const boost::system::error_code& error);
 
 /**
  * Sets up I/O resources to accept and handle a new connection.
  */
-template <typename Protocol>
-static void RPCListen(boost::shared_ptr< basic_socket_acceptor<Protocol> > acceptor,
+static void RPCListen(boost::shared_ptr<ip::tcp::acceptor> acceptor,
                    ssl::context& context,
                    const bool fUseSSL)
 {
     // Accept connection
-    boost::shared_ptr< AcceptedConnectionImpl<Protocol> > conn(new AcceptedConnectionImpl<Protocol>(acceptor->get_io_service(), context, fUseSSL));
+    boost::shared_ptr<RPCConnection> conn(new RPCConnection(acceptor->get_io_service(), context, fUseSSL));
 
     acceptor->async_accept(
             conn->sslStream.lowest_layer(),
             conn->peer,
-            boost::bind(&RPCAcceptHandler<Protocol>,
+            boost::bind(&RPCAcceptHandler,
                 acceptor,
                 boost::ref(context),
                 fUseSSL,
@@ -487,19 +685,16 @@ static void RPCListen(boost::shared_ptr< basic_socket_acceptor<Protocol> > accep
 /**
  * Accept and handle incoming connection.
  */
-template <typename Protocol>
-static void RPCAcceptHandler(boost::shared_ptr< basic_socket_acceptor<Protocol> > acceptor,
+static void RPCAcceptHandler(boost::shared_ptr<ip::tcp::acceptor> acceptor,
                              ssl::context& context,
                              const bool fUseSSL,
-                             boost::shared_ptr< AcceptedConnection > conn,
+                             boost::shared_ptr<RPCConnection> conn,
                              const boost::system::error_code& error)
 {
     // Immediately start accepting new connections, except when we're cancelled or our socket is closed.
     if (error != boost::asio::error::operation_aborted && acceptor->is_open())
         RPCListen(acceptor, context, fUseSSL);
 
-    AcceptedConnectionImpl<ip::tcp>* tcp_conn = dynamic_cast< AcceptedConnectionImpl<ip::tcp>* >(conn.get());
-
     if (error)
     {
         // TODO: Actually handle errors
@@ -509,17 +704,10 @@ static void RPCAcceptHandler(boost::shared_ptr< basic_socket_acceptor<Protocol>
     // Restrict callers by IP.  It is important to
     // do this before starting client thread, to filter out
     // certain DoS and misbehaving clients.
-    else if (tcp_conn && !ClientAllowed(tcp_conn->peer.address()))
-    {
-        // Only send a 403 if we're not using SSL to prevent a DoS during the SSL handshake.
-        if (!fUseSSL)
-            conn->stream() << HTTPReply(HTTP_FORBIDDEN, "", false) << std::flush;
-        conn->close();
-    }
-    else {
-        ServiceConnection(conn.get());
-        conn->close();
-    }
+    else if (!ClientAllowed(conn->peer.address()))
+        conn->Refuse(HTTP_FORBIDDEN);
+    else
+        conn->Start();
 }
 
 void StartRPCThreads()
@@ -672,9 +860,12 @@ void StartRPCThreads()
         return;
     }
 
+    // One thread does all socket I/O; requests are executed by the workers
+    rpc_work_queue = new CRPCWorkQueue(std::max((int)GetArg("-rpcworkqueue", DEFAULT_RPC_WORK_QUEUE), 1));
     rpc_worker_group = new boost::thread_group();
-    for (int i = 0; i < GetArg("-rpcthreads", 4); i++)
-        rpc_worker_group->create_thread(boost::bind(&asio::io_service::run, rpc_io_service));
+    rpc_worker_group->create_thread(boost::bind(&asio::io_service::run, rpc_io_service));
+    for (int i = 0; i < std::max((int)GetArg("-rpcthreads", DEFAULT_RPC_THREADS), 1); i++)
+        rpc_worker_group->create_thread(boost::bind(&CRPCWorkQueue::Run, rpc_work_queue));
 }
 
 void StopRPCThreads()
@@ -686,16 +877,21 @@ void StopRPCThreads()
     DeleteAuthCookie();
 
     rpc_io_service->stop();
+    if (rpc_work_queue != NULL)
+        rpc_work_queue->Interrupt();
     if (rpc_worker_group != NULL)
         rpc_worker_group->join_all();
     delete rpc_worker_group; rpc_worker_group = NULL;
+    delete rpc_work_queue; rpc_work_queue = NULL;
     delete rpc_ssl_context; rpc_ssl_context = NULL;
     delete rpc_io_service; rpc_io_service = NULL;
 }
 
 void RPCRunHandler(const boost::system::error_code& err, boost::function<void(void)> func)
 {
-    if (!err)
+    // Keep the I/O thread free of work that takes locks, unless the workers
+    // are all busy
+    if (!err && !rpc_work_queue->Enqueue(func))
         func();
 }
 
@@ -754,122 +950,85 @@ void JSONRequest::parse(const Value& valRequest)
 }
 
 
-static Object JSONRPCExecOne(const Value& req)
+static void JSONRPCExecOne(const Value& req, CJSONWriter& writer)
 {
-    Object rpc_result;
-
     JSONRequest jreq;
+    CJSONWriter result;
     try {
         jreq.parse(req);
 
-        Value result = tableRPC.execute(jreq.strMethod, jreq.params);
-        rpc_result = JSONRPCReplyObj(result, Value::null, jreq.id);
+        tableRPC.execute(jreq.strMethod, jreq.params, result);
+        JSONRPCWriteReply(writer, result.str(), Value::null, jreq.id);
     }
     catch (Object& objError)
     {
-        rpc_result = JSONRPCReplyObj(Value::null, objError, jreq.id);
+        JSONRPCWriteReply(writer, "", objError, jreq.id);
     }
     catch (std::exception& e)
     {
-        rpc_result = JSONRPCReplyObj(Value::null,
-                                     JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+        JSONRPCWriteReply(writer, "", JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
     }
-
-    return rpc_result;
 }
 
 static string JSONRPCExecBatch(const Array& vReq)
 {
-    Array ret;
+    CJSONWriter writer;
+    writer.BeginArray();
     for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+        JSONRPCExecOne(vReq[reqIdx], writer);
+    writer.EndArray();
 
-    return write_string(Value(ret), false) + "\n";
+    return writer.str() + "\n";
 }
 
-void ServiceConnection(AcceptedConnection *conn)
+/** Execute a request body and build the HTTP reply; errors end the connection */
+bool JSONRPCExecHTTP(const string& strRequest, bool fKeepAlive, string& strHTTPReply)
 {
-    bool fRun = true;
-    while (fRun)
+    JSONRequest jreq;
+    try
     {
-        int nProto = 0;
-        map<string, string> mapHeaders;
-        string strRequest, strMethod, strURI;
+        // Parse request
+        Value valRequest;
+        if (!JSONRead(strRequest, valRequest))
+            throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
 
-        // Read HTTP request line
-        if (!ReadHTTPRequestLine(conn->stream(), nProto, strMethod, strURI))
-            break;
+        string strReply;
 
-        // Read HTTP message headers and body
-        ReadHTTPMessage(conn->stream(), mapHeaders, strRequest, nProto, MAX_SIZE);
+        // singleton request
+        if (valRequest.type() == obj_type) {
+            jreq.parse(valRequest);
 
-        if (strURI != "/") {
-            conn->stream() << HTTPReply(HTTP_NOT_FOUND, "", false) << std::flush;
-            break;
-        }
+            CJSONWriter result;
+            tableRPC.execute(jreq.strMethod, jreq.params, result);
 
-        // Check authorization
-        if (mapHeaders.count("authorization") == 0)
-        {
-            conn->stream() << HTTPReply(HTTP_UNAUTHORIZED, "", false) << std::flush;
-            break;
-        }
-        if (!HTTPAuthorized(mapHeaders))
-        {
-            LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", conn->peer_address_to_string());
-            /* Deter brute-forcing short passwords.
-               If this results in a DoS the user really
-               shouldn't have their RPC port exposed. */
-            if (mapArgs["-rpcpassword"].size() < 20)
-                MilliSleep(250);
-
-            conn->stream() << HTTPReply(HTTP_UNAUTHORIZED, "", false) << std::flush;
-            break;
-        }
-        if (mapHeaders["connection"] == "close")
-            fRun = false;
-
-        JSONRequest jreq;
-        try
-        {
-            // Parse request
-            Value valRequest;
-            if (!read_string(strRequest, valRequest))
-                throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
-
-            string strReply;
+            // Send reply
+            CJSONWriter writer;
+            JSONRPCWriteReply(writer, result.str(), Value::null, jreq.id);
+            strReply.swap(writer.str());
+            strReply += "\n";
 
-            // singleton request
-            if (valRequest.type() == obj_type) {
-                jreq.parse(valRequest);
+        // array of requests
+        } else if (valRequest.type() == array_type)
+            strReply = JSONRPCExecBatch(valRequest.get_array());
+        else
+            throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
-                Value result = tableRPC.execute(jreq.strMethod, jreq.params);
-
-                // Send reply
-                strReply = JSONRPCReply(result, Value::null, jreq.id);
-
-            // array of requests
-            } else if (valRequest.type() == array_type)
-                strReply = JSONRPCExecBatch(valRequest.get_array());
-            else
-                throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
-
-            conn->stream() << HTTPReply(HTTP_OK, strReply, fRun) << std::flush;
-        }
-        catch (Object& objError)
-        {
-            ErrorReply(conn->stream(), objError, jreq.id);
-            break;
-        }
-        catch (std::exception& e)
-        {
-            ErrorReply(conn->stream(), JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
-            break;
-        }
+        strHTTPReply = HTTPReply(HTTP_OK, strReply, fKeepAlive);
+        return true;
     }
+    catch (Object& objError)
+    {
+        strHTTPReply = ErrorReply(objError, jreq.id);
+    }
+    catch (std::exception& e)
+    {
+        strHTTPReply = ErrorReply(JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+    }
+    return false;
 }
 
-json_spirit::Value CRPCTable::execute(const std::string &strMethod, const json_spirit::Array &params) const
+/** Look up a command and check that it may run now */
+static const CRPCCommand* RPCFindCommand(const std::string &strMethod)
 {
     // Find method
     const CRPCCommand *pcmd = tableRPC[strMethod];
@@ -886,29 +1045,31 @@ json_spirit::Value CRPCTable::execute(const std::string &strMethod, const json_s
         !pcmd->okSafeMode)
         throw JSONRPCError(RPC_FORBIDDEN_BY_SAFE_MODE, string("Safe mode: ") + strWarning);
 
+    return pcmd;
+}
+
+/** Run func under the locks the command needs */
+template <typename F>
+static void RPCRunCommand(const CRPCCommand* pcmd, F func)
+{
     try
     {
-        // Execute
-        Value result;
-        {
-            if (pcmd->threadSafe)
-                result = pcmd->actor(params, false);
+        if (pcmd->threadSafe)
+            func();
 #ifdef ENABLE_WALLET
-            else if (!pwalletMain) {
-                LOCK(cs_main);
-                result = pcmd->actor(params, false);
-            } else {
-                LOCK2(cs_main, pwalletMain->cs_wallet);
-                result = pcmd->actor(params, false);
-            }
+        else if (!pwalletMain) {
+            LOCK(cs_main);
+            func();
+        } else {
+            LOCK2(cs_main, pwalletMain->cs_wallet);
+            func();
+        }
 #else // ENABLE_WALLET
-            else {
-                LOCK(cs_main);
-                result = pcmd->actor(params, false);
-            }
-#endif // !ENABLE_WALLET
+        else {
+            LOCK(cs_main);
+            func();
         }
-        return result;
+#endif // !ENABLE_WALLET
     }
     catch (std::exception& e)
     {
@@ -916,6 +1077,37 @@ json_spirit::Value CRPCTable::execute(const std::string &strMethod, const json_s
     }
 }
 
+json_spirit::Value CRPCTable::execute(const std::string &strMethod, const json_spirit::Array &params) const
+{
+    const CRPCCommand *pcmd = RPCFindCommand(strMethod);
+
+    Value result;
+    RPCRunCommand(pcmd, [&]() { result = pcmd->actor(params, false); });
+    return result;
+}
+
+void CRPCTable::execute(const std::string &strMethod, const json_spirit::Array &params, CJSONWriter& writer) const
+{
+    const CRPCCommand *pcmd = RPCFindCommand(strMethod);
+
+    RPCRunCommand(pcmd, [&]() {
+        if (pcmd->writer)
+            pcmd->writer(params, false, writer);
+        else
+            writer.Value(pcmd->actor(params, false));
+    });
+}
+
+Value RPCValueFromWriter(rpcwriterfn_type fn, const Array& params, bool fHelp)
+{
+    CJSONWriter writer;
+    fn(params, fHelp, writer);
+    Value result;
+    if (!JSONRead(writer.str(), result))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Invalid JSON from handler");
+    return result;
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
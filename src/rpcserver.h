@@ -13,6 +13,13 @@
 #include <map>
 
 class CBlockIndex;
+class CJSONWriter;
+
+static const int DEFAULT_RPC_THREADS = 4;
+/** Requests that may wait for a worker before new ones are refused with 503 */
+static const int DEFAULT_RPC_WORK_QUEUE = 16;
+/** Seconds a connection may sit idle between requests */
+static const int DEFAULT_RPC_SERVER_TIMEOUT = 30;
 
 void StartRPCThreads();
 void StopRPCThreads();
@@ -38,6 +45,8 @@ void RPCTypeCheck(const json_spirit::Object& o,
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
 typedef json_spirit::Value(*rpcfn_type)(const json_spirit::Array& params, bool fHelp);
+/** A handler that writes its result as JSON text instead of returning a Value */
+typedef void(*rpcwriterfn_type)(const json_spirit::Array& params, bool fHelp, CJSONWriter& writer);
 
 class CRPCCommand
 {
@@ -47,8 +56,16 @@ public:
     bool okSafeMode;
     bool threadSafe;
     bool reqWallet;
+    /** Optional; used instead of actor when the reply is sent as text */
+    rpcwriterfn_type writer;
+
+    CRPCCommand(const std::string& nameIn, rpcfn_type actorIn, bool okSafeModeIn, bool threadSafeIn, bool reqWalletIn, rpcwriterfn_type writerIn = NULL) :
+        name(nameIn), actor(actorIn), okSafeMode(okSafeModeIn), threadSafe(threadSafeIn), reqWallet(reqWalletIn), writer(writerIn) {}
 };
 
+/** Run a writer handler for callers that need a Value, such as the console */
+json_spirit::Value RPCValueFromWriter(rpcwriterfn_type fn, const json_spirit::Array& params, bool fHelp);
+
 /**
  * Monkey RPC command dispatcher.
  */
@@ -70,6 +87,14 @@ public:
      */
     json_spirit::Value execute(const std::string &method, const json_spirit::Array &params) const;
 
+    /**
+     * Execute a method and append its result to writer as JSON text. Uses
+     * the command's writer handler if it has one.
+     * @throws an exception (json_spirit::Value) when an error happens; the
+     *         writer is then left with partial output.
+     */
+    void execute(const std::string &method, const json_spirit::Array &params, CJSONWriter& writer) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -172,6 +197,7 @@ extern json_spirit::Value cclistcoins(const json_spirit::Array& params, bool fHe
 
 extern json_spirit::Value getrawtransaction(const json_spirit::Array& params, bool fHelp); // in rcprawtransaction.cpp
 extern json_spirit::Value searchrawtransactions(const json_spirit::Array& params, bool fHelp);
+extern void searchrawtransactions_writer(const json_spirit::Array& params, bool fHelp, CJSONWriter& writer);
 
 extern json_spirit::Value listunspent(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value createrawtransaction(const json_spirit::Array& params, bool fHelp);
@@ -183,14 +209,19 @@ extern json_spirit::Value sendrawtransaction(const json_spirit::Array& params, b
 extern json_spirit::Value getbestblockhash(const json_spirit::Array& params, bool fHelp); // in rpcblockchain.cpp
 extern json_spirit::Value getblockcount(const json_spirit::Array& params, bool fHelp); // in rpcblockchain.cpp
 extern json_spirit::Value getdifficulty(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getdbstats(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value settxfee(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getrawmempool(const json_spirit::Array& params, bool fHelp);
+extern void getrawmempool_writer(const json_spirit::Array& params, bool fHelp, CJSONWriter& writer);
 extern json_spirit::Value getblockhash(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblock(const json_spirit::Array& params, bool fHelp);
+extern void getblock_writer(const json_spirit::Array& params, bool fHelp, CJSONWriter& writer);
 extern json_spirit::Value getblockbynumber(const json_spirit::Array& params, bool fHelp);
+extern void getblockbynumber_writer(const json_spirit::Array& params, bool fHelp, CJSONWriter& writer);
 extern json_spirit::Value getcheckpoint(const json_spirit::Array& params, bool fHelp);
 
 extern json_spirit::Value scanforalltxns(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value abortrescan(const json_spirit::Array& params, bool fHelp);
 
 extern json_spirit::Value darksend(const json_spirit::Array& params, bool fHelp); // in rpcmasternode.cpp
 extern json_spirit::Value getpoolinfo(const json_spirit::Array& params, bool fHelp);
@@ -215,5 +246,7 @@ extern json_spirit::Value validateaddress(const json_spirit::Array& params, bool
 extern json_spirit::Value verifymessage(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value validatepubkey(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value reorganize(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getlockstats(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getperfstats(const json_spirit::Array& params, bool fHelp);
 
 #endif
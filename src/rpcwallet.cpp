@@ -1460,11 +1460,56 @@ void AcentryToJSON(const CAccountingEntry& acentry, const string& strAccount, Ar
     }
 }
 
+// Cursors for paging through CWallet::wtxOrdered: an order position, and the
+// number of result entries of the wallet entries at that position that were
+// already returned.
+static string EncodeListCursor(int64_t nOrderPos, int nSkip)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << nOrderPos << nSkip;
+    return HexStr(ss.begin(), ss.end());
+}
+
+static void DecodeListCursor(const string& strCursor, int64_t& nOrderPos, int& nSkip)
+{
+    vector<unsigned char> vch(ParseHex(strCursor));
+    CDataStream ss(vch, SER_NETWORK, PROTOCOL_VERSION);
+    try {
+        ss >> nOrderPos >> nSkip;
+    } catch (std::exception& e) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    if (!ss.empty() || nSkip < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+}
+
+// Append the entries listed for the wallet entries from it up to end until ret
+// holds nCount of them, skipping the first nSkip listed at nCursorPos. Returns
+// the cursor to continue from, or "" if nothing is left.
+template <typename Iterator, typename ListFunc>
+static string ListOrderedPage(Iterator it, Iterator end, int64_t nCursorPos, int nSkip, int nCount, ListFunc list, Array& ret)
+{
+    for (; it != end; ) {
+        int64_t nOrderPos = it->first;
+        Array entries;
+        for (; it != end && it->first == nOrderPos; ++it)
+            list(it->second, entries);
+
+        int nFirst = (nOrderPos == nCursorPos) ? nSkip : 0;
+        for (int i = nFirst; i < (int)entries.size(); i++) {
+            if ((int)ret.size() >= nCount)
+                return EncodeListCursor(nOrderPos, i);
+            ret.push_back(entries[i]);
+        }
+    }
+    return "";
+}
+
 Value listtransactions(const Array& params, bool fHelp)
 {
-    if (fHelp || params.size() > 4)
+    if (fHelp || params.size() > 5)
         throw runtime_error(
-            "listtransactions ( \"account\" count from includeWatchonly)\n"
+            "listtransactions ( \"account\" count from includeWatchonly \"cursor\")\n"
             "\nReturns up to 'count' most recent transactions skipping the first 'from' transactions for account 'account'.\n"
             "\nArguments:\n"
             "1. \"account\"    (string, optional) The account name. If not included, it will list all transactions for all accounts.\n"
@@ -1472,6 +1517,10 @@ Value listtransactions(const Array& params, bool fHelp)
             "2. count          (numeric, optional, default=10) The number of transactions to return\n"
             "3. from           (numeric, optional, default=0) The number of transactions to skip\n"
             "4. includeWatchonly (bool, optional, default=false) Include transactions to watchonly addresses (see 'importaddress')\n"
+            "5. \"cursor\"     (string, optional) Page through the transactions instead of skipping 'from' of them. Pass \"\" for the\n"
+            "                                     most recent page and the \"next\" value of the last result for the page before it.\n"
+            "                                     The result is then an object {\"transactions\":[...], \"next\":\"cursor\"}, where\n"
+            "                                     \"next\" is \"\" after the oldest page.\n"
 
             "\nResult:\n"
             "[\n"
@@ -1515,6 +1564,8 @@ Value listtransactions(const Array& params, bool fHelp)
             + HelpExampleCli("listtransactions", "\"tabby\"") +
             "\nList transactions 100 to 120 from the tabby account\n"
             + HelpExampleCli("listtransactions", "\"tabby\" 20 100") +
+            "\nPage through all transactions, 1000 at a time\n"
+            + HelpExampleCli("listtransactions", "\"*\" 1000 0 false \"\"") +
             "\nAs a json rpc call\n"
             + HelpExampleRpc("listtransactions", "\"tabby\", 20, 100")
         );
@@ -1542,6 +1593,33 @@ Value listtransactions(const Array& params, bool fHelp)
 
     const CWallet::TxItems & txOrdered = pwalletMain->wtxOrdered;
 
+    if (params.size() > 4)
+    {
+        // Only the entries of one page are visited, newest first
+        if (nFrom != 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "from cannot be combined with a cursor");
+        CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin();
+        int64_t nCursorPos = 0;
+        int nSkip = 0;
+        if (!params[4].get_str().empty()) {
+            DecodeListCursor(params[4].get_str(), nCursorPos, nSkip);
+            it = CWallet::TxItems::const_reverse_iterator(txOrdered.upper_bound(nCursorPos));
+        }
+        string strNext = ListOrderedPage(it, txOrdered.rend(), nCursorPos, nSkip, nCount,
+            [&](const CWallet::TxPair& item, Array& entries) {
+                if (item.first)
+                    ListTransactions(*item.first, strAccount, 0, true, entries, filter);
+                if (item.second)
+                    AcentryToJSON(*item.second, strAccount, entries);
+            }, ret);
+        std::reverse(ret.begin(), ret.end()); // Return oldest to newest
+
+        Object result;
+        result.push_back(Pair("transactions", ret));
+        result.push_back(Pair("next", strNext));
+        return result;
+    }
+
     // iterate backwards until we have nCount items to return:
     for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it)
     {
@@ -1653,12 +1731,15 @@ Value listsinceblock(const Array& params, bool fHelp)
 {
     if (fHelp)
        throw runtime_error(
-            "listsinceblock ( \"blockhash\" target-confirmations includeWatchonly)\n"
+            "listsinceblock ( \"blockhash\" target-confirmations includeWatchonly count \"cursor\")\n"
             "\nGet all transactions in blocks since block [blockhash], or all transactions if omitted\n"
             "\nArguments:\n"
             "1. \"blockhash\"   (string, optional) The block hash to list transactions since\n"
             "2. target-confirmations:    (numeric, optional) The confirmations required, must be 1 or more\n"
-            "3. includeWatchonly:        (bool, optional, default=false) Include transactions to watchonly addresses (see 'importaddress')"
+            "3. includeWatchonly:        (bool, optional, default=false) Include transactions to watchonly addresses (see 'importaddress')\n"
+            "4. count:                   (numeric, optional) Return at most this many transactions, oldest first, and the cursor\n"
+            "                            for the rest as \"next\" (\"\" if there are no more)\n"
+            "5. \"cursor\":                (string, optional) The \"next\" value of the previous page\n"
             "\nResult:\n"
             "{\n"
             "  \"transactions\": [\n"
@@ -1680,6 +1761,8 @@ Value listsinceblock(const Array& params, bool fHelp)
             "    \"to\": \"...\",            (string) If a comment to is associated with the transaction.\n"
              "  ],\n"
             "  \"lastblock\": \"lastblockhash\"     (string) The hash of the last block\n"
+            "  \"next\": \"cursor\"     (string) Only if count was given: the cursor for the next page. When paging, use\n"
+            "                                   the lastblock of the final page for the next listsinceblock.\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("listsinceblock", "")
@@ -1714,13 +1797,37 @@ Value listsinceblock(const Array& params, bool fHelp)
     int depth = pindex ? (1 + nBestHeight - pindex->nHeight) : -1;
 
     Array transactions;
+    string strNext;
 
-    for (map<uint256, CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); it++)
+    if (params.size() > 3)
     {
-        CWalletTx tx = (*it).second;
+        int nCount = params[3].get_int();
+        if (nCount < 1)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid count");
+
+        const CWallet::TxItems& txOrdered = pwalletMain->wtxOrdered;
+        CWallet::TxItems::const_iterator it = txOrdered.begin();
+        int64_t nCursorPos = 0;
+        int nSkip = 0;
+        if (params.size() > 4 && !params[4].get_str().empty()) {
+            DecodeListCursor(params[4].get_str(), nCursorPos, nSkip);
+            it = txOrdered.lower_bound(nCursorPos);
+        }
+        strNext = ListOrderedPage(it, txOrdered.end(), nCursorPos, nSkip, nCount,
+            [&](const CWallet::TxPair& item, Array& entries) {
+                if (item.first && (depth == -1 || item.first->GetDepthInMainChain(false) < depth))
+                    ListTransactions(*item.first, "*", 0, true, entries, filter);
+            }, transactions);
+    }
+    else
+    {
+        for (map<uint256, CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); it++)
+        {
+            const CWalletTx& tx = (*it).second;
 
-        if (depth == -1 || tx.GetDepthInMainChain(false) < depth)
-            ListTransactions(tx, "*", 0, true, transactions, filter);
+            if (depth == -1 || tx.GetDepthInMainChain(false) < depth)
+                ListTransactions(tx, "*", 0, true, transactions, filter);
+        }
     }
 
     uint256 lastblock;
@@ -1744,6 +1851,8 @@ Value listsinceblock(const Array& params, bool fHelp)
     Object ret;
     ret.push_back(Pair("transactions", transactions));
     ret.push_back(Pair("lastblock", lastblock.GetHex()));
+    if (params.size() > 3)
+        ret.push_back(Pair("next", strNext));
 
     return ret;
 }
@@ -2241,6 +2350,24 @@ Value settxfee(const Array& params, bool fHelp)
     return true;
 }
 
+Value abortrescan(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "abortrescan\n"
+            "\nStop the wallet rescan started by importprivkey, importwallet or scanforalltxns.\n"
+            "\nResult:\n"
+            "true|false    (boolean) Whether a rescan was running\n"
+            "\nExamples:\n"
+            + HelpExampleCli("abortrescan", "")
+            + HelpExampleRpc("abortrescan", ""));
+
+    if (!pwalletMain->IsScanning())
+        return false;
+    pwalletMain->AbortRescan();
+    return true;
+}
+
 Value scanforalltxns(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -2260,6 +2387,7 @@ Value scanforalltxns(const Array& params, bool fHelp)
 
     if (nFromHeight > 0)
     {
+        LOCK(cs_main);
         pindex = mapBlockIndex[hashBestChain];
         while (pindex->nHeight > nFromHeight
             && pindex->pprev)
@@ -2269,14 +2397,11 @@ Value scanforalltxns(const Array& params, bool fHelp)
     if (pindex == NULL)
         throw runtime_error("Genesis Block is not set.");
 
-    {
-        LOCK2(cs_main, pwalletMain->cs_wallet);
-
-        pwalletMain->MarkDirty();
-
-        pwalletMain->ScanForWalletTransactions(pindex, true);
-        pwalletMain->ReacceptWalletTransactions();
-    }
+    // The rescan takes cs_main and cs_wallet itself, only while adding what it finds
+    pwalletMain->MarkDirty();
+    if (pwalletMain->ScanForWalletTransactions(pindex, true) < 0)
+        throw JSONRPCError(RPC_WALLET_ERROR, "Another wallet rescan is running");
+    pwalletMain->ReacceptWalletTransactions();
 
     result.push_back(Pair("result", "Scan complete."));
 
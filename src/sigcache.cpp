@@ -0,0 +1,114 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sigcache.h"
+
+#include "pubkey.h"
+#include "util.h"
+
+using namespace std;
+
+CSignatureCache signatureCache;
+
+CSignatureCache::CSignatureCache() : nBuckets(0)
+{
+}
+
+size_t CSignatureCache::Setup(size_t nMaxBytes)
+{
+    unsigned char salt[64];
+    GetRandBytes(salt, sizeof(salt));
+    hasherSalted.Reset().Write(salt, sizeof(salt));
+
+    nBuckets = std::min(nMaxBytes / sizeof(CBucket), (size_t)std::numeric_limits<uint32_t>::max());
+    pBuckets.reset(nBuckets ? new CBucket[nBuckets] : NULL);
+    for (uint32_t i = 0; i < nBuckets; i++)
+        for (int j = 0; j < 2; j++)
+            for (int k = 0; k < 4; k++)
+                pBuckets[i].entry[j].n[k].store(0, std::memory_order_relaxed);
+    return (size_t)nBuckets * 2;
+}
+
+void CSignatureCache::ComputeEntry(uint256& entry, const uint256& hash, const vector<unsigned char>& vchSig, const CPubKey& pubkey) const
+{
+    CSHA256(hasherSalted).Write(hash.begin(), 32).Write(vchSig.empty() ? NULL : &vchSig[0], vchSig.size()).Write(pubkey.begin(), pubkey.size()).Finalize(entry.begin());
+}
+
+void CSignatureCache::GetBuckets(const uint256& entry, uint32_t& nBucket1, uint32_t& nBucket2) const
+{
+    // Map 32 random bits onto [0, nBuckets) without a division
+    nBucket1 = ((entry.Get64(0) & 0xffffffff) * (uint64_t)nBuckets) >> 32;
+    nBucket2 = ((entry.Get64(1) & 0xffffffff) * (uint64_t)nBuckets) >> 32;
+}
+
+bool CSignatureCache::Match(const CEntry& slot, const uint256& entry)
+{
+    // A slot being overwritten may be read half old, half new. Both halves
+    // are salted digests of other signatures, so the mix cannot equal the
+    // digest looked up without a 128-bit SHA256 collision.
+    for (int i = 0; i < 4; i++)
+        if (slot.n[i].load(std::memory_order_relaxed) != entry.Get64(i))
+            return false;
+    return true;
+}
+
+bool CSignatureCache::IsEmpty(const CEntry& slot)
+{
+    for (int i = 0; i < 4; i++)
+        if (slot.n[i].load(std::memory_order_relaxed) != 0)
+            return false;
+    return true;
+}
+
+bool CSignatureCache::Get(const uint256& entry) const
+{
+    if (nBuckets == 0)
+        return false;
+
+    uint32_t nBucket1, nBucket2;
+    GetBuckets(entry, nBucket1, nBucket2);
+    const CBucket& bucket1 = pBuckets[nBucket1];
+    const CBucket& bucket2 = pBuckets[nBucket2];
+    return Match(bucket1.entry[0], entry) || Match(bucket1.entry[1], entry) ||
+           Match(bucket2.entry[0], entry) || Match(bucket2.entry[1], entry);
+}
+
+void CSignatureCache::Set(const uint256& entry)
+{
+    if (nBuckets == 0)
+        return;
+
+    uint32_t nBucket1, nBucket2;
+    GetBuckets(entry, nBucket1, nBucket2);
+    CEntry* vSlot[4] = { &pBuckets[nBucket1].entry[0], &pBuckets[nBucket1].entry[1],
+                         &pBuckets[nBucket2].entry[0], &pBuckets[nBucket2].entry[1] };
+
+    boost::mutex::scoped_lock lock(cs_insert);
+
+    CEntry* pSlot = NULL;
+    for (int i = 0; i < 4; i++)
+    {
+        if (Match(*vSlot[i], entry))
+            return;
+        if (!pSlot && IsEmpty(*vSlot[i]))
+            pSlot = vSlot[i];
+    }
+
+    // Both buckets full: evict one of the four candidates. The choice comes
+    // from salted digest bits, so it is random to anyone without the salt and
+    // costs nothing to compute.
+    if (!pSlot)
+        pSlot = vSlot[entry.Get64(2) & 3];
+
+    for (int i = 0; i < 4; i++)
+        pSlot->n[i].store(entry.Get64(i), std::memory_order_relaxed);
+}
+
+void InitSignatureCache()
+{
+    int64_t nMaxSizeMB = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE);
+    nMaxSizeMB = std::max((int64_t)0, std::min((int64_t)MAX_MAX_SIG_CACHE_SIZE, nMaxSizeMB));
+    size_t nEntries = signatureCache.Setup((size_t)nMaxSizeMB << 20);
+    LogPrintf("Using %d MiB for the signature cache, able to store %u elements\n", nMaxSizeMB, nEntries);
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2018 The Monkey developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef SIGCACHE_H
+#define SIGCACHE_H
+
+#include "crypto/sha256.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <vector>
+
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CPubKey;
+
+/** Default for -maxsigcachesize, in megabytes */
+static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+/** Upper bound for -maxsigcachesize, in megabytes */
+static const unsigned int MAX_MAX_SIG_CACHE_SIZE = 16384;
+
+/** Valid signature cache, to avoid doing expensive ECDSA signature checking
+ *  twice for every transaction (once when accepted into memory pool, and
+ *  again when accepted into the block chain).
+ *
+ *  Each (signature hash, signature, public key) triple is stored as a single
+ *  32-byte digest salted with a per-process random key, so entries have a
+ *  fixed size and attackers cannot aim for particular slots. The table is a
+ *  flat array of two-entry buckets, one cache line each; a digest may live in
+ *  either of two buckets picked from its own bits. Lookups read at most two
+ *  cache lines and take no lock. Inserts are serialized and overwrite one of
+ *  the four candidate slots when both buckets are full.
+ */
+class CSignatureCache
+{
+private:
+    struct CEntry
+    {
+        std::atomic<uint64_t> n[4];
+    };
+    struct CBucket
+    {
+        CEntry entry[2];
+    };
+
+    boost::scoped_array<CBucket> pBuckets;
+    uint32_t nBuckets;
+    // SHA256 state after absorbing the random salt
+    CSHA256 hasherSalted;
+    boost::mutex cs_insert;
+
+    void GetBuckets(const uint256& entry, uint32_t& nBucket1, uint32_t& nBucket2) const;
+    static bool Match(const CEntry& slot, const uint256& entry);
+    static bool IsEmpty(const CEntry& slot);
+
+public:
+    CSignatureCache();
+
+    /** Allocate a table of at most nMaxBytes, dropping all entries.
+     *  Must not be called while other threads use the cache.
+     *  Returns the number of entries the table can hold.
+     */
+    size_t Setup(size_t nMaxBytes);
+
+    /** Salted digest identifying a signature check */
+    void ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const;
+
+    bool Get(const uint256& entry) const;
+    void Set(const uint256& entry);
+};
+
+/** Cache shared by all script verification */
+extern CSignatureCache signatureCache;
+
+/** Size the signature cache used by script verification from -maxsigcachesize */
+void InitSignatureCache();
+
+#endif
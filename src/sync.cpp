@@ -6,7 +6,10 @@
 
 #include "util.h"
 
+#include <map>
+
 #include <boost/foreach.hpp>
+#include <boost/thread/tss.hpp>
 
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
@@ -16,6 +19,170 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+//
+// Lock profiling.
+// Each thread counts into its own block of counters, indexed by site, so
+// recording never contends; the blocks are only summed when stats are
+// read. A block is handed to the next new thread when its thread exits,
+// so its counts are kept and blocks are never freed.
+//
+
+std::atomic<bool> fLockProfiling(false);
+
+static const int MAX_LOCK_SITES = 1024;
+
+struct CLockSiteCounters
+{
+    std::atomic<uint64_t> nAcquired;
+    std::atomic<uint64_t> nContended;
+    std::atomic<uint64_t> nWaitNanos;
+    std::atomic<uint64_t> nHoldNanos;
+};
+
+struct CLockThreadCounters
+{
+    CLockSiteCounters sites[MAX_LOCK_SITES];
+};
+
+static boost::mutex csLockProfile;
+// Sites by id; the same file, line and name share an id even when the
+// macro was expanded in more than one translation unit
+static std::vector<CLockSiteStats> vLockSites;
+static std::map<std::pair<std::string, int>, int> mapLockSiteIds;
+static std::vector<CLockThreadCounters*> vLockCounters;
+static std::vector<CLockThreadCounters*> vFreeLockCounters;
+// Totals at the last reset
+static std::vector<CLockSiteStats> vLockBaseline;
+
+static void ReleaseLockCounters(CLockThreadCounters* pcounters)
+{
+    boost::lock_guard<boost::mutex> lock(csLockProfile);
+    vFreeLockCounters.push_back(pcounters);
+}
+
+static boost::thread_specific_ptr<CLockThreadCounters> lockCounters(ReleaseLockCounters);
+
+static CLockThreadCounters* GetLockCounters()
+{
+    CLockThreadCounters* pcounters = lockCounters.get();
+    if (pcounters)
+        return pcounters;
+
+    {
+        boost::lock_guard<boost::mutex> lock(csLockProfile);
+        if (!vFreeLockCounters.empty()) {
+            pcounters = vFreeLockCounters.back();
+            vFreeLockCounters.pop_back();
+        } else {
+            pcounters = new CLockThreadCounters();
+            for (int i = 0; i < MAX_LOCK_SITES; i++) {
+                CLockSiteCounters& c = pcounters->sites[i];
+                c.nAcquired = c.nContended = c.nWaitNanos = c.nHoldNanos = 0;
+            }
+            vLockCounters.push_back(pcounters);
+        }
+    }
+    lockCounters.reset(pcounters);
+    return pcounters;
+}
+
+static int RegisterLockSite(CLockSite& site)
+{
+    boost::lock_guard<boost::mutex> lock(csLockProfile);
+    int nId = site.nId.load(std::memory_order_relaxed);
+    if (nId != -1)
+        return nId;
+
+    std::pair<std::string, int> key(strprintf("%s %s", site.pszName, site.pszFile), site.nLine);
+    std::map<std::pair<std::string, int>, int>::iterator it = mapLockSiteIds.find(key);
+    if (it != mapLockSiteIds.end()) {
+        nId = it->second;
+    } else if (vLockSites.size() < (size_t)MAX_LOCK_SITES) {
+        nId = vLockSites.size();
+        CLockSiteStats stats = {site.pszName, site.pszFile, site.nLine, 0, 0, 0, 0};
+        vLockSites.push_back(stats);
+        vLockBaseline.push_back(stats);
+        mapLockSiteIds[key] = nId;
+    } else {
+        // Out of slots: stop trying for this site
+        nId = -2;
+    }
+    site.nId.store(nId, std::memory_order_release);
+    return nId;
+}
+
+// Only the owning thread writes its counters, so there is no need for an
+// atomic read-modify-write
+static inline void AddCounter(std::atomic<uint64_t>& n, uint64_t nAdd)
+{
+    n.store(n.load(std::memory_order_relaxed) + nAdd, std::memory_order_relaxed);
+}
+
+void RecordLockSite(CLockSite& site, bool fAcquired, bool fContended, int64_t nWaitNanos, int64_t nHoldNanos)
+{
+    int nId = site.nId.load(std::memory_order_acquire);
+    if (nId == -1)
+        nId = RegisterLockSite(site);
+    if (nId < 0)
+        return;
+
+    CLockSiteCounters& c = GetLockCounters()->sites[nId];
+    if (fAcquired)
+        AddCounter(c.nAcquired, 1);
+    if (fContended)
+        AddCounter(c.nContended, 1);
+    if (nWaitNanos > 0)
+        AddCounter(c.nWaitNanos, nWaitNanos);
+    if (nHoldNanos > 0)
+        AddCounter(c.nHoldNanos, nHoldNanos);
+}
+
+void SetLockProfiling(bool fEnable)
+{
+    fLockProfiling.store(fEnable, std::memory_order_relaxed);
+}
+
+// Caller holds csLockProfile
+static void SumLockCounters(std::vector<CLockSiteStats>& vTotals)
+{
+    vTotals = vLockSites;
+    BOOST_FOREACH(CLockThreadCounters* pcounters, vLockCounters) {
+        for (size_t i = 0; i < vTotals.size(); i++) {
+            const CLockSiteCounters& c = pcounters->sites[i];
+            vTotals[i].nAcquired += c.nAcquired.load(std::memory_order_relaxed);
+            vTotals[i].nContended += c.nContended.load(std::memory_order_relaxed);
+            vTotals[i].nWaitNanos += c.nWaitNanos.load(std::memory_order_relaxed);
+            vTotals[i].nHoldNanos += c.nHoldNanos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void GetLockStats(std::vector<CLockSiteStats>& vStats)
+{
+    boost::lock_guard<boost::mutex> lock(csLockProfile);
+    std::vector<CLockSiteStats> vTotals;
+    SumLockCounters(vTotals);
+
+    vStats.clear();
+    for (size_t i = 0; i < vTotals.size(); i++) {
+        CLockSiteStats stats = vTotals[i];
+        stats.nAcquired -= vLockBaseline[i].nAcquired;
+        stats.nContended -= vLockBaseline[i].nContended;
+        stats.nWaitNanos -= vLockBaseline[i].nWaitNanos;
+        stats.nHoldNanos -= vLockBaseline[i].nHoldNanos;
+        if (stats.nAcquired || stats.nContended)
+            vStats.push_back(stats);
+    }
+}
+
+void ResetLockStats()
+{
+    // Counters belong to their threads, so rather than zeroing them the
+    // current totals become the baseline
+    boost::lock_guard<boost::mutex> lock(csLockProfile);
+    SumLockCounters(vLockBaseline);
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
@@ -8,6 +8,13 @@
 
 #include "threadsafety.h"
 
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
@@ -100,16 +107,69 @@ void static inline AssertLockHeldInternal(const char* pszName, const char* pszFi
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** A LOCK or TRY_LOCK in the source. Each expansion of the macros owns a
+ *  static one, which the lock profiler keys its counters on. */
+struct CLockSite
+{
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+    // Index into the profiler's counters, assigned on first use
+    std::atomic<int> nId;
+
+    constexpr CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn) :
+        pszName(pszNameIn), pszFile(pszFileIn), nLine(nLineIn), nId(-1) {}
+};
+
+/** Lock profiling: while enabled, every LOCK and TRY_LOCK counts its
+ *  acquisitions, how many had to wait, the time spent waiting and the time
+ *  the lock was held, in per-thread counters that are only summed when
+ *  read. Disabled it costs one relaxed load per lock. */
+extern std::atomic<bool> fLockProfiling;
+
+void SetLockProfiling(bool fEnable);
+void RecordLockSite(CLockSite& site, bool fAcquired, bool fContended, int64_t nWaitNanos, int64_t nHoldNanos);
+
+static inline int64_t LockProfileTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct CLockSiteStats
+{
+    std::string strName;
+    std::string strFile;
+    int nLine;
+    uint64_t nAcquired;
+    uint64_t nContended;
+    uint64_t nWaitNanos;
+    uint64_t nHoldNanos;
+};
+
+/** Totals per site since the last reset, for sites used at least once */
+void GetLockStats(std::vector<CLockSiteStats>& vStats);
+void ResetLockStats();
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template<typename Mutex>
 class CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+    CLockSite* psite;
+    // When profiled: time the lock was acquired, and the wait before it
+    int64_t nLockedAt;
+    int64_t nWaitNanos;
+    bool fContended;
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+        if (psite && fLockProfiling.load(std::memory_order_relaxed))
+        {
+            EnterProfiled(pszName, pszFile, nLine);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock())
         {
@@ -121,17 +181,42 @@ private:
 #endif
     }
 
+    void EnterProfiled(const char* pszName, const char* pszFile, int nLine)
+    {
+        if (lock.try_lock())
+        {
+            nLockedAt = LockProfileTime();
+            return;
+        }
+#ifdef DEBUG_LOCKCONTENTION
+        PrintLockContention(pszName, pszFile, nLine);
+#endif
+        int64_t nStart = LockProfileTime();
+        lock.lock();
+        nLockedAt = LockProfileTime();
+        nWaitNanos = nLockedAt - nStart;
+        fContended = true;
+    }
+
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()), true);
         lock.try_lock();
+        if (psite && fLockProfiling.load(std::memory_order_relaxed))
+        {
+            if (lock.owns_lock())
+                nLockedAt = LockProfileTime();
+            else
+                RecordLockSite(*psite, false, true, 0, 0);
+        }
         if (!lock.owns_lock())
             LeaveCritical();
         return lock.owns_lock();
     }
 
 public:
-    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) : lock(mutexIn, boost::defer_lock)
+    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false, CLockSite* psiteIn = NULL) :
+        lock(mutexIn, boost::defer_lock), psite(psiteIn), nLockedAt(0), nWaitNanos(0), fContended(false)
     {
         if (fTry)
             TryEnter(pszName, pszFile, nLine);
@@ -142,7 +227,11 @@ public:
     ~CMutexLock()
     {
         if (lock.owns_lock())
+        {
+            if (nLockedAt)
+                RecordLockSite(*psite, true, fContended, nWaitNanos, LockProfileTime() - nLockedAt);
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -153,9 +242,11 @@ public:
 
 typedef CMutexLock<CCriticalSection> CCriticalBlock;
 
-#define LOCK(cs) CCriticalBlock criticalblock(cs, #cs, __FILE__, __LINE__)
-#define LOCK2(cs1,cs2) CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__),criticalblock2(cs2, #cs2, __FILE__, __LINE__)
-#define TRY_LOCK(cs,name) CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true)
+#define LOCK_SITE(cs) ([]() -> CLockSite* { static CLockSite site(#cs, __FILE__, __LINE__); return &site; }())
+
+#define LOCK(cs) CCriticalBlock criticalblock(cs, #cs, __FILE__, __LINE__, false, LOCK_SITE(cs))
+#define LOCK2(cs1,cs2) CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__, false, LOCK_SITE(cs1)),criticalblock2(cs2, #cs2, __FILE__, __LINE__, false, LOCK_SITE(cs2))
+#define TRY_LOCK(cs,name) CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true, LOCK_SITE(cs))
 
 #define ENTER_CRITICAL_SECTION(cs) \
     { \
@@ -0,0 +1,175 @@
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "logdb.h"
+#include "util.h"
+
+using namespace std;
+
+static CSerializeData Data(const string& str)
+{
+    return CSerializeData(str.begin(), str.end());
+}
+
+static string Get(const CLogDB& db, const string& strKey)
+{
+    CSerializeData value;
+    if (!db.Read(Data(strKey), value))
+        return "<none>";
+    return string(value.begin(), value.end());
+}
+
+struct LogDBSetup
+{
+    boost::filesystem::path path;
+
+    LogDBSetup()
+    {
+        path = boost::filesystem::temp_directory_path() / strprintf("test_monkey_logdb_%lu", (unsigned long)GetRand(100000000));
+        boost::filesystem::remove(path);
+    }
+    ~LogDBSetup()
+    {
+        boost::filesystem::remove(path);
+        boost::filesystem::remove(path.string() + ".bad");
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(logdb_tests, LogDBSetup)
+
+BOOST_AUTO_TEST_CASE(logdb_write_reload)
+{
+    {
+        CLogDB db(path);
+        BOOST_CHECK(db.Load());
+        CLogDBBatch batch;
+        batch.Write(Data("a"), Data("1"));
+        batch.Write(Data("b"), Data("2"));
+        BOOST_CHECK(db.Write(batch));
+        batch.Clear();
+        batch.Write(Data("a"), Data("3"));
+        batch.Erase(Data("b"));
+        BOOST_CHECK(db.Write(batch));
+        BOOST_CHECK_EQUAL(Get(db, "a"), "3");
+        BOOST_CHECK(!db.Exists(Data("b")));
+    }
+
+    CLogDB db(path);
+    BOOST_CHECK(db.Load());
+    BOOST_CHECK_EQUAL(Get(db, "a"), "3");
+    BOOST_CHECK_EQUAL(Get(db, "b"), "<none>");
+}
+
+BOOST_AUTO_TEST_CASE(logdb_seek_order)
+{
+    // Keys come back in byte order, with bytes above 0x7f last
+    CLogDB db(path);
+    BOOST_CHECK(db.Load());
+    CLogDBBatch batch;
+    batch.Write(Data("\x80"), Data("x"));
+    batch.Write(Data("ab"), Data("x"));
+    batch.Write(Data("a"), Data("x"));
+    batch.Write(Data("b"), Data("x"));
+    BOOST_CHECK(db.Write(batch));
+
+    vector<string> vKeys;
+    CSerializeData key, value;
+    bool fAfter = false;
+    while (db.Seek(key, fAfter, key, value))
+    {
+        vKeys.push_back(string(key.begin(), key.end()));
+        fAfter = true;
+    }
+    BOOST_CHECK_EQUAL(vKeys.size(), 4U);
+    BOOST_CHECK(vKeys[0] == "a" && vKeys[1] == "ab" && vKeys[2] == "b" && vKeys[3] == "\x80");
+
+    BOOST_CHECK(db.Seek(Data("aa"), false, key, value));
+    BOOST_CHECK(string(key.begin(), key.end()) == "ab");
+}
+
+BOOST_AUTO_TEST_CASE(logdb_torn_batch)
+{
+    uintmax_t nSize;
+    {
+        CLogDB db(path);
+        BOOST_CHECK(db.Load());
+        CLogDBBatch batch;
+        batch.Write(Data("a"), Data("1"));
+        BOOST_CHECK(db.Write(batch));
+        nSize = boost::filesystem::file_size(path);
+        batch.Clear();
+        batch.Write(Data("a"), Data("2"));
+        batch.Write(Data("b"), Data("2"));
+        BOOST_CHECK(db.Write(batch));
+    }
+
+    // Cutting the second batch short loses all of it, and only it
+    boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 3);
+    CLogDB db(path);
+    BOOST_CHECK(db.Load());
+    BOOST_CHECK_EQUAL(Get(db, "a"), "1");
+    BOOST_CHECK_EQUAL(Get(db, "b"), "<none>");
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), nSize);
+    // The discarded bytes are kept aside
+    BOOST_CHECK(boost::filesystem::exists(path.string() + ".bad"));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_bad_length)
+{
+    uintmax_t nFirst, nSize;
+    {
+        CLogDB db(path);
+        BOOST_CHECK(db.Load());
+        nFirst = boost::filesystem::file_size(path);
+        for (int i = 0; i < 3; i++)
+        {
+            CLogDBBatch batch;
+            batch.Write(Data(strprintf("k%d", i)), Data("v"));
+            BOOST_CHECK(db.Write(batch));
+        }
+        nSize = boost::filesystem::file_size(path);
+    }
+
+    // A length in the middle pointing past the end is damage, not a torn
+    // write: the load fails and nothing is cut off
+    FILE* file = fopen(path.string().c_str(), "r+b");
+    BOOST_REQUIRE(file);
+    unsigned char length[4] = { 0xff, 0xff, 0xff, 0x00 };
+    BOOST_CHECK(fseek(file, nFirst, SEEK_SET) == 0);
+    BOOST_CHECK(fwrite(length, 1, sizeof(length), file) == sizeof(length));
+    fclose(file);
+
+    CLogDB db(path);
+    BOOST_CHECK(!db.Load());
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), nSize);
+}
+
+BOOST_AUTO_TEST_CASE(logdb_compact)
+{
+    CLogDB db(path);
+    BOOST_CHECK(db.Load());
+    CLogDBBatch batch;
+    for (int i = 0; i < 100; i++)
+    {
+        batch.Clear();
+        batch.Write(Data("key"), Data(strprintf("%d", i)));
+        batch.Write(Data(strprintf("\x04pool%d", i)), Data("x"));
+        BOOST_CHECK(db.Write(batch));
+    }
+    uintmax_t nSize = boost::filesystem::file_size(path);
+
+    BOOST_CHECK(db.Compact("\x04pool"));
+    BOOST_CHECK(boost::filesystem::file_size(path) < nSize / 10);
+    BOOST_CHECK_EQUAL(Get(db, "key"), "99");
+    BOOST_CHECK(!db.Exists(Data("\x04pool5")));
+
+    // Appends after compaction land in the new file
+    batch.Clear();
+    batch.Write(Data("key"), Data("last"));
+    BOOST_CHECK(db.Write(batch));
+    CLogDB db2(path);
+    BOOST_CHECK(db2.Load());
+    BOOST_CHECK_EQUAL(Get(db2, "key"), "last");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
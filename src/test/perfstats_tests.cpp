@@ -0,0 +1,68 @@
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+#include "perfstats.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(perfstats_tests)
+
+BOOST_AUTO_TEST_CASE(perfhistogram_percentiles)
+{
+    CPerfHistogram histogram;
+    CPerfSummary summary;
+    histogram.GetSummary(summary);
+    BOOST_CHECK_EQUAL(summary.nCount, 0U);
+    BOOST_CHECK_EQUAL(summary.nP99, 0U);
+
+    // Small values have a bucket each
+    for (int i = 0; i < 100; i++)
+        histogram.Add(i % 4);
+    histogram.GetSummary(summary);
+    BOOST_CHECK_EQUAL(summary.nCount, 100U);
+    BOOST_CHECK_EQUAL(summary.nTotal, 150U);
+    BOOST_CHECK_EQUAL(summary.nP50, 2U);
+    BOOST_CHECK_EQUAL(summary.nMax, 3U);
+
+    // Larger values are reported within 25%, never above the maximum
+    histogram.Reset();
+    for (int i = 1; i <= 1000; i++)
+        histogram.Add(i * 100);
+    histogram.GetSummary(summary);
+    BOOST_CHECK(summary.nP50 >= 50000 && summary.nP50 <= 62500);
+    BOOST_CHECK(summary.nP90 >= 90000 && summary.nP90 <= 112500);
+    BOOST_CHECK(summary.nP99 >= 99000 && summary.nP99 <= 100000);
+    BOOST_CHECK_EQUAL(summary.nMax, 100000U);
+
+    // Negative durations from a clock step count as zero
+    histogram.Reset();
+    histogram.Add(-5);
+    histogram.Add((int64_t)1 << 62);
+    histogram.GetSummary(summary);
+    BOOST_CHECK_EQUAL(summary.nCount, 2U);
+    BOOST_CHECK_EQUAL(summary.nP50, (uint64_t)1 << 62);
+}
+
+BOOST_AUTO_TEST_CASE(perfstats_messages)
+{
+    ResetPerfStats();
+    {
+        CPerfTimer timer(GetMessagePerfHistogram("ping"));
+    }
+    BOOST_CHECK_EQUAL(&GetMessagePerfHistogram("ping"), &GetMessagePerfHistogram("ping"));
+
+    vector<pair<string, CPerfSummary> > vSummaries;
+    GetMessagePerfSummaries(vSummaries);
+    BOOST_REQUIRE_EQUAL(vSummaries.size(), 1U);
+    BOOST_CHECK_EQUAL(vSummaries[0].first, "ping");
+    BOOST_CHECK_EQUAL(vSummaries[0].second.nCount, 1U);
+
+    // Distinct commands are capped
+    for (int i = 0; i < 100; i++)
+        GetMessagePerfHistogram(strprintf("cmd%d", i));
+    GetMessagePerfSummaries(vSummaries);
+    BOOST_CHECK_EQUAL(vSummaries.size(), 65U);
+    BOOST_CHECK_EQUAL(&GetMessagePerfHistogram("cmd99"), &GetMessagePerfHistogram("*other*"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
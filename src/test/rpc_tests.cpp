@@ -3,6 +3,7 @@
 
 #include "base58.h"
 #include "util.h"
+#include "rpcjson.h"
 #include "rpcserver.h"
 
 using namespace std;
@@ -59,4 +60,69 @@ BOOST_AUTO_TEST_CASE(rpc_addmultisig)
     BOOST_CHECK_THROW(addmultisig(createArgs(2, short2), false), runtime_error);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_json_write)
+{
+    // The fast writer must produce exactly what json_spirit does
+    Object obj;
+    obj.push_back(Pair("str", string("a\"b\\c\n\x01\x7f\xe9/")));
+    obj.push_back(Pair("int", -1234567));
+    obj.push_back(Pair("int64", (int64_t)-9223372036854775807LL - 1));
+    obj.push_back(Pair("uint64", (uint64_t)18446744073709551615ULL));
+    obj.push_back(Pair("bool", true));
+    obj.push_back(Pair("null", Value::null));
+    Array arr;
+    arr.push_back(0.0);
+    arr.push_back(-0.5);
+    arr.push_back(ValueFromAmount(2099999999999999LL));
+    arr.push_back(ValueFromAmount(-1));
+    arr.push_back(12345678.123456785);
+    arr.push_back(1e20);
+    arr.push_back(Object());
+    arr.push_back(Array());
+    obj.push_back(Pair("arr", arr));
+
+    BOOST_CHECK_EQUAL(JSONWrite(obj), write_string(Value(obj), false));
+}
+
+BOOST_AUTO_TEST_CASE(rpc_json_read)
+{
+    const char* vstrValid[] = {
+        "{\"method\":\"getblock\",\"params\":[\"00ff\",true],\"id\":1}",
+        " [1, -2, +3, 1.5, .5, 5., 1e3, -0, 9223372036854775808, -9223372036854775808] ",
+        "{\"a\\u00e9\\x41\\/\\q\":null,\"b\":{}}",
+        "[true,false,null]trailing",
+        "\"\\u12\"",
+    };
+    BOOST_FOREACH(const char* psz, vstrValid)
+    {
+        Value v1, v2;
+        BOOST_CHECK(read_string(string(psz), v1));
+        BOOST_CHECK(JSONRead(psz, v2));
+        BOOST_CHECK_EQUAL(write_string(v1, false), write_string(v2, false));
+    }
+
+    const char* vstrInvalid[] = { "", "[1,]", "{\"a\" 1}", "\"\\", "[", "-", "18446744073709551616", "{\"a\":}" };
+    BOOST_FOREACH(const char* psz, vstrInvalid)
+    {
+        Value v;
+        BOOST_CHECK(!JSONRead(psz, v));
+    }
+
+    // Deep nesting is refused instead of recursing without bound
+    Value v;
+    BOOST_CHECK(!JSONRead(string(100000, '['), v));
+}
+
+BOOST_AUTO_TEST_CASE(rpc_json_writer)
+{
+    CJSONWriter writer;
+    writer.BeginObject();
+    writer.Key("a").BeginArray().Int(1).String("x").BeginObject().EndObject().EndArray();
+    writer.Key("b").Null();
+    writer.Key("c").Raw("[2,3]");
+    writer.Key("d").Value(ValueFromAmount(150000000));
+    writer.EndObject();
+    BOOST_CHECK_EQUAL(writer.str(), "{\"a\":[1,\"x\",{}],\"b\":null,\"c\":[2,3],\"d\":1.50000000}");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
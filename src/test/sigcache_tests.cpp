@@ -0,0 +1,57 @@
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+#include "sigcache.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(sigcache_tests)
+
+BOOST_AUTO_TEST_CASE(sigcache_unsized)
+{
+    // A cache that was never set up stores nothing
+    CSignatureCache cache;
+    uint256 entry = GetRandHash();
+    cache.Set(entry);
+    BOOST_CHECK(!cache.Get(entry));
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_insert_lookup)
+{
+    CSignatureCache cache;
+    size_t nEntries = cache.Setup(1 << 20);
+    BOOST_CHECK_EQUAL(nEntries, (size_t)(1 << 20) / 32);
+
+    // Well below capacity nearly everything inserted is found
+    vector<uint256> vEntries;
+    for (int i = 0; i < 1000; i++)
+    {
+        vEntries.push_back(GetRandHash());
+        cache.Set(vEntries.back());
+    }
+    int nFound = 0;
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        if (cache.Get(entry))
+            nFound++;
+    BOOST_CHECK(nFound >= 995);
+
+    for (int i = 0; i < 1000; i++)
+        BOOST_CHECK(!cache.Get(GetRandHash()));
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_eviction)
+{
+    // Filling the table many times over keeps it bounded and keeps the
+    // most recent inserts reachable
+    CSignatureCache cache;
+    size_t nEntries = cache.Setup(64 * 1024);
+    for (size_t i = 0; i < nEntries * 4; i++)
+        cache.Set(GetRandHash());
+
+    uint256 entry = GetRandHash();
+    cache.Set(entry);
+    BOOST_CHECK(cache.Get(entry));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
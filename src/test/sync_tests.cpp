@@ -0,0 +1,76 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+#include "sync.h"
+
+BOOST_AUTO_TEST_SUITE(sync_tests)
+
+static CCriticalSection csProfiled;
+static int nProfiledCount = 0;
+static CCriticalSection csTry;
+
+static void LockProfiled(int nTimes)
+{
+    for (int i = 0; i < nTimes; i++)
+    {
+        LOCK(csProfiled);
+        nProfiledCount++;
+    }
+}
+
+static const CLockSiteStats* FindSite(const vector<CLockSiteStats>& vStats, const string& strName)
+{
+    for (unsigned int i = 0; i < vStats.size(); i++)
+        if (vStats[i].strName == strName)
+            return &vStats[i];
+    return NULL;
+}
+
+BOOST_AUTO_TEST_CASE(lockprofile_counts)
+{
+    SetLockProfiling(true);
+    ResetLockStats();
+
+    LockProfiled(100);
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(LockProfiled, 1000));
+    threads.join_all();
+
+    vector<CLockSiteStats> vStats;
+    GetLockStats(vStats);
+    const CLockSiteStats* psite = FindSite(vStats, "csProfiled");
+    BOOST_REQUIRE(psite);
+    // Counts from threads that have exited are kept
+    BOOST_CHECK_EQUAL(psite->nAcquired, 4100U);
+    BOOST_CHECK(psite->nContended <= psite->nAcquired);
+
+    // A failed TRY_LOCK counts as contended without an acquisition
+    {
+        LOCK(csTry);
+        boost::thread thread([]() { TRY_LOCK(csTry, lockTry); BOOST_CHECK(!lockTry); });
+        thread.join();
+    }
+    GetLockStats(vStats);
+    BOOST_REQUIRE(FindSite(vStats, "csTry"));
+    BOOST_CHECK_EQUAL(FindSite(vStats, "csTry")->nContended, 1U);
+
+    ResetLockStats();
+    GetLockStats(vStats);
+    BOOST_CHECK(!FindSite(vStats, "csProfiled"));
+
+    LockProfiled(10);
+    GetLockStats(vStats);
+    BOOST_REQUIRE(FindSite(vStats, "csProfiled"));
+    BOOST_CHECK_EQUAL(FindSite(vStats, "csProfiled")->nAcquired, 10U);
+
+    // Nothing is recorded while profiling is off
+    SetLockProfiling(false);
+    LockProfiled(10);
+    GetLockStats(vStats);
+    BOOST_CHECK_EQUAL(FindSite(vStats, "csProfiled")->nAcquired, 10U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file license.txt or http://www.opensource.org/licenses/mit-license.php.
 
+#include <atomic>
 #include <map>
 
 #include <boost/version.hpp>
@@ -20,17 +21,114 @@
 #include "util.h"
 #include "main.h"
 #include "chainparams.h"
+#include "perfstats.h"
 
 using namespace std;
 using namespace boost;
 
 leveldb::DB *txdb; // global pointer for LevelDB object instance
 
+static const CDBTuning dbProfiles[] = {
+    //  profile    cache  wbuf  files  block  file   L0: compact  slow  stop   compress  sync
+    // The LevelDB defaults this node has always used
+    { "steady",    100,   4,    1000,  4,     2,          4,      8,    12,    false,    false },
+    // Bulk writes during initial sync: a large memtable and more level-0
+    // files before compaction or write stalls kick in
+    { "sync",      256,   64,   1000,  4,     8,          8,      16,   24,    false,    false },
+    { "lowmem",    16,    2,    128,   4,     2,          4,      8,    12,    false,    false },
+};
+
+static CDBTuning dbTuning = dbProfiles[0];
+
+const CDBTuning* FindDBProfile(const std::string& strProfile)
+{
+    for (unsigned int i = 0; i < sizeof(dbProfiles) / sizeof(dbProfiles[0]); i++)
+        if (strProfile == dbProfiles[i].pszProfile)
+            return &dbProfiles[i];
+    return NULL;
+}
+
+const CDBTuning& GetDBTuning()
+{
+    return dbTuning;
+}
+
+// Block cache that counts lookups, so hit rates can be reported
+class CCountingCache : public leveldb::Cache
+{
+private:
+    leveldb::Cache* pcache;
+
+public:
+    std::atomic<uint64_t> nLookups;
+    std::atomic<uint64_t> nHits;
+    size_t nCapacity;
+
+    CCountingCache(size_t nCapacityIn) : pcache(leveldb::NewLRUCache(nCapacityIn)), nLookups(0), nHits(0), nCapacity(nCapacityIn) {}
+    ~CCountingCache() { delete pcache; }
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge, void (*deleter)(const leveldb::Slice& key, void* value)) {
+        return pcache->Insert(key, value, charge, deleter);
+    }
+    Handle* Lookup(const leveldb::Slice& key) {
+        Handle* handle = pcache->Lookup(key);
+        nLookups.fetch_add(1, std::memory_order_relaxed);
+        if (handle)
+            nHits.fetch_add(1, std::memory_order_relaxed);
+        return handle;
+    }
+    void Release(Handle* handle) { pcache->Release(handle); }
+    void* Value(Handle* handle) { return pcache->Value(handle); }
+    void Erase(const leveldb::Slice& key) { pcache->Erase(key); }
+    uint64_t NewId() { return pcache->NewId(); }
+};
+
+static CCountingCache* pblockcache = NULL;
+
+bool GetDBCacheStats(uint64_t& nLookups, uint64_t& nHits, uint64_t& nCapacity)
+{
+    if (!pblockcache)
+        return false;
+    nLookups = pblockcache->nLookups.load(std::memory_order_relaxed);
+    nHits = pblockcache->nHits.load(std::memory_order_relaxed);
+    nCapacity = pblockcache->nCapacity;
+    return true;
+}
+
 static leveldb::Options GetOptions() {
+    // Start from the profile, then let the individual options refine it
+    const CDBTuning* pprofile = FindDBProfile(GetArg("-dbprofile", DEFAULT_DB_PROFILE));
+    dbTuning = pprofile ? *pprofile : dbProfiles[0];
+    dbTuning.nCacheMB = GetArg("-dbcache", dbTuning.nCacheMB);
+    dbTuning.nWriteBufferMB = GetArg("-dbwritebuffer", dbTuning.nWriteBufferMB);
+    dbTuning.nMaxOpenFiles = GetArg("-dbmaxopenfiles", dbTuning.nMaxOpenFiles);
+    dbTuning.nBlockSizeKB = GetArg("-dbblocksize", dbTuning.nBlockSizeKB);
+    dbTuning.nFileSizeMB = GetArg("-dbfilesize", dbTuning.nFileSizeMB);
+    dbTuning.nL0CompactionTrigger = GetArg("-dbl0compaction", dbTuning.nL0CompactionTrigger);
+    dbTuning.nL0SlowdownTrigger = std::max(dbTuning.nL0CompactionTrigger, (int)GetArg("-dbl0slowdown", dbTuning.nL0SlowdownTrigger));
+    dbTuning.nL0StopTrigger = std::max(dbTuning.nL0SlowdownTrigger, (int)GetArg("-dbl0stop", dbTuning.nL0StopTrigger));
+    dbTuning.fCompression = GetBoolArg("-dbcompression", dbTuning.fCompression);
+    dbTuning.fSync = GetBoolArg("-dbsync", dbTuning.fSync);
+
     leveldb::Options options;
-    int nCacheSizeMB = GetArg("-dbcache", 100);
-    options.block_cache = leveldb::NewLRUCache(nCacheSizeMB * 1048576);
+    pblockcache = new CCountingCache(std::max(1, dbTuning.nCacheMB) * 1048576);
+    options.block_cache = pblockcache;
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.write_buffer_size = std::max(1, dbTuning.nWriteBufferMB) * 1048576;
+    options.max_open_files = dbTuning.nMaxOpenFiles;
+    options.block_size = std::max(1, dbTuning.nBlockSizeKB) * 1024;
+    options.max_file_size = std::max(1, dbTuning.nFileSizeMB) * 1048576;
+    options.l0_compaction_trigger = dbTuning.nL0CompactionTrigger;
+    options.l0_slowdown_writes_trigger = dbTuning.nL0SlowdownTrigger;
+    options.l0_stop_writes_trigger = dbTuning.nL0StopTrigger;
+    // Each block records how it was stored, so uncompressed tables stay
+    // readable with compression on. Compressed ones cannot be read by
+    // binaries without a Snappy codec, hence off by default.
+    options.compression = dbTuning.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+
+    LogPrintf("LevelDB profile %s: cache %dMB, write buffer %dMB, %d open files, %dKB blocks, %dMB files, L0 %d/%d/%d, compression %d, sync %d\n",
+        dbTuning.pszProfile, dbTuning.nCacheMB, dbTuning.nWriteBufferMB, dbTuning.nMaxOpenFiles, dbTuning.nBlockSizeKB, dbTuning.nFileSizeMB,
+        dbTuning.nL0CompactionTrigger, dbTuning.nL0SlowdownTrigger, dbTuning.nL0StopTrigger, dbTuning.fCompression, dbTuning.fSync);
     return options;
 }
 
@@ -79,7 +177,6 @@ CTxDB::CTxDB(const char* pszMode)
 
     options = GetOptions();
     options.create_if_missing = fCreate;
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
 
     init_blockindex(options); // Init directory
     pdb = txdb;
@@ -123,6 +220,7 @@ void CTxDB::Close()
     options.filter_policy = NULL;
     delete options.block_cache;
     options.block_cache = NULL;
+    pblockcache = NULL;
     delete activeBatch;
     activeBatch = NULL;
 }
@@ -137,7 +235,12 @@ bool CTxDB::TxnBegin()
 bool CTxDB::TxnCommit()
 {
     assert(activeBatch);
-    leveldb::Status status = pdb->Write(leveldb::WriteOptions(), activeBatch);
+    PERF_TIMER(PERF_TXDBCOMMIT);
+    // Make each connected block durable once the chain has caught up;
+    // during initial sync a crash only costs re-downloading a few blocks
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = dbTuning.fSync && !IsInitialBlockDownload();
+    leveldb::Status status = pdb->Write(writeOptions, activeBatch);
     delete activeBatch;
     activeBatch = NULL;
     if (!status.ok()) {
@@ -429,4 +532,25 @@ bool CTxDB::ReadFlag(const std::string& name, bool& fValue)
         return false;
     fValue = ch == '1';
     return true;
-}
\ No newline at end of file
+}
+
+bool CTxDB::GetProperty(const std::string& strName, std::string& strValue)
+{
+    return pdb->GetProperty(strName, &strValue);
+}
+
+uint64_t CTxDB::GetApproximateSize(const std::string& strPrefix)
+{
+    // Keys start with the serialized type string, so all keys of a type
+    // sort between it and the same bytes with the last one incremented
+    CDataStream ssStart(SER_DISK, CLIENT_VERSION);
+    ssStart << strPrefix;
+    std::string strStart = ssStart.str();
+    std::string strLimit = strStart;
+    strLimit[strLimit.size() - 1]++;
+
+    leveldb::Range range(strStart, strLimit);
+    uint64_t nSize = 0;
+    pdb->GetApproximateSizes(&range, 1, &nSize);
+    return nSize;
+}
@@ -15,6 +15,33 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+static const char* const DEFAULT_DB_PROFILE = "steady";
+
+/** Options the index database is opened with: a profile from -dbprofile,
+ *  refined by the individual -db* options */
+struct CDBTuning
+{
+    const char* pszProfile;
+    int nCacheMB;
+    int nWriteBufferMB;
+    int nMaxOpenFiles;
+    int nBlockSizeKB;
+    int nFileSizeMB;
+    int nL0CompactionTrigger;
+    int nL0SlowdownTrigger;
+    int nL0StopTrigger;
+    bool fCompression;
+    // Sync block commits to disk once out of initial block download
+    bool fSync;
+};
+
+/** Returns NULL for an unknown profile name */
+const CDBTuning* FindDBProfile(const std::string& strProfile);
+/** Tuning in effect since the database was opened */
+const CDBTuning& GetDBTuning();
+/** Block cache lookups and hits since the database was opened */
+bool GetDBCacheStats(uint64_t& nLookups, uint64_t& nHits, uint64_t& nCapacity);
+
 // Class that provides access to a LevelDB. Note that this class is frequently
 // instantiated on the stack and then destroyed again, so instantiation has to
 // be very cheap. Unfortunately that means, a CTxDB instance is actually just a
@@ -205,6 +232,10 @@ public:
 
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
+
+    // Introspection for getdbstats
+    bool GetProperty(const std::string& strName, std::string& strValue);
+    uint64_t GetApproximateSize(const std::string& strPrefix);
 };
 
 
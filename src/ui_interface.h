@@ -84,6 +84,12 @@ public:
     /** Translate a message to the native language of the user. */
     boost::signals2::signal<std::string (const char* psz)> Translate;
 
+    /**
+     * New best block.
+     * @note called with lock cs_main held.
+     */
+    boost::signals2::signal<void (int nHeight, int64_t nTime)> NotifyBlockTip;
+
     /** Number of network connections changed. */
     boost::signals2::signal<void (int newNumConnections)> NotifyNumConnectionsChanged;
 
@@ -14,6 +14,10 @@
 #include "allocators.h"
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include <signal.h>
 
 
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -275,6 +279,227 @@ static boost::once_flag debugPrintInitFlag = BOOST_ONCE_INIT;
 static FILE* fileout = NULL;
 static boost::mutex* mutexDebugLog = NULL;
 
+/** Lines waiting for the log writer thread */
+static const size_t LOG_QUEUE_SIZE = 4096;
+/** The writer hands the file this much at a time */
+static const size_t LOG_WRITE_BATCH = 64 * 1024;
+
+/**
+ * Bounded multi-producer queue of log lines. Producers claim a cell with a
+ * compare-and-swap on the enqueue position and never take a lock; each cell's
+ * sequence number tells whether it is free to write or ready to read.
+ */
+class CLogQueue
+{
+private:
+    struct Cell
+    {
+        std::atomic<size_t> nSequence;
+        int64_t nTime;
+        std::string str;
+    };
+
+    Cell* pcells;
+    size_t nMask;
+    std::atomic<size_t> nEnqueuePos;
+    std::atomic<size_t> nDequeuePos;
+
+public:
+    CLogQueue(size_t nSize) : pcells(new Cell[nSize]), nMask(nSize - 1), nEnqueuePos(0), nDequeuePos(0)
+    {
+        assert((nSize & nMask) == 0);
+        for (size_t i = 0; i < nSize; i++)
+            pcells[i].nSequence.store(i, std::memory_order_relaxed);
+    }
+
+    /** Move str into the queue; fails when it is full */
+    bool Push(int64_t nTime, std::string& str)
+    {
+        size_t nPos = nEnqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &pcells[nPos & nMask];
+            size_t nSeq = cell->nSequence.load(std::memory_order_acquire);
+            intptr_t nDiff = (intptr_t)nSeq - (intptr_t)nPos;
+            if (nDiff == 0) {
+                if (nEnqueuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (nDiff < 0)
+                return false;
+            else
+                nPos = nEnqueuePos.load(std::memory_order_relaxed);
+        }
+        cell->nTime = nTime;
+        cell->str.swap(str);
+        cell->nSequence.store(nPos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Take the oldest line; callers hold mutexDebugLog */
+    bool Pop(int64_t& nTime, std::string& str)
+    {
+        size_t nPos = nDequeuePos.load(std::memory_order_relaxed);
+        Cell* cell = &pcells[nPos & nMask];
+        if (cell->nSequence.load(std::memory_order_acquire) != nPos + 1)
+            return false;
+        nDequeuePos.store(nPos + 1, std::memory_order_relaxed);
+        nTime = cell->nTime;
+        str.swap(cell->str);
+        cell->str.clear();
+        cell->nSequence.store(nPos + nMask + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// Like fileout and mutexDebugLog, these are never destroyed, so logging from
+// global destructors stays safe. Until StartLogWriter is called lines are
+// written directly.
+static CLogQueue* logQueue = NULL;
+static boost::mutex* mutexLogWake = NULL;
+static boost::condition_variable* condLogWake = NULL;
+static boost::thread* threadLogWriter = NULL;
+// Lines go through the writer thread while this is set, and straight to the
+// file otherwise
+static std::atomic<bool> fLogAsync(false);
+static std::atomic<bool> fLogWriterSleeping(false);
+static bool fLogWriterStop = false;
+
+/** Start lines with a timestamp where needed and append them to strBatch;
+ *  called with mutexDebugLog held or from the writer thread */
+static void LogFormatLine(std::string& strBatch, int64_t nTime, const std::string& str)
+{
+    static bool fStartedNewLine = true;
+    // The timestamp only changes once a second
+    static int64_t nLastTime = -1;
+    static std::string strLastTime;
+
+    if (fLogTimestamps && fStartedNewLine) {
+        if (nTime != nLastTime) {
+            nLastTime = nTime;
+            strLastTime = DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nTime) + " ";
+        }
+        strBatch += strLastTime;
+    }
+    fStartedNewLine = !str.empty() && str[str.size()-1] == '\n';
+    strBatch += str;
+}
+
+/** Write out a batch of log text; called with mutexDebugLog held */
+static void LogWriteBatch(const std::string& strBatch)
+{
+    // reopen the log file, if requested
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(), "a", fileout) == NULL)
+            return;
+    }
+
+    fwrite(strBatch.data(), 1, strBatch.size(), fileout);
+    fflush(fileout);
+}
+
+static void ThreadLogWriter()
+{
+    RenameThread("monkey-log");
+
+    std::string strBatch;
+    std::string str;
+    int64_t nTime;
+    while (true) {
+        bool fStop;
+        {
+            boost::unique_lock<boost::mutex> lock(*mutexLogWake);
+            fStop = fLogWriterStop;
+        }
+
+        // Drain what is queued, handing it to the file in large writes
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        while (logQueue->Pop(nTime, str)) {
+            LogFormatLine(strBatch, nTime, str);
+            if (strBatch.size() >= LOG_WRITE_BATCH) {
+                LogWriteBatch(strBatch);
+                strBatch.clear();
+            }
+        }
+        if (!strBatch.empty()) {
+            LogWriteBatch(strBatch);
+            strBatch.clear();
+        }
+        scoped_lock.unlock();
+
+        if (fStop)
+            break;
+
+        // Producers only notify when we are asleep; the timeout covers a
+        // line pushed just as we went to sleep
+        boost::unique_lock<boost::mutex> lock(*mutexLogWake);
+        fLogWriterSleeping = true;
+        if (!fLogWriterStop)
+            condLogWake->timed_wait(lock, boost::posix_time::milliseconds(100));
+        fLogWriterSleeping = false;
+    }
+}
+
+/** Write out what is queued from the calling thread. Unless fWait, give up
+ *  when the log is busy: a crashing thread may be holding mutexDebugLog. */
+static void LogDrainQueue(bool fWait)
+{
+    if (logQueue == NULL)
+        return;
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog, boost::defer_lock);
+    if (fWait)
+        scoped_lock.lock();
+    else if (!scoped_lock.try_lock())
+        return;
+    std::string strBatch, str;
+    int64_t nTime;
+    while (logQueue->Pop(nTime, str))
+        LogFormatLine(strBatch, nTime, str);
+    if (!strBatch.empty())
+        LogWriteBatch(strBatch);
+}
+
+void LogFlush()
+{
+    LogDrainQueue(true);
+}
+
+// The last lines before a crash matter most, so write them out on the way
+// down, then let the default action run
+static std::terminate_handler prevTerminate = NULL;
+
+static void LogTerminate()
+{
+    LogDrainQueue(false);
+    if (prevTerminate)
+        prevTerminate();
+    abort();
+}
+
+static void LogFatalSignal(int nSignal)
+{
+    LogDrainQueue(false);
+    signal(nSignal, SIG_DFL);
+    raise(nSignal);
+}
+
+/** Drain the queue and stop the writer at exit */
+static void LogStopWriter()
+{
+    if (threadLogWriter == NULL)
+        return;
+    {
+        boost::unique_lock<boost::mutex> lock(*mutexLogWake);
+        fLogWriterStop = true;
+        condLogWake->notify_one();
+    }
+    threadLogWriter->join();
+    // Anything logged from here on is written directly
+    fLogAsync = false;
+    LogDrainQueue(true);
+}
+
 static void DebugPrintInit()
 {
     assert(fileout == NULL);
@@ -282,44 +507,97 @@ static void DebugPrintInit()
 
     boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
     fileout = fopen(pathDebug.string().c_str(), "a");
-    if (fileout) setbuf(fileout, NULL); // unbuffered
 
     mutexDebugLog = new boost::mutex();
 }
 
-bool LogAcceptCategory(const char* category)
+void StartLogWriter()
 {
-    if (category != NULL)
-    {
-        if (!fDebug)
-            return false;
+    if (fPrintToConsole || !fPrintToDebugLog)
+        return;
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    if (fileout == NULL || threadLogWriter != NULL)
+        return;
 
-        // Give each thread quick access to -debug settings.
-        // This helps prevent issues debugging global destructors,
-        // where mapMultiArgs might be deleted before another
-        // global destructor calls LogPrint()
-        static boost::thread_specific_ptr<set<string> > ptrCategory;
-        if (ptrCategory.get() == NULL)
-        {
-            const vector<string>& categories = mapMultiArgs["-debug"];
-            ptrCategory.reset(new set<string>(categories.begin(), categories.end()));
-            // thread_specific_ptr automatically deletes the set when the thread ends.
-            // "monkey" is a composite category enabling all monkey-related debug output
-            if (ptrCategory->count(string("monkey"))) {
-                ptrCategory->insert(string("darksend"));
-                ptrCategory->insert(string("instantx"));
-                ptrCategory->insert(string("masternode"));
-                ptrCategory->insert(string("mnpayments"));
-            }
-        }
-        const set<string>& setCategories = *ptrCategory.get();
+    logQueue = new CLogQueue(LOG_QUEUE_SIZE);
+    mutexLogWake = new boost::mutex();
+    condLogWake = new boost::condition_variable();
+    try {
+        threadLogWriter = new boost::thread(&ThreadLogWriter);
+    } catch (boost::thread_resource_error& e) {
+        threadLogWriter = NULL;
+        return;
+    }
+    fLogAsync = true;
+    atexit(LogStopWriter);
+    prevTerminate = std::set_terminate(LogTerminate);
+    signal(SIGABRT, LogFatalSignal); // also raised by a failed assert
+    signal(SIGSEGV, LogFatalSignal);
+#ifdef SIGBUS
+    signal(SIGBUS, LogFatalSignal);
+#endif
+}
 
-        // if not debugging everything and not debugging specific category, LogPrint does nothing.
-        if (setCategories.count(string("")) == 0 &&
-            setCategories.count(string(category)) == 0)
-            return false;
+/** Debug categories known to the code. -debug is turned into a bitmask over
+ *  this table once; a check still finds the category by name, then tests
+ *  its bit, which spares the per-thread set and string copies. */
+static const char* const pszLogCategories[] = {
+    "addrman", "alert", "coinage", "coinstake", "creation", "darksend", "db",
+    "instantx", "lock", "masternode", "mempool", "mnpayments", "net", "qt",
+    "rand", "rpc", "selectcoins", "stakemodifier",
+};
+static const size_t LOG_CATEGORY_COUNT = sizeof(pszLogCategories) / sizeof(pszLogCategories[0]);
+
+static boost::once_flag logCategoriesInitFlag = BOOST_ONCE_INIT;
+static uint32_t nLogCategories = 0;
+static bool fLogAllCategories = false;
+// -debug values that are not in the table above
+static set<string>* setLogOtherCategories = NULL;
+
+static void LogCategoriesInit()
+{
+    // This runs the first time a category is checked while debugging is
+    // on, which is after the arguments were parsed. Later changes to -debug
+    // are not seen, as before.
+    setLogOtherCategories = new set<string>();
+    BOOST_FOREACH(const string& strCategory, mapMultiArgs["-debug"])
+    {
+        if (strCategory.empty()) {
+            fLogAllCategories = true;
+            continue;
+        }
+        size_t i = 0;
+        while (i < LOG_CATEGORY_COUNT && strCategory != pszLogCategories[i])
+            i++;
+        if (i < LOG_CATEGORY_COUNT)
+            nLogCategories |= (uint32_t)1 << i;
+        else
+            setLogOtherCategories->insert(strCategory);
+        // "monkey" is a composite category enabling all monkey-related debug output
+        if (strCategory == "monkey") {
+            const char* pszMonkey[] = { "darksend", "instantx", "masternode", "mnpayments" };
+            BOOST_FOREACH(const char* psz, pszMonkey)
+                for (size_t j = 0; j < LOG_CATEGORY_COUNT; j++)
+                    if (strcmp(psz, pszLogCategories[j]) == 0)
+                        nLogCategories |= (uint32_t)1 << j;
+        }
     }
-    return true;
+}
+
+bool LogAcceptCategory(const char* category)
+{
+    if (category == NULL)
+        return true;
+    if (!fDebug)
+        return false;
+
+    boost::call_once(&LogCategoriesInit, logCategoriesInitFlag);
+    if (fLogAllCategories)
+        return true;
+    for (size_t i = 0; i < LOG_CATEGORY_COUNT; i++)
+        if (strcmp(category, pszLogCategories[i]) == 0)
+            return (nLogCategories >> i) & 1;
+    return setLogOtherCategories->count(category) > 0;
 }
 
 int LogPrintStr(const std::string &str)
@@ -332,31 +610,30 @@ int LogPrintStr(const std::string &str)
     }
     else if (fPrintToDebugLog)
     {
-        static bool fStartedNewLine = true;
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
 
         if (fileout == NULL)
             return ret;
 
-        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
-
-        // reopen the log file, if requested
-        if (fReopenDebugLog) {
-            fReopenDebugLog = false;
-            boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-            if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
-                setbuf(fileout, NULL); // unbuffered
+        ret = str.size();
+        int64_t nTime = GetTime();
+        if (fLogAsync) {
+            // Hand the line to the writer thread. If it has fallen a whole
+            // queue behind, wait for it rather than dropping lines.
+            std::string strLine(str);
+            while (!logQueue->Push(nTime, strLine)) {
+                condLogWake->notify_one();
+                MilliSleep(1);
+            }
+            if (fLogWriterSleeping)
+                condLogWake->notify_one();
+            return ret;
         }
 
-        // Debug print useful for profiling
-        if (fLogTimestamps && fStartedNewLine)
-            ret += fprintf(fileout, "%s ", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()).c_str());
-        if (!str.empty() && str[str.size()-1] == '\n')
-            fStartedNewLine = true;
-        else
-            fStartedNewLine = false;
-
-        ret = fwrite(str.data(), 1, str.size(), fileout);
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        std::string strBatch;
+        LogFormatLine(strBatch, nTime, str);
+        LogWriteBatch(strBatch);
     }
 
     return ret;
@@ -1128,6 +1405,7 @@ void PrintException(std::exception* pex, const char* pszThread)
     LogPrintf("\n\n************************\n%s\n", message);
     fprintf(stderr, "\n\n************************\n%s\n", message.c_str());
     strMiscWarning = message;
+    LogFlush();
     throw;
 }
 
@@ -1137,6 +1415,8 @@ void PrintExceptionContinue(std::exception* pex, const char* pszThread)
     LogPrintf("\n\n************************\n%s\n", message);
     fprintf(stderr, "\n\n************************\n%s\n", message.c_str());
     strMiscWarning = message;
+    // Callers often shut down next; have the log up to here on disk
+    LogFlush();
 }
 
 boost::filesystem::path GetDefaultDataDir()
@@ -125,6 +125,11 @@ std::string Hex2Ascii(const std::string& in);
 bool LogAcceptCategory(const char* category);
 /* Send a string to the log output */
 int LogPrintStr(const std::string &str);
+/* Have a background thread write debug.log from now on; queued lines are
+ * written out at exit and on a crash. Call after daemonizing. */
+void StartLogWriter();
+/* Write out the lines still queued for the background writer */
+void LogFlush();
 
 #define LogPrintf(...) LogPrint(NULL, __VA_ARGS__)
 
@@ -210,6 +215,7 @@ void FileCommit(FILE *fileout);
 bool RenameOver(boost::filesystem::path src, boost::filesystem::path dest);
 boost::filesystem::path GetDefaultDataDir();
 const boost::filesystem::path &GetDataDir(bool fNetSpecific = true);
+void ClearDatadirCache();
 boost::filesystem::path GetConfigFile();
 boost::filesystem::path GetMasternodeConfigFile();
 boost::filesystem::path GetPidFile();
@@ -15,7 +15,7 @@ static const int DATABASE_VERSION = 70508;
 //
 // network protocol versioning
 //
-static const int PROTOCOL_VERSION = 70061;
+static const int PROTOCOL_VERSION = 70062;
 
 // intial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -38,6 +38,11 @@ static const int SOFT_FORK_VERSION_210 = 122000;
 static const int MIN_POOL_PEER_PROTO_VERSION = 70061;
 static const int MIN_INSTANTX_PROTO_VERSION = 70061;
 
+// version masternodes announce and expect in their own broadcasts; kept
+// apart from PROTOCOL_VERSION so that relay-only changes such as compact
+// blocks do not stop hot/cold masternode activation across builds
+static const int MASTERNODE_PROTO_VERSION = 70061;
+
 // minimum peer version that can receive masternode payments
 // V1 - Last protocol version before update
 // V2 - Newest protocol version
@@ -57,4 +62,7 @@ static const int BIP0031_VERSION = 60000;
 // "mempool" command, enhanced "getdata" behavior starts with this version:
 static const int MEMPOOL_GD_VERSION = 60002;
 
+// "cmpctblock", "getblocktxn" and "blocktxn" commands start with this version
+static const int COMPACT_BLOCKS_VERSION = 70062;
+
 #endif
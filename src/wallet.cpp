@@ -10,11 +10,13 @@
 #include "kernel.h"
 #include "main.h"
 #include "net.h"
+#include "perfstats.h"
 #include "util.h"
 #include "txdb.h"
 #include "ui_interface.h"
 #include "walletdb.h"
 #include "crypter.h"
+#include "init.h"
 #include "key.h"
 #include "spork.h"
 #include "darksend.h"
@@ -63,22 +65,55 @@ CPubKey CWallet::GenerateNewKey()
     CKey secret;
     secret.MakeNewKey(fCompressed);
 
-    // Compressed public keys were introduced in version 0.6.0
-    if (fCompressed)
-        SetMinVersion(FEATURE_COMPRPUBKEY);
-
     CPubKey pubkey = secret.GetPubKey();
     assert(secret.VerifyPubKey(pubkey));
 
+    if (!AddGeneratedKey(secret, pubkey))
+        throw std::runtime_error("CWallet::GenerateNewKey() : AddKey failed");
+    return pubkey;
+}
+
+// Record a freshly generated key with its creation time
+bool CWallet::AddGeneratedKey(const CKey& secret, const CPubKey& pubkey)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+
+    // Compressed public keys were introduced in version 0.6.0
+    if (secret.IsCompressed())
+        SetMinVersion(FEATURE_COMPRPUBKEY);
+
     // Create new metadata
     int64_t nCreationTime = GetTime();
     mapKeyMetadata[pubkey.GetID()] = CKeyMetadata(nCreationTime);
     if (!nTimeFirstKey || nCreationTime < nTimeFirstKey)
         nTimeFirstKey = nCreationTime;
 
-    if (!AddKeyPubKey(secret, pubkey))
-        throw std::runtime_error("CWallet::GenerateNewKey() : AddKey failed");
-    return pubkey;
+    return AddKeyPubKey(secret, pubkey);
+}
+
+bool CWallet::BeginBatch(CWalletDB& walletdb)
+{
+    AssertLockHeld(cs_wallet);
+    if (pwalletdbBatch || !walletdb.TxnBegin())
+        return false;
+    pwalletdbBatch = &walletdb;
+    return true;
+}
+
+bool CWallet::CommitBatch()
+{
+    AssertLockHeld(cs_wallet);
+    CWalletDB* pwalletdb = pwalletdbBatch;
+    pwalletdbBatch = NULL;
+    return pwalletdb && pwalletdb->TxnCommit();
+}
+
+void CWallet::AbortBatch()
+{
+    AssertLockHeld(cs_wallet);
+    if (pwalletdbBatch)
+        pwalletdbBatch->TxnAbort();
+    pwalletdbBatch = NULL;
 }
 
 bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey& pubkey)
@@ -96,6 +131,8 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey& pubkey)
     if (!fFileBacked)
         return true;
     if (!IsCrypted()) {
+        if (pwalletdbBatch)
+            return pwalletdbBatch->WriteKey(pubkey, secret.GetPrivKey(), mapKeyMetadata[pubkey.GetID()]);
         return CWalletDB(strWalletFile).WriteKey(pubkey, secret.GetPrivKey(), mapKeyMetadata[pubkey.GetID()]);
     }
     return true;
@@ -110,8 +147,8 @@ bool CWallet::AddCryptedKey(const CPubKey& vchPubKey,
         return true;
     {
         LOCK(cs_wallet);
-        if (pwalletdbEncryption)
-            return pwalletdbEncryption->WriteCryptedKey(vchPubKey,
+        if (pwalletdbBatch)
+            return pwalletdbBatch->WriteCryptedKey(vchPubKey,
                 vchCryptedSecret,
                 mapKeyMetadata[vchPubKey.GetID()]);
         else
@@ -301,6 +338,8 @@ bool CWallet::SetMinVersion(enum WalletFeature nVersion, CWalletDB* pwalletdbIn,
         nWalletMaxVersion = nVersion;
 
     if (fFileBacked) {
+        if (!pwalletdbIn)
+            pwalletdbIn = pwalletdbBatch;
         CWalletDB* pwalletdb = pwalletdbIn ? pwalletdbIn : new CWalletDB(strWalletFile);
         if (nWalletVersion > 40000)
             pwalletdb->WriteMinVersion(nWalletVersion);
@@ -418,6 +457,68 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+CoinClass CWallet::GetCoinClass(int64_t nValue) const
+{
+    if (IsDenominatedAmount(nValue))
+        return COINCLASS_DENOMINATED;
+    if (IsCollateralAmount(nValue))
+        return COINCLASS_COLLATERAL;
+    if (nValue == MASTERNODE_COLLATERAL * COIN)
+        return COINCLASS_MASTERNODE;
+    return COINCLASS_OTHER;
+}
+
+void CWallet::UpdateWalletCoin(const COutPoint& outpoint) const
+{
+    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(outpoint.hash);
+    if (mi == mapWallet.end() || outpoint.n >= mi->second.vout.size())
+        return;
+    const CTxOut& txout = mi->second.vout[outpoint.n];
+
+    set<COutPoint>& setCoins = setWalletCoins[GetCoinClass(txout.nValue)];
+    setCoins.erase(outpoint);
+    setWalletCoinsPending.erase(outpoint);
+    if (txout.nValue <= 0 || IsMine(txout) == ISMINE_NO)
+        return;
+
+    // Same rule as IsSpent, but keep apart spends that are only in the memory pool
+    int nSpendDepth = -1;
+    pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(outpoint);
+    for (TxSpends::const_iterator it = range.first; it != range.second; ++it) {
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+        if (mit != mapWallet.end())
+            nSpendDepth = std::max(nSpendDepth, mit->second.GetDepthInMainChain(false));
+    }
+    if (nSpendDepth < 0)
+        setCoins.insert(outpoint);
+    else if (nSpendDepth == 0)
+        setWalletCoinsPending.insert(outpoint);
+}
+
+void CWallet::UpdateWalletCoins(const uint256& hash) const
+{
+    if (!fWalletCoinsBuilt)
+        return;
+    AssertLockHeld(cs_wallet);
+
+    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+    if (mi == mapWallet.end())
+        return;
+    for (unsigned int i = 0; i < mi->second.vout.size(); i++)
+        UpdateWalletCoin(COutPoint(hash, i));
+}
+
+void CWallet::BuildWalletCoins() const
+{
+    AssertLockHeld(cs_wallet);
+    for (int nClass = 0; nClass < COINCLASS_COUNT; nClass++)
+        setWalletCoins[nClass].clear();
+    setWalletCoinsPending.clear();
+    fWalletCoinsBuilt = true;
+
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        UpdateWalletCoins(it->first);
+}
 
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
@@ -464,29 +565,29 @@ bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 
         if (fFileBacked)
         {
-            pwalletdbEncryption = new CWalletDB(strWalletFile);
-            if (!pwalletdbEncryption->TxnBegin())
+            pwalletdbBatch = new CWalletDB(strWalletFile);
+            if (!pwalletdbBatch->TxnBegin())
                 return false;
-            pwalletdbEncryption->WriteMasterKey(nMasterKeyMaxID, kMasterKey);
+            pwalletdbBatch->WriteMasterKey(nMasterKeyMaxID, kMasterKey);
         }
 
         if (!EncryptKeys(vMasterKey))
         {
             if (fFileBacked)
-                pwalletdbEncryption->TxnAbort();
+                pwalletdbBatch->TxnAbort();
             exit(1); //We now probably have half of our keys encrypted in memory, and half not...die and let the user reload their unencrypted wallet.
         }
 
         // Encryption was introduced in version 0.4.0
-        SetMinVersion(FEATURE_WALLETCRYPT, pwalletdbEncryption, true);
+        SetMinVersion(FEATURE_WALLETCRYPT, pwalletdbBatch, true);
 
         if (fFileBacked)
         {
-            if (!pwalletdbEncryption->TxnCommit())
+            if (!pwalletdbBatch->TxnCommit())
                 exit(1); //We now have keys encrypted in memory, but no on disk...die to avoid confusion and let the user reload their unencrypted wallet.
 
-            delete pwalletdbEncryption;
-            pwalletdbEncryption = NULL;
+            delete pwalletdbBatch;
+            pwalletdbBatch = NULL;
         }
 
         Lock();
@@ -507,6 +608,8 @@ int64_t CWallet::IncOrderPosNext(CWalletDB *pwalletdb)
 {
     AssertLockHeld(cs_wallet); // nOrderPosNext
     int64_t nRet = nOrderPosNext++;
+    if (!pwalletdb)
+        pwalletdb = pwalletdbBatch;
     if (pwalletdb) {
         pwalletdb->WriteOrderPosNext(nOrderPosNext);
     } else {
@@ -606,6 +709,18 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
             fUpdated |= wtx.UpdateSpent(wtxIn.vfSpent);
         }
 
+        // Mixed transactions that spend from it may have missed it so far
+        if (fInsertedNew)
+            InvalidateDarksendRounds(hash);
+        if (IsFullyDenominated(wtx))
+            GetTxDarksendRounds(wtx);
+
+        // Its outputs and the outputs it spends may have changed state
+        UpdateWalletCoins(hash);
+        if (!wtx.IsCoinBase())
+            for (const CTxIn& txin : wtx.vin)
+                UpdateWalletCoins(txin.prevout.hash);
+
         //// debug print
         LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
@@ -672,6 +787,12 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock, bool
 
     if (!fConnect)
     {
+        // The block is still the tip here: settle what it spent once it is gone
+        if (fWalletCoinsBuilt)
+            for (const CTxIn& txin : tx.vin)
+                if (mapWallet.count(txin.prevout.hash))
+                    setWalletCoinsPending.insert(txin.prevout);
+
         // wallets need to refund inputs when disconnecting coinstake
         if (tx.IsCoinStake())
         {
@@ -725,94 +846,158 @@ CAmount CWallet::GetDebit(const CTxIn& txin, const isminefilter& filter) const
     return 0;
 }
 
-// Recursively determine the rounds of a given input (How deep is the Darksend chain for a given input)
-int CWallet::GetRealInputDarksendRounds(CTxIn in, int rounds) const
+bool CWallet::IsFullyDenominated(const CTransaction& tx) const
 {
-    static std::map<uint256, CTransaction> mDenomWtxes;
-
-    if (rounds >= 16) return 15; // 16 rounds max
-
-    uint256 hash = in.prevout.hash;
-    unsigned int nout = in.prevout.n;
-
-    const CWalletTx* wtx = GetWalletTx(hash);
-    if (wtx != NULL) {
-        std::map<uint256, CTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        // not known yet, let's add it
-        if (mdwi == mDenomWtxes.end()) {
-            LogPrint("darksend", "GetInputDarksendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CTransaction(*wtx);
-        }
-        // found and it's not an initial value, just return it
-        else if (mDenomWtxes[hash].vout[nout].nRounds != -10)
-            return mDenomWtxes[hash].vout[nout].nRounds;
+    BOOST_FOREACH(const CTxOut& txout, tx.vout)
+        if (!IsDenominatedAmount(txout.nValue))
+            return false;
+    return true;
+}
 
-        // bounds check
-        if (nout >= wtx->vout.size())
+// Rounds of a fully denominated wallet transaction: one more than the fewest
+// rounds among the denominated inputs it spends from the wallet, at most 16,
+// or 0 if it spends none. Walks the missing ancestors with an explicit stack,
+// so every transaction is computed once however long the chain is.
+int CWallet::GetTxDarksendRounds(const CWalletTx& wtx) const
+{
+    AssertLockHeld(cs_wallet);
+    map<uint256, int>::const_iterator mi = mapDarksendRounds.find(wtx.GetHash());
+    if (mi != mapDarksendRounds.end())
+        return mi->second;
+
+    // The denominations are set up after the wallet has loaded
+    bool fCache = !darkSendDenominations.empty();
+    map<uint256, int> mapUncached;
+    map<uint256, int>& mapRounds = fCache ? mapDarksendRounds : mapUncached;
+    vector<uint256> vComputed;
+
+    vector<const CWalletTx*> vStack(1, &wtx);
+    while (!vStack.empty())
+    {
+        const CWalletTx* pwtx = vStack.back();
+        uint256 hash = pwtx->GetHash();
+        if (mapRounds.count(hash))
         {
-            // should never actually hit this
-            LogPrint("darksend", "GetInputDarksendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, -4);
-            return -4;
+            vStack.pop_back();
+            continue;
         }
 
-        if (pwalletMain->IsCollateralAmount(wtx->vout[nout].nValue))
+        int nShortest = -1;
+        bool fPending = false;
+        BOOST_FOREACH(const CTxIn& txin, pwtx->vin)
         {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("darksend", "GetInputDarksendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+            const CWalletTx* pprev = GetWalletTx(txin.prevout.hash);
+            if (!pprev || txin.prevout.n >= pprev->vout.size())
+                continue;
+            const CTxOut& txout = pprev->vout[txin.prevout.n];
+            if (!IsMine(txout) || IsCollateralAmount(txout.nValue) || !IsDenominatedAmount(txout.nValue))
+                continue;
 
-        //make sure the final output is non-denominate
-        if (/*rounds == 0 && */!IsDenominatedAmount(wtx->vout[nout].nValue)) //NOT DENOM
-        {
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("darksend", "GetInputDarksendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            // A denomination split off in a transaction with other outputs starts a chain
+            int n = 0;
+            if (IsFullyDenominated(*pprev))
+            {
+                map<uint256, int>::const_iterator mi = mapRounds.find(txin.prevout.hash);
+                if (mi == mapRounds.end())
+                {
+                    vStack.push_back(pprev);
+                    fPending = true;
+                    continue;
+                }
+                n = mi->second;
+            }
+            if (nShortest < 0 || n < nShortest)
+                nShortest = n;
         }
+        if (fPending)
+            continue;
 
-        bool fAllDenoms = true;
-        BOOST_FOREACH(CTxOut out, wtx->vout)
-        {
-            fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
-        }
-        // this one is denominated but there is another non-denominated output found in the same tx
-        if (!fAllDenoms)
-        {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("darksend", "GetInputDarksendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+        mapRounds[hash] = nShortest < 0 ? 0 : std::min(nShortest + 1, 16);
+        vComputed.push_back(hash);
+        vStack.pop_back();
+    }
 
-        int nShortest = -10; // an initial value, should be no way to get this by calculations
-        bool fDenomFound = false;
-        // only denoms here so let's look up
-        BOOST_FOREACH(CTxIn in2, wtx->vin)
+    if (fCache && fFileBacked)
+    {
+        // Inside a batch every write has to go through its handle
+        CWalletDB* pwalletdb = pwalletdbBatch ? pwalletdbBatch : new CWalletDB(strWalletFile);
+        BOOST_FOREACH(const uint256& hash, vComputed)
+            pwalletdb->WriteDarksendRounds(hash, mapRounds[hash]);
+        if (!pwalletdbBatch)
+            delete pwalletdb;
+    }
+    return mapRounds[wtx.GetHash()];
+}
+
+// Forget the rounds of hash and of every wallet transaction descending from
+// it, since an input they spend may have become known.
+void CWallet::InvalidateDarksendRounds(const uint256& hash)
+{
+    AssertLockHeld(cs_wallet);
+    vector<uint256> vErased;
+    if (mapDarksendRounds.erase(hash))
+        vErased.push_back(hash);
+    vector<uint256> vStack(1, hash);
+    while (!vStack.empty())
+    {
+        uint256 hashTx = vStack.back();
+        vStack.pop_back();
+        const CWalletTx* pwtx = GetWalletTx(hashTx);
+        if (!pwtx)
+            continue;
+        for (unsigned int i = 0; i < pwtx->vout.size(); i++)
         {
-            if (IsMine(in2))
-            {
-                int n = GetRealInputDarksendRounds(in2, rounds+1);
-                // denom found, find the shortest chain or initially assign nShortest with the first found value
-                if (n >= 0 && (n < nShortest || nShortest == -10))
+            pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(hashTx, i));
+            for (TxSpends::const_iterator it = range.first; it != range.second; ++it)
+                if (mapDarksendRounds.erase(it->second))
                 {
-                    nShortest = n;
-                    fDenomFound = true;
+                    vErased.push_back(it->second);
+                    vStack.push_back(it->second);
                 }
-            }
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
-                ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
-                : 0;            // too bad, we are the fist one in that chain
-        LogPrint("darksend", "GetInputDarksendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
     }
 
-    return rounds-1;
+    if (fFileBacked && !vErased.empty())
+    {
+        CWalletDB* pwalletdb = pwalletdbBatch ? pwalletdbBatch : new CWalletDB(strWalletFile);
+        BOOST_FOREACH(const uint256& hashErased, vErased)
+            pwalletdb->EraseDarksendRounds(hashErased);
+        if (!pwalletdbBatch)
+            delete pwalletdb;
+    }
+}
+
+// Determine the rounds of a given input (How deep is the Darksend chain for a given input)
+int CWallet::GetRealInputDarksendRounds(const COutPoint& outpoint) const
+{
+    AssertLockHeld(cs_wallet);
+    const CWalletTx* wtx = GetWalletTx(outpoint.hash);
+    if (wtx == NULL)
+        return -1;
+
+    // bounds check
+    if (outpoint.n >= wtx->vout.size())
+        return -4; // should never actually hit this
+
+    CAmount nValue = wtx->vout[outpoint.n].nValue;
+    if (IsCollateralAmount(nValue))
+        return -3;
+
+    //make sure the final output is non-denominate
+    if (!IsDenominatedAmount(nValue))
+        return -2;
+
+    // this one is denominated but there is another non-denominated output found in the same tx
+    if (!IsFullyDenominated(*wtx))
+        return 0;
+
+    return GetTxDarksendRounds(*wtx);
 }
 
 // respect current settings
 int CWallet::GetInputDarksendRounds(CTxIn in) const {
     LOCK(cs_wallet);
-    int realDarksendRounds = GetRealInputDarksendRounds(in, 0);
+    int realDarksendRounds = GetRealInputDarksendRounds(in.prevout);
     return realDarksendRounds > nDarksendRounds ? nDarksendRounds : realDarksendRounds;
 }
 
@@ -1061,38 +1246,190 @@ void CWalletTx::AddSupportingTransactions(CTxDB& txdb)
 
 bool CWalletTx::WriteToDisk()
 {
+    if (pwallet->pwalletdbBatch)
+        return pwallet->pwalletdbBatch->WriteTx(GetHash(), *this);
     return CWalletDB(pwallet->strWalletFile).WriteTx(GetHash(), *this);
 }
 
-// Scan the block chain (starting in pindexStart) for transactions
-// from or to us. If fUpdate is true, found transactions that already
-// exist in the wallet will be updated.
+/** Number of blocks a rescan reads ahead of the wallet at a time */
+static const unsigned int RESCAN_BATCH_SIZE = 128;
+/** Most threads a rescan reads blocks with */
+static const int MAX_RESCAN_THREADS = 8;
+
+namespace {
+/** A block read by a rescan, with the transactions paying to the wallet */
+struct CRescanBlock
+{
+    CBlockIndex* pindex;
+    CBlock block;
+    bool fRead;
+    std::vector<bool> vfPaysMe;
+
+    CRescanBlock(CBlockIndex* pindexIn) : pindex(pindexIn), fRead(false) {}
+};
+}
+
+// Read and prefilter blocks of a rescan batch. Runs without cs_main or
+// cs_wallet: block files are only appended to, and IsMine on outputs only
+// looks at the keystore.
+static void ReadRescanBlocks(const CWallet* pwallet, std::vector<CRescanBlock>* pvBlocks, std::atomic<unsigned int>* pnNext)
+{
+    while (true) {
+        unsigned int i = (*pnNext)++;
+        if (i >= pvBlocks->size())
+            return;
+        CRescanBlock& entry = (*pvBlocks)[i];
+        entry.fRead = entry.block.ReadFromDisk(entry.pindex, true);
+        if (!entry.fRead)
+            continue;
+        entry.vfPaysMe.resize(entry.block.vtx.size());
+        for (unsigned int j = 0; j < entry.block.vtx.size(); j++)
+            entry.vfPaysMe[j] = pwallet->IsMine(entry.block.vtx[j]);
+    }
+}
+
+// Add the transactions of a rescanned block that involve the wallet
+int CWallet::AddBlockToWallet(const CBlock& block, const std::vector<bool>& vfPaysMe, bool fUpdate)
+{
+    AssertLockHeld(cs_wallet);
+    int ret = 0;
+    // Relevance is decided in block order, after the earlier transactions
+    // of the block were added, so spends within the block are found
+    for (unsigned int j = 0; j < block.vtx.size(); j++) {
+        const CTransaction& tx = block.vtx[j];
+        if ((j < vfPaysMe.size() && vfPaysMe[j]) || mapWallet.count(tx.GetHash()) || IsFromMe(tx))
+            if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+                ret++;
+    }
+    return ret;
+}
+
+namespace {
+/** Sets CWallet::fScanningWallet unless another rescan already did, and
+ *  clears it again when the rescan ends, also by an exception */
+class CScanningWalletReserve
+{
+    std::atomic<bool>& fScanning;
+    bool fReserved;
+
+public:
+    explicit CScanningWalletReserve(std::atomic<bool>& fScanningIn) : fScanning(fScanningIn)
+    {
+        bool fExpected = false;
+        fReserved = fScanning.compare_exchange_strong(fExpected, true);
+    }
+    ~CScanningWalletReserve() { if (fReserved) fScanning = false; }
+    bool IsReserved() const { return fReserved; }
+};
+}
+
+/**
+ * Scan the block chain (starting in pindexStart) for transactions
+ * from or to us. If fUpdate is true, found transactions that already
+ * exist in the wallet will be updated. Returns -1 without scanning if
+ * another rescan is running.
+ *
+ * Blocks are read and checked against the wallet's keys in batches on
+ * several threads with no locks held. cs_main and cs_wallet are only taken
+ * to walk the chain and to add the transactions found, block by block in
+ * chain order, so the node keeps validating and relaying meanwhile.
+ */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
+    // Two rescans would clear each other's abort and scanning flags
+    CScanningWalletReserve scanning(fScanningWallet);
+    if (!scanning.IsReserved())
+    {
+        LogPrintf("ScanForWalletTransactions() : another rescan is running\n");
+        return -1;
+    }
+
     int ret = 0;
+    int64_t nNow = GetTime();
+    int nThreads = std::max(1, std::min(MAX_RESCAN_THREADS, (int)boost::thread::hardware_concurrency()));
+
+    int nStartHeight, nEndHeight;
+    {
+        LOCK(cs_main);
+        nStartHeight = pindexStart ? pindexStart->nHeight : 0;
+        nEndHeight = nBestHeight;
+    }
+
+    fAbortRescan = false;
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI
+
+    // Transactions found in a block are written in one database transaction
+    CWalletDB walletdb(strWalletFile);
 
     CBlockIndex* pindex = pindexStart;
+    CBlockIndex* pindexLast = NULL;
+    while (pindex && !fAbortRescan && !ShutdownRequested())
     {
-        LOCK2(cs_main, cs_wallet);
-        while (pindex)
+        std::vector<CRescanBlock> vBlocks;
         {
-            // no need to read and scan block, if block was created before
-            // our wallet birthday (as adjusted for block time variability)
-            if (nTimeFirstKey && (pindex->nTime < (nTimeFirstKey - 7200))) {
+            LOCK(cs_main);
+            // Continue from the fork point if the last batch got reorganized away
+            if (pindexLast) {
+                while (!pindexLast->IsInMainChain())
+                    pindexLast = pindexLast->pprev;
+                pindex = pindexLast->pnext;
+            }
+            while (pindex && vBlocks.size() < RESCAN_BATCH_SIZE) {
+                // no need to read and scan block, if block was created before
+                // our wallet birthday (as adjusted for block time variability)
+                if (!nTimeFirstKey || pindex->nTime >= (nTimeFirstKey - 7200))
+                    vBlocks.push_back(CRescanBlock(pindex));
+                pindexLast = pindex;
                 pindex = pindex->pnext;
-                continue;
             }
+            nEndHeight = std::max(nEndHeight, nBestHeight);
+        }
 
-            CBlock block;
-            block.ReadFromDisk(pindex, true);
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
+        std::atomic<unsigned int> nNext(0);
+        boost::thread_group readers;
+        for (int i = 1; i < std::min(nThreads, (int)vBlocks.size()); i++)
+            readers.create_thread(boost::bind(&ReadRescanBlocks, this, &vBlocks, &nNext));
+        ReadRescanBlocks(this, &vBlocks, &nNext);
+        readers.join_all();
+
+        for (CRescanBlock& entry : vBlocks)
+        {
+            if (!entry.fRead)
+                continue;
+
+            // Skip blocks with nothing for us without taking cs_main. A spend
+            // of an output paid to us earlier in the same block is only
+            // seen as ours once that payment is added, but then the
+            // payment flags the block here already.
+            bool fRelevant = false;
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
+                LOCK(cs_wallet);
+                for (unsigned int j = 0; j < entry.block.vtx.size() && !fRelevant; j++) {
+                    const CTransaction& tx = entry.block.vtx[j];
+                    fRelevant = entry.vfPaysMe[j] || mapWallet.count(tx.GetHash()) || IsFromMe(tx);
+                }
             }
-            pindex = pindex->pnext;
+            if (!fRelevant)
+                continue;
+
+            LOCK2(cs_main, cs_wallet);
+            CWalletBatch batch(this, walletdb);
+            ret += AddBlockToWallet(entry.block, entry.vfPaysMe, fUpdate);
+            if (!batch.Commit())
+                LogPrintf("ScanForWalletTransactions() : writing wallet transactions of block %d failed\n", entry.pindex->nHeight);
+        }
+
+        if (pindexLast && nEndHeight > nStartHeight)
+            ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((pindexLast->nHeight - nStartHeight) * 100 / (nEndHeight - nStartHeight)))));
+        if (pindexLast && GetTime() >= nNow + 60) {
+            nNow = GetTime();
+            LogPrintf("Still rescanning. At block %d of %d\n", pindexLast->nHeight, nEndHeight);
         }
     }
+
+    if (pindex && pindexLast)
+        LogPrintf("Rescan aborted at block %d\n", pindexLast->nHeight);
+    ShowProgress("", 100); // hide progress dialog in GUI
     return ret;
 }
 
@@ -1153,7 +1490,7 @@ void CWallet::ReacceptWalletTransactions()
         }
         if (!vMissingTx.empty()) {
             // TODO: optimize this to scan just part of the block chain?
-            if (ScanForWalletTransactions(pindexGenesisBlock))
+            if (ScanForWalletTransactions(pindexGenesisBlock) > 0)
                 fRepeat = true;  // Found missing transactions: re-do re-accept.
         }
     }
@@ -1175,7 +1512,10 @@ void CWalletTx::RelayWalletTransaction(std::string strCommand)
             LogPrintf("Relaying wtx %s\n", hash.ToString());
 
             if (strCommand == "ix") {
-                mapTxLockReq.insert(make_pair(hash, ((CTransaction) *this)));
+                {
+                    LOCK(cs_instantx);
+                    mapTxLockReq.insert(make_pair(hash, ((CTransaction) *this)));
+                }
                 CreateNewLock(((CTransaction) *this));
                 RelayTransactionLockReq((CTransaction) *this, true);
             } else {
@@ -1474,65 +1814,87 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
 }
 
 // populate vCoins with vector of available COutputs.
-void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, AvailableCoinsType nCoinType, bool fUseIX) const
+// Whether outputs of the given class can satisfy nCoinType
+static bool IsCoinClassWanted(int nClass, AvailableCoinsType nCoinType)
 {
-    vCoins.clear();
+    switch (nCoinType) {
+    case ONLY_DENOMINATED:
+        return nClass == COINCLASS_DENOMINATED;
+    case ONLY_NOT10000IFMN:
+        return !(fMasterNode && nClass == COINCLASS_MASTERNODE);
+    case ONLY_NONDENOMINATED_NOT10000IFMN:
+        // do not use collateral amounts, do not use Hot MN funds
+        return nClass == COINCLASS_OTHER || (nClass == COINCLASS_MASTERNODE && !fMasterNode);
+    case ONLY_10000:
+        return nClass == COINCLASS_MASTERNODE;
+    default:
+        return true;
+    }
+}
 
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+// Depth of a wallet transaction if its outputs may be used as inputs, otherwise 0
+static int GetAvailableDepth(const CWalletTx& wtx, bool fOnlyConfirmed, bool fUseIX)
+{
+    if (!wtx.IsFinal())
+        return 0;
 
-            if (!pcoin->IsFinal())
-                continue;
+    if (fOnlyConfirmed && !wtx.IsTrusted())
+        return 0;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+    if ((wtx.IsCoinBase() || wtx.IsCoinStake()) && wtx.GetBlocksToMaturity() > 0)
+        return 0;
 
-            if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+    int nDepth = wtx.GetDepthInMainChain(false);
+    if (nDepth <= 0) // TXNOTE: coincontrol fix / ignore 0 confirm
+        return 0;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            if (nDepth <= 0) // TXNOTE: coincontrol fix / ignore 0 confirm
-                continue;
+    // do not use IX for inputs that have less then 6 blockchain confirmations
+    if (fUseIX && nDepth < 6)
+        return 0;
 
-            // do not use IX for inputs that have less then 6 blockchain confirmations
-            if (fUseIX && nDepth < 6)
-                continue;
+    return nDepth;
+}
+
+void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, AvailableCoinsType nCoinType, bool fUseIX) const
+{
+    vCoins.clear();
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
+    {
+        LOCK2(cs_main, cs_wallet);
+        if (!fWalletCoinsBuilt)
+            BuildWalletCoins();
+
+        // Spends only in the memory pool may have been dropped since
+        set<COutPoint> setPending;
+        setPending.swap(setWalletCoinsPending);
+        for (const COutPoint& outpoint : setPending)
+            UpdateWalletCoin(outpoint);
+
+        for (int nClass = 0; nClass < COINCLASS_COUNT; nClass++) {
+            if (!IsCoinClassWanted(nClass, nCoinType))
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if (nCoinType == ONLY_DENOMINATED) {
-                    found = IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if (nCoinType == ONLY_NOT10000IFMN) {
-                    found = !(fMasterNode && pcoin->vout[i].nValue == MASTERNODE_COLLATERAL * COIN);
-                } else if (nCoinType == ONLY_NONDENOMINATED_NOT10000IFMN) {
-                    if (IsCollateralAmount(pcoin->vout[i].nValue))
-                        continue; // do not use collateral amounts
-                    found = !IsDenominatedAmount(pcoin->vout[i].nValue);
-                    if (found && fMasterNode)
-                        found = pcoin->vout[i].nValue != MASTERNODE_COLLATERAL * COIN; // do not use Hot MN funds
-                } else if (nCoinType == ONLY_10000) {
-                    found = pcoin->vout[i].nValue == MASTERNODE_COLLATERAL * COIN;
-                } else {
-                    found = true;
+            // The set is ordered by txid, so the outputs of one transaction are adjacent
+            uint256 hashLast = 0;
+            const CWalletTx* pcoin = NULL;
+            int nDepth = 0;
+            for (const COutPoint& outpoint : setWalletCoins[nClass]) {
+                if (pcoin == NULL || outpoint.hash != hashLast) {
+                    hashLast = outpoint.hash;
+                    pcoin = &mapWallet.find(outpoint.hash)->second;
+                    nDepth = GetAvailableDepth(*pcoin, fOnlyConfirmed, fUseIX);
                 }
-                if (!found) continue;
+                if (nDepth <= 0)
+                    continue;
 
+                unsigned int i = outpoint.n;
                 isminetype mine = IsMine(pcoin->vout[i]);
 
-                if (IsSpent(wtxid, i)) continue;
+                if (IsSpent(outpoint.hash, i)) continue;
                 if (mine == ISMINE_NO) continue;
                 if (mine == ISMINE_WATCH_ONLY) continue;
-                if (IsLockedCoin((*it).first, i) && nCoinType != ONLY_10000) continue;
-                if (pcoin->vout[i].nValue <= 0) continue;
-                if (coinControl && coinControl->HasSelected() && !coinControl->IsSelected((*it).first, i))
+                if (IsLockedCoin(outpoint.hash, i) && nCoinType != ONLY_10000) continue;
+                if (coinControl && coinControl->HasSelected() && !coinControl->IsSelected(outpoint.hash, i))
                     continue;
 
                 bool fIsSpendable = false;
@@ -1540,21 +1902,6 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
                     fIsSpendable = true;
 
                 vCoins.emplace_back(COutput(pcoin, i, nDepth, fIsSpendable));
-
-                // if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                //     (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_10000) &&
-                //     pcoin->vout[i].nValue > 0 &&
-                //     (!coinControl || !coinControl->HasSelected() || coinControl->IsSelected((*it).first, i)))
-                //     vCoins.push_back(COutput(pcoin, i, nDepth,
-                //         ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ));
-
-                // isminetype mine = IsMine(pcoin->vout[i]);
-                // if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                //     !IsLockedCoin((*it).first, i) && pcoin->vout[i].nValue > 0 &&
-                //     (!coinControl || !coinControl->HasSelected() || coinControl->IsSelected((*it).first, i)))
-                // {
-                //     vCoins.push_back(COutput(pcoin, i, nDepth, mine & ISMINE_SPENDABLE));
-                // }
             }
         }
     }
@@ -1611,7 +1958,84 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 //     }
 // }
 
-static void ApproximateBestSubset(vector<pair<int64_t, pair<const CWalletTx*,unsigned int> > >vValue, int64_t nTotalLower, int64_t nTargetValue,
+// Depth-first search over vValue, sorted by descending value, for the subset
+// whose total lies in [nTargetValue, nTargetValue + nCostOfChange] with the
+// least excess, and the fewest coins among equal excess. Such a selection
+// needs no change output. The search includes the larger coins first, prunes
+// branches that cannot reach the target or that overshoot the window, and is
+// deterministic.
+bool SelectCoinsBnB(const vector<pair<int64_t, pair<const CWalletTx*,unsigned int> > >& vValue, int64_t nTargetValue, int64_t nCostOfChange,
+                    vector<char>& vfBest, int64_t& nBest)
+{
+    int64_t nAvailable = 0;
+    for (unsigned int i = 0; i < vValue.size(); i++)
+        nAvailable += vValue[i].first;
+    if (nAvailable < nTargetValue)
+        return false;
+
+    // Decisions so far for vValue[0 .. vfSelected.size()), true if included
+    vector<char> vfSelected;
+    vfSelected.reserve(vValue.size());
+    int64_t nSelected = 0;
+    unsigned int nSelectedCount = 0;
+    int64_t nBestExcess = std::numeric_limits<int64_t>::max();
+    unsigned int nBestCount = 0;
+
+    for (int nTries = 0; nTries < BNB_TOTAL_TRIES; nTries++)
+    {
+        bool fBacktrack = false;
+        if (nSelected + nAvailable < nTargetValue || nSelected > nTargetValue + nCostOfChange)
+            fBacktrack = true;
+        else if (nSelected >= nTargetValue)
+        {
+            int64_t nExcess = nSelected - nTargetValue;
+            if (nExcess < nBestExcess || (nExcess == nBestExcess && nSelectedCount < nBestCount))
+            {
+                nBestExcess = nExcess;
+                nBestCount = nSelectedCount;
+                vfBest = vfSelected;
+                vfBest.resize(vValue.size(), false);
+            }
+            fBacktrack = true;
+        }
+
+        if (fBacktrack)
+        {
+            // Undo trailing omissions, then turn the last inclusion into an omission
+            while (!vfSelected.empty() && !vfSelected.back())
+            {
+                vfSelected.pop_back();
+                nAvailable += vValue[vfSelected.size()].first;
+            }
+            if (vfSelected.empty())
+                break; // whole tree explored
+            vfSelected.back() = false;
+            nSelected -= vValue[vfSelected.size() - 1].first;
+            nSelectedCount--;
+        }
+        else
+        {
+            unsigned int i = vfSelected.size();
+            nAvailable -= vValue[i].first;
+            // Including a coin equal to one just omitted gives a branch already searched
+            if (i > 0 && !vfSelected.back() && vValue[i].first == vValue[i - 1].first)
+                vfSelected.push_back(false);
+            else
+            {
+                vfSelected.push_back(true);
+                nSelected += vValue[i].first;
+                nSelectedCount++;
+            }
+        }
+    }
+
+    if (nBestExcess == std::numeric_limits<int64_t>::max())
+        return false;
+    nBest = nTargetValue + nBestExcess;
+    return true;
+}
+
+static void ApproximateBestSubset(const vector<pair<int64_t, pair<const CWalletTx*,unsigned int> > >& vValue, int64_t nTotalLower, int64_t nTargetValue,
                                   vector<char>& vfBest, int64_t& nBest, int iterations = 1000)
 {
     vector<char> vfIncluded;
@@ -1763,11 +2187,27 @@ bool CWallet::SelectCoinsMinConf(const CAmount &nTargetValue, unsigned int nSpen
         break;
     }
 
-    // Solve subset sum by stochastic approximation
     sort(vValue.rbegin(), vValue.rend(), CompareValueOnly());
     vector<char> vfBest;
     int64_t nBest;
 
+    // A subset that needs no change output beats any approximation
+    if (SelectCoinsBnB(vValue, nTargetValue, BNB_COST_OF_CHANGE, vfBest, nBest))
+    {
+        string s = "CWallet::SelectCoinsMinConf branch and bound: ";
+        for (unsigned int i = 0; i < vValue.size(); i++)
+            if (vfBest[i])
+            {
+                setCoinsRet.insert(vValue[i].second);
+                nValueRet += vValue[i].first;
+                s += FormatMoney(vValue[i].first) + " ";
+            }
+
+        LogPrint("selectcoins", "%s - total %s\n", s, FormatMoney(nBest));
+        return true;
+    }
+
+    // Solve subset sum by stochastic approximation
     ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest, 1000);
     if (nBest != nTargetValue && nTotalLower >= nTargetValue + CENT)
         ApproximateBestSubset(vValue, nTotalLower, nTargetValue + CENT, vfBest, nBest, 1000);
@@ -2362,8 +2802,9 @@ bool CWallet::CreateTransaction(const vector<pair<CScript, CAmount> >& vecSend,
 
                 // Sign
                 int nIn = 0;
+                PrecomputedTransactionData txdata(wtxNew);
                 for (const PAIRTYPE(const CWalletTx*, unsigned int) & coin : setCoins)
-                    if (!SignSignature(*this, *coin.first, wtxNew, nIn++)) {
+                    if (!SignSignature(*this, *coin.first, wtxNew, nIn++, SIGHASH_ALL, &txdata)) {
                         strFailReason = _("Signing transaction failed");
                         return false;
                     }
@@ -2454,6 +2895,7 @@ bool CWallet::GetStakeWeight(uint64_t& nMinWeight, uint64_t& nMaxWeight, uint64_
 
 bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int64_t nSearchInterval, int64_t nFees, CTransaction& txNew, CKey& key)
 {
+    PERF_TIMER(PERF_CREATECOINSTAKE);
     CBlockIndex* pindexPrev = pindexBest;
     CBigNum bnTargetPerCoinDay;
     bnTargetPerCoinDay.SetCompact(nBits);
@@ -2484,6 +2926,18 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
     if (setCoins.empty())
         return false;
 
+    // Decrypt the keys of new staking outputs before searching, so a found
+    // kernel is signed straight away
+    {
+        std::set<CKeyID> setStakingKeys;
+        for (PAIRTYPE(const CWalletTx*, unsigned int) pcoin : setCoins) {
+            CTxDestination address;
+            if (ExtractDestination(pcoin.first->vout[pcoin.second].scriptPubKey, address) && boost::get<CKeyID>(&address))
+                setStakingKeys.insert(boost::get<CKeyID>(address));
+        }
+        CacheStakingKeys(setStakingKeys);
+    }
+
     int64_t nCredit = 0;
     CScript scriptPubKeyKernel;
     CTxDB txdb("r");
@@ -2536,26 +2990,27 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
                     LogPrint("coinstake", "CreateCoinStake : no support for kernel type=%d\n", whichType);
                     break;  // only support pay to public key and pay to address
                 }
+                CPubKey pubkey;
                 if (whichType == TX_PUBKEYHASH) // pay to address type
                 {
                     // convert to pay to public key type
-                    if (!keystore.GetKey(uint160(vSolutions[0]), key))
+                    if (!GetStakingKey(CKeyID(uint160(vSolutions[0])), key, pubkey))
                     {
                         LogPrint("coinstake", "CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
                         break;  // unable to find corresponding public key
                     }
-                    scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
+                    scriptPubKeyOut << pubkey << OP_CHECKSIG;
                 }
                 if (whichType == TX_PUBKEY)
                 {
                     valtype& vchPubKey = vSolutions[0];
-                    if (!keystore.GetKey(Hash160(vchPubKey), key))
+                    if (!GetStakingKey(CKeyID(Hash160(vchPubKey)), key, pubkey))
                     {
                         LogPrint("coinstake", "CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
                         break;  // unable to find corresponding public key
                     }
 
-                    if (key.GetPubKey() != vchPubKey)
+                    if (pubkey != CPubKey(vchPubKey))
                     {
                         LogPrint("coinstake", "CreateCoinStake : invalid key for kernel type=%d\n", whichType);
                         break; // keys mismatch
@@ -2655,8 +3110,9 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
 
     // Sign
     int nIn = 0;
+    PrecomputedTransactionData txdata(txNew);
     for (const CWalletTx* pcoin : vwtxPrev)
-        if (!SignSignature(*this, *pcoin, txNew, nIn++))
+        if (!SignSignature(*this, *pcoin, txNew, nIn++, SIGHASH_ALL, &txdata))
             return error("CreateCoinStake : failed to sign coinstake");
 
     // Limit size
@@ -2939,6 +3395,8 @@ bool CWallet::SetAddressBookName(const CTxDestination& address, const string& st
                              (fUpdated ? CT_UPDATED : CT_NEW) );
     if (!fFileBacked)
         return false;
+    if (pwalletdbBatch)
+        return pwalletdbBatch->WriteName(CBitcoinAddress(address).ToString(), strName);
     return CWalletDB(strWalletFile).WriteName(CBitcoinAddress(address).ToString(), strName);
 }
 
@@ -3008,12 +3466,8 @@ bool CWallet::NewKeyPool()
         else
             nKeys = max(GetArg("-keypool", 1000), (int64_t)0);
 
-        for (int i = 0; i < nKeys; i++)
-        {
-            int64_t nIndex = i+1;
-            walletdb.WritePool(nIndex, CKeyPool(GenerateNewKey()));
-            setKeyPool.insert(nIndex);
-        }
+        if (!AddKeysToPool(nKeys, walletdb))
+            return false;
         LogPrintf("CWallet::NewKeyPool wrote %d new keys\n", nKeys);
     }
     return true;
@@ -3040,23 +3494,93 @@ bool CWallet::TopUpKeyPool(unsigned int nSize)
         else
             nTargetSize = max(GetArg("-keypool", 1000), (int64_t)0);
 
-        while (setKeyPool.size() < (nTargetSize + 1))
+        if (setKeyPool.size() < (nTargetSize + 1))
         {
-            int64_t nEnd = 1;
-            if (!setKeyPool.empty())
-                nEnd = *(--setKeyPool.end()) + 1;
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey())))
+            unsigned int nKeys = nTargetSize + 1 - setKeyPool.size();
+            if (!AddKeysToPool(nKeys, walletdb))
                 throw runtime_error("TopUpKeyPool() : writing generated key failed");
-            setKeyPool.insert(nEnd);
-            LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
-            double dProgress = 100.f * nEnd / (nTargetSize + 1);
-            std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
-            uiInterface.InitMessage(strMsg);
+            LogPrintf("keypool added %u keys, size=%u\n", nKeys, setKeyPool.size());
         }
     }
     return true;
 }
 
+static void MakeNewKeysRange(std::vector<CKey>* pvKeys, std::vector<CPubKey>* pvPubKeys, bool fCompressed, unsigned int nStart, unsigned int nStep)
+{
+    for (unsigned int i = nStart; i < pvKeys->size(); i += nStep)
+    {
+        CKey& secret = (*pvKeys)[i];
+        secret.MakeNewKey(fCompressed);
+        (*pvPubKeys)[i] = secret.GetPubKey();
+        assert(secret.VerifyPubKey((*pvPubKeys)[i]));
+    }
+}
+
+// Generate keys and their public keys, spreading the EC work over the cores
+static void MakeNewKeys(std::vector<CKey>& vKeys, std::vector<CPubKey>& vPubKeys, bool fCompressed)
+{
+    vPubKeys.resize(vKeys.size());
+    unsigned int nThreads = std::max(1u, std::min(boost::thread::hardware_concurrency(), (unsigned int)vKeys.size() / 64));
+    boost::thread_group threads;
+    for (unsigned int i = 1; i < nThreads; i++)
+        threads.create_thread(boost::bind(&MakeNewKeysRange, &vKeys, &vPubKeys, fCompressed, i, nThreads));
+    MakeNewKeysRange(&vKeys, &vPubKeys, fCompressed, 0, nThreads);
+    threads.join_all();
+}
+
+// Append nKeys new keys to the key pool. The keys, their metadata and the
+// pool entries are written in a single database transaction.
+bool CWallet::AddKeysToPool(unsigned int nKeys, CWalletDB& walletdb)
+{
+    AssertLockHeld(cs_wallet);
+    if (nKeys == 0)
+        return true;
+
+    std::vector<CKey> vKeys(nKeys);
+    std::vector<CPubKey> vPubKeys;
+    MakeNewKeys(vKeys, vPubKeys, CanSupportFeature(FEATURE_COMPRPUBKEY));
+
+    CWalletBatch batch(this, walletdb);
+    bool fOwnBatch = batch.IsOpen();
+    // Inside a caller's batch the pool entries belong in its transaction too
+    CWalletDB& pooldb = pwalletdbBatch ? *pwalletdbBatch : walletdb;
+    int64_t nEnd = setKeyPool.empty() ? 1 : *(--setKeyPool.end()) + 1;
+    std::vector<int64_t> vIndex;
+    bool fOk = true;
+    for (unsigned int i = 0; i < nKeys && fOk; i++, nEnd++)
+    {
+        fOk = AddGeneratedKey(vKeys[i], vPubKeys[i]) && pooldb.WritePool(nEnd, CKeyPool(vPubKeys[i]));
+        vIndex.push_back(nEnd);
+    }
+    if (fOk && batch.Commit())
+    {
+        setKeyPool.insert(vIndex.begin(), vIndex.end());
+        return true;
+    }
+
+    // Nothing of this call is kept: drop the keys from memory and, when the
+    // writes were not ours to abort, the pool entries from the database
+    batch.Abort();
+    vPubKeys.resize(vIndex.size());
+    ForgetGeneratedKeys(vPubKeys);
+    if (!fOwnBatch)
+        BOOST_FOREACH(int64_t nIndex, vIndex)
+            pooldb.ErasePool(nIndex);
+    return false;
+}
+
+void CWallet::ForgetGeneratedKeys(const std::vector<CPubKey>& vPubKeys)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+    LOCK(cs_KeyStore);
+    BOOST_FOREACH(const CPubKey& pubkey, vPubKeys)
+    {
+        mapKeys.erase(pubkey.GetID());
+        mapCryptedKeys.erase(pubkey.GetID());
+        mapKeyMetadata.erase(pubkey.GetID());
+    }
+}
+
 
 void CWallet::ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool)
 {
@@ -8,6 +8,7 @@
 
 #include "walletdb.h"
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <string>
@@ -38,6 +39,19 @@ class CReserveKey;
 class COutput;
 class CWalletDB;
 
+/** Most nodes the branch and bound coin selection visits before giving up */
+static const int BNB_TOTAL_TRIES = 100000;
+/** Excess over the target that branch and bound may leave to the fee instead
+ *  of creating a change output. CreateTransaction only drops change that is
+ *  dust, so this stays below the dust threshold of a 34 byte pay-to-address
+ *  output (see CTxOut::IsDust). */
+static const int64_t BNB_COST_OF_CHANGE = (3 * (34 + 148) * MIN_RELAY_TX_FEE - 1) / 1000;
+
+/** Branch and bound search of vValue, sorted by descending value, for the
+ *  coins that sum to [nTargetValue, nTargetValue + nCostOfChange] */
+bool SelectCoinsBnB(const std::vector<std::pair<int64_t, std::pair<const CWalletTx*,unsigned int> > >& vValue, int64_t nTargetValue, int64_t nCostOfChange,
+                    std::vector<char>& vfBest, int64_t& nBest);
+
 typedef std::map<std::string, std::string> mapValue_t;
 
 /** (client) version numbers for particular wallet features */
@@ -60,6 +74,16 @@ enum AvailableCoinsType
     ONLY_10000 = 5                        // find masternode outputs including locked ones (use with caution)
 };
 
+/** Darksend class of an output amount, used to bucket the wallet's coins */
+enum CoinClass
+{
+    COINCLASS_OTHER,
+    COINCLASS_DENOMINATED,
+    COINCLASS_COLLATERAL,
+    COINCLASS_MASTERNODE,
+    COINCLASS_COUNT
+};
+
 /** A key pool entry */
 class CKeyPool
 {
@@ -95,7 +119,11 @@ class CWallet : public CCryptoKeyStore, public CWalletInterface
 private:
     bool SelectCoinsForStaking(int64_t nTargetValue, unsigned int nSpendTime, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64_t& nValueRet) const;
     bool SelectCoins(CAmount nTargetValue, unsigned int nSpendTime, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64_t& nValueRet, const CCoinControl *coinControl = NULL, AvailableCoinsType coin_type=ALL_COINS, bool useIX = false) const;
-    CWalletDB *pwalletdbEncryption;
+
+    bool AddGeneratedKey(const CKey& secret, const CPubKey& pubkey);
+    bool AddKeysToPool(unsigned int nKeys, CWalletDB& walletdb);
+    /// Undo AddGeneratedKey for keys that could not be saved with the pool
+    void ForgetGeneratedKeys(const std::vector<CPubKey>& vPubKeys);
 
     // the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion;
@@ -113,6 +141,36 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    std::atomic<bool> fAbortRescan;
+    std::atomic<bool> fScanningWallet;
+
+    // Darksend rounds of the wallet's fully denominated transactions, which
+    // all their denominated outputs share. Filled as transactions arrive or
+    // on first lookup and kept in the wallet file; dropped again for the
+    // descendants of a transaction that shows up late.
+    mutable std::map<uint256, int> mapDarksendRounds;
+    bool IsFullyDenominated(const CTransaction& tx) const;
+    int GetTxDarksendRounds(const CWalletTx& wtx) const;
+    void InvalidateDarksendRounds(const uint256& hash);
+
+    // Candidate outputs for AvailableCoins: owned outputs with a positive
+    // value that were unspent when their transaction or one of its spenders
+    // last changed, bucketed by the darksend class of the amount. Depth,
+    // maturity and coin locks move with every block, so AvailableCoins still
+    // checks them, but only for these outputs. Built on first use because
+    // the darksend denominations are set up after the wallet is loaded.
+    mutable std::set<COutPoint> setWalletCoins[COINCLASS_COUNT];
+    // Owned outputs spent only by wallet transactions that are not in a
+    // block yet, or whose block is being disconnected. They are looked at
+    // again on every AvailableCoins call, since such a spend can vanish from
+    // the memory pool without the wallet being told.
+    mutable std::set<COutPoint> setWalletCoinsPending;
+    mutable bool fWalletCoinsBuilt;
+    CoinClass GetCoinClass(int64_t nValue) const;
+    void BuildWalletCoins() const;
+    void UpdateWalletCoin(const COutPoint& outpoint) const;
+    void UpdateWalletCoins(const uint256& hash) const;
+
 public:
     /// Main wallet lock.
     /// This lock protects all the fields added by CWallet
@@ -165,12 +223,15 @@ public:
         nWalletMaxVersion = FEATURE_BASE;
         fFileBacked = false;
         nMasterKeyMaxID = 0;
-        pwalletdbEncryption = NULL;
+        pwalletdbBatch = NULL;
         nOrderPosNext = 0;
         nTimeFirstKey = 0;
         nLastFilteredHeight = 0;
         fWalletUnlockAnonymizeOnly = false;
         nStakeSplitThreshold = 1000;
+        fWalletCoinsBuilt = false;
+        fAbortRescan = false;
+        fScanningWallet = false;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -214,6 +275,17 @@ public:
     void ListLockedCoins(std::vector<COutPoint>& vOutpts);
     CAmount GetTotalValue(std::vector<CTxIn> vCoins);
 
+    // Batched database writes
+    /// While set, writes of keys, key metadata, address book entries and
+    /// wallet transactions go through this handle, so that many of them share
+    /// one database transaction. Only used with cs_wallet held.
+    CWalletDB *pwalletdbBatch;
+    /// Start collecting the wallet's database writes in walletdb's transaction.
+    /// cs_wallet must stay held until CommitBatch or AbortBatch.
+    bool BeginBatch(CWalletDB& walletdb);
+    bool CommitBatch();
+    void AbortBatch();
+
     // keystore implementation
     // Generate a new key
     CPubKey GenerateNewKey();
@@ -257,7 +329,15 @@ public:
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock, bool fConnect = true);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     // void EraseFromWallet(const uint256 &hash);
+    /// Returns the number of transactions found, or -1 if a rescan is running
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    /// Add the transactions of a block that involve the wallet, in block
+    /// order. vfPaysMe may flag those already known to pay to the wallet.
+    /// Caller holds cs_main and cs_wallet.
+    int AddBlockToWallet(const CBlock& block, const std::vector<bool>& vfPaysMe, bool fUpdate);
+    /// Ask a running ScanForWalletTransactions to stop after its current batch
+    void AbortRescan() { fAbortRescan = true; }
+    bool IsScanning() const { return fScanningWallet; }
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(bool fForce = false);
 
@@ -310,10 +390,12 @@ public:
     std::map<CTxDestination, int64_t> GetAddressBalances();
 
     // get the Darksend chain depth for a given input
-    int GetRealInputDarksendRounds(CTxIn in, int rounds) const;
+    int GetRealInputDarksendRounds(const COutPoint& outpoint) const;
     // respect current settings
     int GetInputDarksendRounds(CTxIn in) const;
 
+    void LoadDarksendRounds(const uint256& hash, int nRounds) { mapDarksendRounds[hash] = nRounds; }
+
     bool IsDenominated(const CTxIn &txin) const;
 
     bool IsDenominated(const CTransaction& tx) const;
@@ -471,6 +553,46 @@ public:
     void KeepKey();
 };
 
+/** A batch of wallet database writes (see CWallet::BeginBatch) that is
+ * aborted when it goes out of scope uncommitted, e.g. on an exception.
+ * Declare it after the cs_wallet lock, which the abort needs. */
+class CWalletBatch
+{
+private:
+    CWallet* pwallet;
+    bool fOpen;
+public:
+    CWalletBatch(CWallet* pwalletIn, CWalletDB& walletdb)
+    {
+        pwallet = pwalletIn;
+        fOpen = pwallet->BeginBatch(walletdb);
+    }
+
+    ~CWalletBatch()
+    {
+        Abort();
+    }
+
+    /// False when the batch could not be started, or one was already open
+    bool IsOpen() const { return fOpen; }
+
+    /// Commit the batch; true if there was nothing to commit
+    bool Commit()
+    {
+        if (!fOpen)
+            return true;
+        fOpen = false;
+        return pwallet->CommitBatch();
+    }
+
+    void Abort()
+    {
+        if (fOpen)
+            pwallet->AbortBatch();
+        fOpen = false;
+    }
+};
+
 
 typedef std::map<std::string, std::string> mapValue_t;
 
@@ -50,6 +50,18 @@ bool CWalletDB::EraseTx(uint256 hash)
     return Erase(std::make_pair(std::string("tx"), hash));
 }
 
+bool CWalletDB::WriteDarksendRounds(const uint256& hash, int nRounds)
+{
+    nWalletDBUpdated++;
+    return Write(std::make_pair(std::string("dsrounds"), hash), nRounds);
+}
+
+bool CWalletDB::EraseDarksendRounds(const uint256& hash)
+{
+    nWalletDBUpdated++;
+    return Erase(std::make_pair(std::string("dsrounds"), hash));
+}
+
 bool CWalletDB::WriteKey(const CPubKey& vchPubKey, const CPrivKey& vchPrivKey, const CKeyMetadata& keyMeta)
 {
     nWalletDBUpdated++;
@@ -194,7 +206,7 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
 {
     bool fAllAccounts = (strAccount == "*");
 
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error("CWalletDB::ListAccountCreditDebit() : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -570,6 +582,14 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         {
             ssValue >> pwallet->nStakeSplitThreshold;
         }
+        else if (strType == "dsrounds")
+        {
+            uint256 hash;
+            ssKey >> hash;
+            int nRounds;
+            ssValue >> nRounds;
+            pwallet->LoadDarksendRounds(hash, nRounds);
+        }
     } catch (...)
     {
         return false;
@@ -601,7 +621,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
         }
 
         // Get cursor
-        Dbc* pcursor = GetCursor();
+        CDBCursor* pcursor = GetCursor();
         if (!pcursor)
         {
             LogPrintf("Error getting wallet database cursor\n");
@@ -707,7 +727,7 @@ DBErrors CWalletDB::FindWalletTx(CWallet* pwallet, vector<uint256>& vTxHash, vec
         }
 
         // Get cursor
-        Dbc* pcursor = GetCursor();
+        CDBCursor* pcursor = GetCursor();
         if (!pcursor) {
             LogPrintf("Error getting wallet database cursor\n");
             return DB_CORRUPT;
@@ -792,6 +812,22 @@ void ThreadFlushWalletDB(const string& strFile)
             nLastWalletUpdate = GetTime();
         }
 
+        CLogDB* plog = bitdb.GetLogDb(strFile);
+        if (plog)
+        {
+            // A record log is synced in place, so there is no need to wait
+            // for the wallet to go quiet; one fsync covers all writes since
+            // the last pass
+            if (nLastFlushed != nWalletDBUpdated)
+            {
+                nLastFlushed = nWalletDBUpdated;
+                plog->Flush();
+                if (plog->NeedsCompaction())
+                    plog->Compact();
+            }
+            continue;
+        }
+
         if (nLastFlushed != nWalletDBUpdated && GetTime() - nLastWalletUpdate >= 2)
         {
             TRY_LOCK(bitdb.cs_db,lockDb);
@@ -833,6 +869,31 @@ bool BackupWallet(const CWallet& wallet, const string& strDest)
 {
     if (!wallet.fFileBacked)
         return false;
+
+    CLogDB* plog = bitdb.GetLogDb(wallet.strWalletFile);
+    if (plog)
+    {
+        // A torn last batch in the copy is dropped when it is loaded
+        plog->Flush();
+        filesystem::path pathSrc = plog->GetPath();
+        filesystem::path pathDest(strDest);
+        if (filesystem::is_directory(pathDest))
+            pathDest /= pathSrc.filename();
+
+        try {
+#if BOOST_VERSION >= 104000
+            filesystem::copy_file(pathSrc, pathDest, filesystem::copy_option::overwrite_if_exists);
+#else
+            filesystem::copy_file(pathSrc, pathDest);
+#endif
+            LogPrintf("copied %s to %s\n", pathSrc.string(), pathDest.string());
+            return true;
+        } catch(const filesystem::filesystem_error &e) {
+            LogPrintf("error copying %s to %s - %s\n", pathSrc.string(), pathDest.string(), e.what());
+            return false;
+        }
+    }
+
     while (true)
     {
         {